@@ -0,0 +1,220 @@
+#include <fmt/printf.h>
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace globals
+{
+    static constexpr char const* rendererPath{BENCH_RENDERER_PATH};
+    static constexpr std::uint32_t defaultFrames{500};
+
+    // Stand-ins for the tutorial stages. The earlier samples are copies of
+    // the code without a headless mode, so instead the renderer turns off
+    // what each later stage added, one part at a time. All of them draw one
+    // instance without MSAA.
+    static constexpr std::array<std::pair<char const*, char const*>, 4> stages{
+        {{"untextured", "--no-texture --no-depth-prepass --no-culling"},
+         {"textured", "--no-depth-prepass --no-culling"},
+         {"depth prepass", "--no-culling"},
+         {"gpu culling", ""}}};
+
+    // The last stage, MSAA, then goes through every sample count in turn.
+    // The renderer caps the request to what the device supports, so the
+    // sweep stops at the first capped run.
+    static constexpr std::array<std::uint32_t, 7> sampleCounts{
+        1, 2, 4, 8, 16, 32, 64};
+    static constexpr std::array<std::uint32_t, 2> framesInFlight{1, 2};
+} // namespace globals
+
+struct BenchResult
+{
+    std::string stage;
+    std::uint32_t samples;
+    std::uint32_t framesInFlight;
+    double startupMs;
+    double fps;
+    double cpuP50;
+    double cpuP95;
+    double gpuCull;
+    double gpuRenderPass;
+    double memoryMiB;
+};
+
+// The report is written by the renderer in a fixed shape, so looking for the
+// first key with the given name after an optional parent key is enough.
+static double findNumber(std::string const& report,
+                         std::string_view key,
+                         std::string_view parent = {})
+{
+    std::size_t start{0};
+    if (!parent.empty())
+    {
+        start = report.find(fmt::format("\"{}\":", parent));
+    }
+
+    auto position = report.find(fmt::format("\"{}\":", key), start);
+    if (start == std::string::npos || position == std::string::npos)
+    {
+        return 0.0;
+    }
+
+    return std::strtod(report.c_str() + position + key.size() + 3, nullptr);
+}
+
+static std::optional<BenchResult> runConfiguration(std::string const& stage,
+                                                   std::string const& arguments,
+                                                   std::uint32_t samples,
+                                                   std::uint32_t framesInFlight,
+                                                   std::uint32_t frames)
+{
+    static std::uint32_t runCount{0};
+    auto reportFile = (std::filesystem::temp_directory_path() /
+                       fmt::format("vk_bench_{}.json", runCount++))
+                          .string();
+    std::filesystem::remove(reportFile);
+
+    auto command = fmt::format("\"{}\" --headless --frames={} --samples={} "
+                               "--frames-in-flight={} --instances=1 {} "
+                               "--report=\"{}\"",
+                               globals::rendererPath,
+                               frames,
+                               samples,
+                               framesInFlight,
+                               arguments,
+                               reportFile);
+
+    // cmd.exe strips the first and last quote of a command that starts with
+    // one, so the whole thing needs quoting once more.
+#if defined(_WIN32)
+    command = "\"" + command + "\"";
+#endif
+
+    if (std::system(command.c_str()) != 0)
+    {
+        fmt::print("warning: {} run with {} sample(s) and {} frame(s) in "
+                   "flight failed.\n",
+                   stage,
+                   samples,
+                   framesInFlight);
+        return {};
+    }
+
+    std::ifstream file{reportFile};
+    std::stringstream stream;
+    stream << file.rdbuf();
+    std::string report = stream.str();
+    if (report.empty())
+    {
+        fmt::print("warning: no report from {}.\n", reportFile);
+        return {};
+    }
+
+    BenchResult result;
+    result.stage          = stage;
+    result.samples        = static_cast<std::uint32_t>(
+        findNumber(report, "samples"));
+    result.framesInFlight = framesInFlight;
+    result.startupMs      = findNumber(report, "startupSeconds") * 1000.0;
+    result.fps            = findNumber(report, "fps");
+    result.cpuP50         = findNumber(report, "p50", "frameTime");
+    result.cpuP95         = findNumber(report, "p95", "frameTime");
+    result.gpuCull        = findNumber(report, "cull", "gpu");
+    result.gpuRenderPass  = findNumber(report, "render pass", "gpu");
+    result.memoryMiB =
+        findNumber(report, "deviceLocalBytes") / (1024.0 * 1024.0);
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    std::uint32_t frames{globals::defaultFrames};
+    if (argc > 1)
+    {
+        std::string_view argument{argv[1]};
+        if (argument.substr(0, 9) == "--frames=")
+        {
+            frames = static_cast<std::uint32_t>(
+                std::strtoul(argv[1] + 9, nullptr, 10));
+        }
+
+        if (argc > 2 || argument.substr(0, 9) != "--frames=" || frames == 0)
+        {
+            fmt::print("usage: vk_bench [--frames=<frame count>]\n");
+            return 1;
+        }
+    }
+
+    std::vector<BenchResult> results;
+    for (auto const& [stage, arguments] : globals::stages)
+    {
+        auto result = runConfiguration(
+            stage, arguments, 1, globals::framesInFlight.back(), frames);
+        if (result)
+        {
+            results.push_back(*result);
+        }
+    }
+
+    for (auto framesInFlight : globals::framesInFlight)
+    {
+        for (auto samples : globals::sampleCounts)
+        {
+            auto result =
+                runConfiguration("msaa", "", samples, framesInFlight, frames);
+            if (!result)
+            {
+                continue;
+            }
+
+            // Anything past this would be capped to the same count again.
+            if (result->samples < samples)
+            {
+                break;
+            }
+            results.push_back(*result);
+        }
+    }
+
+    // Times are in milliseconds. CPU time is the whole frame, GPU time is per
+    // scope as measured by the renderer's timestamp queries. Memory is what
+    // the renderer has in use out of device local memory.
+    fmt::print("\n{:<14} {:>7} {:>6} {:>10} {:>9} {:>9} {:>9} {:>9} {:>9} "
+               "{:>10}\n",
+               "stage",
+               "samples",
+               "fif",
+               "startup",
+               "fps",
+               "cpu p50",
+               "cpu p95",
+               "gpu cull",
+               "gpu pass",
+               "device MiB");
+    for (auto const& result : results)
+    {
+        fmt::print("{:<14} {:>7} {:>6} {:>10.1f} {:>9.1f} {:>9.3f} {:>9.3f} "
+                   "{:>9.3f} {:>9.3f} {:>10.1f}\n",
+                   result.stage,
+                   result.samples,
+                   result.framesInFlight,
+                   result.startupMs,
+                   result.fps,
+                   result.cpuP50,
+                   result.cpuP95,
+                   result.gpuCull,
+                   result.gpuRenderPass,
+                   result.memoryMiB);
+    }
+
+    return results.empty() ? 1 : 0;
+}
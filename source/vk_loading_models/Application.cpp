@@ -79,25 +79,6 @@ vkDestroyDebugUtilsMessengerEXT(VkInstance instance,
         instance, messenger, pAllocator);
 }
 
-static std::vector<char> readFile(std::string const& filename)
-{
-    std::ifstream file{filename, std::ios::ate | std::ios::binary};
-
-    if (!file.is_open())
-    {
-        std::string message =
-            fmt::format("error: unable to open file {}.", filename);
-        throw std::runtime_error{message};
-    }
-
-    std::size_t fileSize = static_cast<std::size_t>(file.tellg());
-    std::vector<char> buffer(fileSize);
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    file.close();
-    return buffer;
-}
-
 static void onFramebufferResize(GLFWwindow* window,
                                 [[maybe_unused]] int width,
                                 [[maybe_unused]] int height)
@@ -529,27 +510,13 @@ bool Application::checkDeviceExtensionSupport(vk::PhysicalDevice const& device)
 SwapChainSupportDetails
 Application::querySwapChainSupport(vk::PhysicalDevice const& device)
 {
-    SwapChainSupportDetails details;
-    details.capabilities = device.getSurfaceCapabilitiesKHR(*mSurface);
-    details.formats      = device.getSurfaceFormatsKHR(*mSurface);
-    details.presentModes = device.getSurfacePresentModesKHR(*mSurface);
-
-    return details;
+    return core::querySwapChainSupport(device, *mSurface);
 }
 
 vk::SurfaceFormatKHR Application::chooseSwapSurfaceFormat(
     std::vector<vk::SurfaceFormatKHR> const& availableFormats)
 {
-    for (auto const& availableFormat : availableFormats)
-    {
-        if (availableFormat.format == vk::Format::eB8G8R8A8Unorm &&
-            availableFormat.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear)
-        {
-            return availableFormat;
-        }
-    }
-
-    return availableFormats[0];
+    return core::chooseSwapSurfaceFormat(availableFormats);
 }
 
 vk::PresentModeKHR Application::chooseSwapPresentMode(
@@ -569,27 +536,7 @@ vk::PresentModeKHR Application::chooseSwapPresentMode(
 vk::Extent2D
 Application::chooseSwapExtent(vk::SurfaceCapabilitiesKHR const& capabilities)
 {
-    if (capabilities.currentExtent.width !=
-        std::numeric_limits<std::uint32_t>::max())
-    {
-        return capabilities.currentExtent;
-    }
-    else
-    {
-        int width, height;
-        glfwGetFramebufferSize(mWindow, &width, &height);
-        vk::Extent2D actualExtent = {static_cast<std::uint32_t>(width),
-                                     static_cast<std::uint32_t>(height)};
-
-        actualExtent.width = std::max(
-            capabilities.minImageExtent.width,
-            std::min(capabilities.maxImageExtent.width, actualExtent.width));
-        actualExtent.height = std::max(
-            capabilities.minImageExtent.height,
-            std::min(capabilities.maxImageExtent.height, actualExtent.height));
-
-        return actualExtent;
-    }
+    return core::chooseSwapExtent(capabilities, mWindow);
 }
 
 void Application::createSwapChain()
@@ -667,8 +614,8 @@ void Application::createImageViews()
 void Application::createGraphicsPipeline()
 {
     std::string root{ShaderPath};
-    auto vertexShaderCode   = readFile(root + "triangle.vert.spv");
-    auto fragmentShaderCode = readFile(root + "triangle.frag.spv");
+    auto vertexShaderCode   = core::readFile(root + "triangle.vert.spv");
+    auto fragmentShaderCode = core::readFile(root + "triangle.frag.spv");
 
     vk::UniqueShaderModule vertModule = createShaderModule(vertexShaderCode);
     vk::UniqueShaderModule fragModule = createShaderModule(fragmentShaderCode);
@@ -1159,18 +1106,7 @@ std::uint32_t
 Application::findMemoryType(std::uint32_t typeFilter,
                             vk::MemoryPropertyFlags const& properties)
 {
-    auto memProperties = mPhysicalDevice.getMemoryProperties();
-    for (std::uint32_t i{0}; i < memProperties.memoryTypeCount; ++i)
-    {
-        if (typeFilter & (1 << i) &&
-            (memProperties.memoryTypes[i].propertyFlags & properties) ==
-                properties)
-        {
-            return i;
-        }
-    }
-
-    throw std::runtime_error{"error: failed to find suitable memory type."};
+    return core::findMemoryType(mPhysicalDevice, typeFilter, properties);
 }
 
 void Application::createBuffer(vk::DeviceSize const& size,
@@ -1179,22 +1115,13 @@ void Application::createBuffer(vk::DeviceSize const& size,
                                vk::Buffer& buffer,
                                vk::DeviceMemory& bufferMemory)
 {
-    vk::BufferCreateInfo bufferInfo;
-    bufferInfo.size        = size;
-    bufferInfo.usage       = usage;
-    bufferInfo.sharingMode = vk::SharingMode::eExclusive;
-
-    buffer = mDevice->createBuffer(bufferInfo);
-
-    auto memRequirements = mDevice->getBufferMemoryRequirements(buffer);
-
-    vk::MemoryAllocateInfo allocInfo;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex =
-        findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    bufferMemory = mDevice->allocateMemory(allocInfo);
-    mDevice->bindBufferMemory(buffer, bufferMemory, 0);
+    core::createBuffer(mPhysicalDevice,
+                       *mDevice,
+                       size,
+                       usage,
+                       properties,
+                       buffer,
+                       bufferMemory);
 }
 
 void Application::copyBuffer(vk::Buffer const& srcBuffer,
@@ -1202,13 +1129,7 @@ void Application::copyBuffer(vk::Buffer const& srcBuffer,
                              vk::DeviceSize const& size)
 {
     auto commandBuffer = beginSingleTimeCommands();
-
-    vk::BufferCopy copyRegion;
-    copyRegion.srcOffset = 0;
-    copyRegion.dstOffset = 0;
-    copyRegion.size      = size;
-    commandBuffer.copyBuffer(srcBuffer, dstBuffer, 1, &copyRegion);
-
+    core::copyBuffer(commandBuffer, srcBuffer, dstBuffer, size);
     endSingleTimeCommands(commandBuffer);
 }
 
@@ -1452,121 +1373,37 @@ void Application::createImage(std::uint32_t width,
                               vk::Image& image,
                               vk::DeviceMemory& imageMemory)
 {
-    vk::ImageCreateInfo imageInfo;
-    imageInfo.imageType     = vk::ImageType::e2D;
-    imageInfo.extent        = {width, height, 1};
-    imageInfo.mipLevels     = 1;
-    imageInfo.arrayLayers   = 1;
-    imageInfo.format        = format;
-    imageInfo.tiling        = tiling;
-    imageInfo.initialLayout = vk::ImageLayout::eUndefined;
-    imageInfo.usage         = usage;
-    imageInfo.sharingMode   = vk::SharingMode::eExclusive;
-    imageInfo.samples       = vk::SampleCountFlagBits::e1;
-
-    image = mDevice->createImage(imageInfo);
-
-    auto memRequirements = mDevice->getImageMemoryRequirements(image);
-
-    vk::MemoryAllocateInfo allocInfo;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex =
-        findMemoryType(memRequirements.memoryTypeBits, properties);
-    imageMemory = mDevice->allocateMemory(allocInfo);
-    mDevice->bindImageMemory(image, imageMemory, 0);
+    auto imageInfo = core::getImageCreateInfo(width,
+                                              height,
+                                              1,
+                                              vk::SampleCountFlagBits::e1,
+                                              format,
+                                              tiling,
+                                              usage);
+    core::createImage(
+        mPhysicalDevice, *mDevice, imageInfo, properties, image, imageMemory);
 }
 
 vk::CommandBuffer Application::beginSingleTimeCommands()
 {
-    vk::CommandBufferAllocateInfo allocInfo;
-    allocInfo.level              = vk::CommandBufferLevel::ePrimary;
-    allocInfo.commandPool        = *mBufferPool;
-    allocInfo.commandBufferCount = 1;
-
-    vk::CommandBuffer commandBuffer =
-        mDevice->allocateCommandBuffers(allocInfo).front();
-
-    vk::CommandBufferBeginInfo beginInfo;
-    beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
-
-    commandBuffer.begin(beginInfo);
-    return commandBuffer;
+    return core::beginSingleTimeCommands(*mDevice, *mBufferPool);
 }
 
 void Application::endSingleTimeCommands(vk::CommandBuffer const& commandBuffer)
 {
-    commandBuffer.end();
-
-    vk::SubmitInfo submitInfo;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers    = &commandBuffer;
-
-    mGraphicsQueue.submit({submitInfo}, {});
-    mGraphicsQueue.waitIdle();
-
-    mDevice->freeCommandBuffers(*mBufferPool, commandBuffer);
+    core::endSingleTimeCommands(
+        *mDevice, *mBufferPool, mGraphicsQueue, commandBuffer);
 }
 
 void Application::transitionImageLayout(
     vk::Image const& image,
-    [[maybe_unused]] vk::Format const& format,
+    vk::Format const& format,
     vk::ImageLayout const& oldLayout,
     vk::ImageLayout const& newLayout)
 {
-    vk::PipelineStageFlags sourceStage;
-    vk::PipelineStageFlags destinationStage;
-
     auto commandBuffer = beginSingleTimeCommands();
-
-    vk::ImageMemoryBarrier barrier;
-    barrier.oldLayout                       = oldLayout;
-    barrier.newLayout                       = newLayout;
-    barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image                           = image;
-    barrier.subresourceRange.aspectMask     = vk::ImageAspectFlagBits::eColor;
-    barrier.subresourceRange.baseMipLevel   = 0;
-    barrier.subresourceRange.levelCount     = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount     = 1;
-
-    if (oldLayout == vk::ImageLayout::eUndefined &&
-        newLayout == vk::ImageLayout::eTransferDstOptimal)
-    {
-        barrier.srcAccessMask = {};
-        barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
-
-        sourceStage      = vk::PipelineStageFlagBits::eTopOfPipe;
-        destinationStage = vk::PipelineStageFlagBits::eTransfer;
-    }
-    else if (oldLayout == vk::ImageLayout::eTransferDstOptimal &&
-             newLayout == vk::ImageLayout::eShaderReadOnlyOptimal)
-    {
-        barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-
-        sourceStage      = vk::PipelineStageFlagBits::eTransfer;
-        destinationStage = vk::PipelineStageFlagBits::eFragmentShader;
-    }
-    else if (oldLayout == vk::ImageLayout::eUndefined &&
-             newLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal)
-    {
-        barrier.srcAccessMask = {};
-        barrier.dstAccessMask =
-            vk::AccessFlagBits::eDepthStencilAttachmentRead |
-            vk::AccessFlagBits::eDepthStencilAttachmentWrite;
-
-        sourceStage      = vk::PipelineStageFlagBits::eTopOfPipe;
-        destinationStage = vk::PipelineStageFlagBits::eEarlyFragmentTests;
-    }
-    else
-    {
-        throw std::runtime_error{"error: unsupported layout transition."};
-    }
-
-    commandBuffer.pipelineBarrier(
-        sourceStage, destinationStage, {}, {}, {}, {barrier});
-
+    core::transitionImageLayout(
+        commandBuffer, image, format, oldLayout, newLayout, 1);
     endSingleTimeCommands(commandBuffer);
 }
 
@@ -1576,23 +1413,7 @@ void Application::copyBufferToImage(vk::Buffer const& buffer,
                                     std::uint32_t height)
 {
     auto commandBuffer = beginSingleTimeCommands();
-
-    vk::BufferImageCopy region;
-    region.bufferOffset      = 0;
-    region.bufferRowLength   = 0;
-    region.bufferImageHeight = 0;
-
-    region.imageSubresource.aspectMask     = vk::ImageAspectFlagBits::eColor;
-    region.imageSubresource.mipLevel       = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount     = 1;
-
-    region.imageOffset = {0, 0, 0};
-    region.imageExtent = {width, height, 1};
-
-    commandBuffer.copyBufferToImage(
-        buffer, image, vk::ImageLayout::eTransferDstOptimal, {region});
-
+    core::copyBufferToImage(commandBuffer, buffer, image, width, height);
     endSingleTimeCommands(commandBuffer);
 }
 
@@ -1609,17 +1430,8 @@ Application::createImageView(vk::Image const& image,
                              vk::Format const& format,
                              vk::ImageAspectFlags const& aspectFlags)
 {
-    vk::ImageViewCreateInfo viewInfo;
-    viewInfo.image                           = image;
-    viewInfo.viewType                        = vk::ImageViewType::e2D;
-    viewInfo.format                          = format;
-    viewInfo.subresourceRange.aspectMask     = aspectFlags;
-    viewInfo.subresourceRange.baseMipLevel   = 0;
-    viewInfo.subresourceRange.levelCount     = 1;
-    viewInfo.subresourceRange.baseArrayLayer = 0;
-    viewInfo.subresourceRange.layerCount     = 1;
-
-    return mDevice->createImageView(viewInfo);
+    return core::createImageView(
+        *mDevice, image, format, aspectFlags, 1);
 }
 
 void Application::createTextureSampler()
@@ -1671,38 +1483,18 @@ Application::findSupportedFormat(std::vector<vk::Format> const& candidates,
                                  vk::ImageTiling const& tiling,
                                  vk::FormatFeatureFlags const& features)
 {
-    for (auto format : candidates)
-    {
-        auto props = mPhysicalDevice.getFormatProperties(format);
-        if (tiling == vk::ImageTiling::eLinear &&
-            (props.linearTilingFeatures & features) == features)
-        {
-            return format;
-        }
-        else if (tiling == vk::ImageTiling::eOptimal &&
-                 (props.optimalTilingFeatures & features) == features)
-        {
-            return format;
-        }
-    }
-
-    throw std::runtime_error{"error: failed to find supported format."};
+    return core::findSupportedFormat(
+        mPhysicalDevice, candidates, tiling, features);
 }
 
 vk::Format Application::findDepthFormat()
 {
-    return findSupportedFormat(
-        {vk::Format::eD32Sfloat,
-         vk::Format::eD32SfloatS8Uint,
-         vk::Format::eD24UnormS8Uint},
-        vk::ImageTiling::eOptimal,
-        vk::FormatFeatureFlagBits::eDepthStencilAttachment);
+    return core::findDepthFormat(mPhysicalDevice);
 }
 
 bool Application::hasStencilComponent(vk::Format const& format)
 {
-    return format == vk::Format::eD32SfloatS8Uint ||
-           format == vk::Format::eD24UnormS8Uint;
+    return core::hasStencilComponent(format);
 }
 
 void Application::loadModel()
@@ -10,6 +10,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "VulkanHelpers.hpp"
+
 #include <atlas/utils/Cameras.hpp>
 
 #include <algorithm>
@@ -28,12 +30,7 @@ struct QueueFamilyIndices
     }
 };
 
-struct SwapChainSupportDetails
-{
-    vk::SurfaceCapabilitiesKHR capabilities;
-    std::vector<vk::SurfaceFormatKHR> formats;
-    std::vector<vk::PresentModeKHR> presentModes;
-};
+using SwapChainSupportDetails = core::SwapChainSupportDetails;
 
 struct Vertex
 {
@@ -1,4 +1,5 @@
 #include "Application.hpp"
+#include "MeshOptimiser.hpp"
 #include "Paths.hpp"
 #include "stb_image.h"
 
@@ -6,33 +7,146 @@
 
 #include <algorithm>
 #include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
 #include <fmt/printf.h>
 #include <fstream>
 #include <functional>
 #include <limits>
 #include <numeric>
 #include <set>
+#include <thread>
+#include <unordered_map>
 
 namespace globals
 {
     static constexpr auto windowWidth{800};
     static constexpr auto windowHeight{600};
-    static constexpr auto maxFramesInFlight{2};
+    static constexpr auto useSecondaryCommandBuffers{false};
+    static constexpr auto enableClusterCulling{true};
+
+    // Levels of detail built when the model is loaded, each with at most
+    // half the triangles of the one before. An instance is drawn with the
+    // coarsest level that still has a triangle for every this many pixels
+    // its bounding sphere covers.
+    static constexpr std::uint32_t maxMeshLods{6};
+    static constexpr float lodPixelsPerTriangle{4.0f};
+
+    // How vertices are stored on the GPU, either FloatVertexLayout or
+    // QuantisedVertexLayout, and whether positions get a stream of their own.
+    static constexpr auto splitVertexStreams{true};
+    using VertexLayout =
+        VertexFormat<QuantisedVertexLayout, splitVertexStreams>;
+
+    // Lay down depth with a position only pipeline first, so the main pass
+    // (testing with eEqual) shades every pixel once.
+    static constexpr auto enableDepthPrepass{true};
+
+    // Recording starts on one thread and steps up to every core, averaging
+    // the time spent recording over this many frames at each step.
+    static constexpr std::size_t recordSampleFrames{240};
+
+    // Copies of the model are laid out on a grid going away from the camera.
+    // With the benchmark on, the instance count is multiplied by four every
+    // few seconds until it reaches the maximum.
+    static constexpr std::uint32_t maxInstances{1024};
+    static constexpr float instanceSpacing{1.5f};
+    static constexpr auto benchmarkInstances{false};
+    static constexpr std::size_t instanceSampleFrames{240};
+
+    // Frustum cull the instances in a compute shader and draw whatever
+    // survives through drawIndexedIndirect(Count).
+    static constexpr auto enableGpuCulling{true};
+    static constexpr std::uint32_t cullGroupSize{64};
+
+    // Upper bound on the (instance, meshlet) pairs that survive culling in a
+    // frame. Anything past it is dropped.
+    static constexpr std::uint32_t maxDrawCommands{1u << 18};
+
+    // Time the render pass, culling and uploads with timestamp queries. The
+    // averages are printed on exit along with a Chrome trace of every frame.
+    static constexpr auto enableGpuProfiling{true};
+    static constexpr auto gpuTraceFile{"gpu_trace.json"};
+
+    // CPU frame time percentiles and histograms are printed every this many
+    // frames.
+    static constexpr std::size_t cpuStatsWindow{600};
+
+    // Frames rendered before a headless benchmark starts measuring, so that
+    // first use costs and clocks ramping up stay out of the numbers.
+    static constexpr std::uint32_t benchmarkWarmupFrames{60};
+    static constexpr auto offscreenFormat{vk::Format::eR8G8B8A8Unorm};
+
+    // Size of the bindless texture array, clamped to the device limits.
+    static constexpr std::uint32_t maxBindlessTextures{4096};
+
+    // Start with the levels no larger than the tail size and stream the rest
+    // in as they are needed on screen, at most this many bytes a frame. Only
+    // done for containers, and with bindless textures since descriptors get
+    // written while frames are in flight.
+    static constexpr auto enableTextureStreaming{true};
+    static constexpr std::uint32_t textureTailSize{256};
+    static constexpr vk::DeviceSize textureUploadBudget{8 * 1024 * 1024};
+    static constexpr float cameraFieldOfView{45.0f};
+
+    // Samples used when none are asked for. Without lazily allocated memory
+    // the count is also halved until the multisampled colour and depth
+    // attachments (4 bytes each per sample) fit in the budget at the initial
+    // window size.
+    static constexpr std::uint32_t defaultSampleCount{4};
+    static constexpr vk::DeviceSize msaaBytesPerSample{8};
+    static constexpr vk::DeviceSize msaaMemoryBudget{32 * 1024 * 1024};
     static const std::vector<const char*> validationLayers{
         "VK_LAYER_KHRONOS_validation"};
     static const std::vector<const char*> deviceExtensions{
         VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
+    // Pre-mipped, block compressed versions of the texture in order of
+    // preference. They must share the orientation of the flipped JPEG.
+    static const std::vector<std::pair<const char*, vk::Format>>
+        textureCandidates{{"chalet.bc7.ktx2", vk::Format::eBc7UnormBlock},
+                          {"chalet.astc.ktx2", vk::Format::eAstc4x4UnormBlock}};
+    static const vk::FormatFeatureFlags textureFeatures{
+        vk::FormatFeatureFlagBits::eSampledImage |
+        vk::FormatFeatureFlagBits::eSampledImageFilterLinear};
+
+    // Recompile shaders that are edited while the window is open and
+    // rebuild the pipelines that use them. Everything else stays as it is.
+    static constexpr auto enableShaderHotReload{true};
+    static constexpr std::chrono::milliseconds shaderPollInterval{500};
+
+    // Mip chains generated on the GPU are built in a compute shader where the
+    // format can be written as a storage image. Each dispatch reduces tiles
+    // of this many texels down to one, which is this many levels.
+    static constexpr auto mipmapFormat{vk::Format::eR8G8B8A8Unorm};
+    static constexpr std::uint32_t mipmapTileSize{32};
+    static constexpr std::uint32_t mipmapDispatchLevels{5};
+
+    // Devices without timeline semaphores fall back to a fence per submit.
+    static constexpr auto enableTimelineSemaphores{true};
+
+    // The features the main pass has variants for, and the ones the mesh is
+    // drawn with to begin with. T and S toggle texturing and sample shading.
+    static constexpr ShaderFeatures variantFeatures{featureTexture |
+                                                    featureSampleShading};
+    static constexpr ShaderFeatures meshFeatures{featureTexture};
+
 #if defined(NDEBUG)
     static constexpr auto enableValidationLayers{false};
 #else
     static constexpr auto enableValidationLayers{true};
 #endif
 
+    // Whatever the build compiled the shaders with, see CMakeLists.txt.
+    static constexpr auto shaderCompileFlags{SHADER_COMPILE_FLAGS};
+
     // We need to declare these function pointers ourselves as they are not
     // loaded automatically by Vulkan.
     PFN_vkCreateDebugUtilsMessengerEXT pfnVkCreateDebugUtilsMessengerEXT;
     PFN_vkDestroyDebugUtilsMessengerEXT pfnVkDestroyDebugUtilsMessengerEXT;
+    PFN_vkCmdDrawIndexedIndirectCountKHR pfnVkCmdDrawIndexedIndirectCountKHR;
 } // namespace globals
 
 static VKAPI_ATTR vk::Bool32 VKAPI_CALL
@@ -79,23 +193,44 @@ vkDestroyDebugUtilsMessengerEXT(VkInstance instance,
         instance, messenger, pAllocator);
 }
 
-static std::vector<char> readFile(std::string const& filename)
+static vk::DeviceSize alignUp(vk::DeviceSize size, vk::DeviceSize alignment)
+{
+    return (alignment > 0) ? (size + alignment - 1) & ~(alignment - 1) : size;
+}
+
+// Where the grid puts an instance, relative to the first one.
+static glm::vec3 getInstanceOffset(std::uint32_t instance)
 {
-    std::ifstream file{filename, std::ios::ate | std::ios::binary};
+    auto side = static_cast<std::uint32_t>(
+        std::ceil(std::sqrt(static_cast<float>(globals::maxInstances))));
+    glm::vec3 position{-static_cast<float>(instance % side),
+                       -static_cast<float>(instance / side),
+                       0.0f};
+    return position * globals::instanceSpacing;
+}
 
-    if (!file.is_open())
+// Names come from the driver, so they can hold anything a JSON string can't.
+static std::string escapeJson(std::string_view text)
+{
+    std::string escaped;
+    for (char c : text)
     {
-        std::string message =
-            fmt::format("error: unable to open file {}.", filename);
-        throw std::runtime_error{message};
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            escaped += fmt::format("\\u{:04x}", static_cast<int>(c));
+        }
+        else
+        {
+            escaped += c;
+        }
     }
 
-    std::size_t fileSize = static_cast<std::size_t>(file.tellg());
-    std::vector<char> buffer(fileSize);
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    file.close();
-    return buffer;
+    return escaped;
 }
 
 static void onFramebufferResize(GLFWwindow* window,
@@ -124,6 +259,21 @@ static void onKeyPress(GLFWwindow* window,
 
         return;
     }
+
+    if (action != GLFW_PRESS)
+    {
+        return;
+    }
+
+    auto app = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
+    if (key == GLFW_KEY_T)
+    {
+        app->toggleShaderFeature(featureTexture);
+    }
+    else if (key == GLFW_KEY_S)
+    {
+        app->toggleShaderFeature(featureSampleShading);
+    }
 }
 
 bool compareLayers(std::string_view const& layerName,
@@ -140,44 +290,59 @@ bool compareExtensions(std::string_view const& extensionName,
     return name == extensionName;
 }
 
-vk::VertexInputBindingDescription Vertex::getBindingDescription()
+vk::VertexInputBindingDescription
+InstanceData::getBindingDescription(std::uint32_t binding)
 {
     vk::VertexInputBindingDescription bindingDescription;
-    bindingDescription.binding   = 0;
-    bindingDescription.stride    = sizeof(Vertex);
-    bindingDescription.inputRate = vk::VertexInputRate::eVertex;
+    bindingDescription.binding   = binding;
+    bindingDescription.stride    = sizeof(InstanceData);
+    bindingDescription.inputRate = vk::VertexInputRate::eInstance;
 
     return bindingDescription;
 }
 
-std::array<vk::VertexInputAttributeDescription, 3>
-Vertex::getAttributeDescriptions()
+std::array<vk::VertexInputAttributeDescription, 4>
+InstanceData::getAttributeDescriptions(std::uint32_t binding)
 {
-    std::array<vk::VertexInputAttributeDescription, 3> attributeDescriptions;
-
-    attributeDescriptions[0].binding  = 0;
-    attributeDescriptions[0].location = 0;
-    attributeDescriptions[0].format   = vk::Format::eR32G32B32Sfloat;
-    attributeDescriptions[0].offset   = offsetof(Vertex, pos);
-
-    attributeDescriptions[1].binding  = 0;
-    attributeDescriptions[1].location = 1;
-    attributeDescriptions[1].format   = vk::Format::eR32G32B32Sfloat;
-    attributeDescriptions[1].offset   = offsetof(Vertex, colour);
-
-    attributeDescriptions[2].binding  = 0;
-    attributeDescriptions[2].location = 2;
-    attributeDescriptions[2].format   = vk::Format::eR32G32Sfloat;
-    attributeDescriptions[2].offset   = offsetof(Vertex, texCoord);
+    // A mat4 attribute takes up four consecutive locations, one per column.
+    std::array<vk::VertexInputAttributeDescription, 4> attributeDescriptions;
+    for (std::uint32_t i{0}; i < attributeDescriptions.size(); ++i)
+    {
+        attributeDescriptions[i].binding  = binding;
+        attributeDescriptions[i].location = 2 + i;
+        attributeDescriptions[i].format   = vk::Format::eR32G32B32A32Sfloat;
+        attributeDescriptions[i].offset =
+            static_cast<std::uint32_t>(offsetof(InstanceData, model) +
+                                       sizeof(glm::vec4) * i);
+    }
 
     return attributeDescriptions;
 }
 
+Application::Application(Settings const& settings) : mSettings{settings}
+{}
+
 void Application::run()
 {
-    initWindow();
+    if (!mSettings.headless)
+    {
+        initWindow();
+    }
+
+    auto startupStart = std::chrono::steady_clock::now();
     initVulkan();
-    mainLoop();
+    std::chrono::duration<double> startupTime =
+        std::chrono::steady_clock::now() - startupStart;
+    mStartupSeconds = startupTime.count();
+
+    if (mSettings.headless)
+    {
+        runBenchmark();
+    }
+    else
+    {
+        mainLoop();
+    }
     cleanup();
 }
 
@@ -195,41 +360,129 @@ void Application::redrawWindow()
     }
 }
 
+void Application::toggleShaderFeature(ShaderFeature feature)
+{
+    // Every supported combination already has a pipeline, so this only
+    // changes which one the next frame binds.
+    if (!(mSupportedFeatures & feature))
+    {
+        fmt::print("warning: the shader feature {:#x} is not supported.\n",
+                   static_cast<std::uint32_t>(feature));
+        return;
+    }
+
+    mMeshFeatures ^= feature;
+    fmt::print("Drawing with shader features {:#x}.\n", mMeshFeatures);
+}
+
 void Application::initVulkan()
 {
     createInstance();
     setupDebugMessenger();
-    createSurface();
+    if (!mSettings.headless)
+    {
+        createSurface();
+    }
     pickPhysicalDevice();
+
+    // Neither the texture decode nor the model parse touch the device, so run
+    // them on workers while the swapchain and the pipeline are being built.
+    // Each one is only waited on right before its data gets staged.
+    auto textureLoad =
+        std::async(std::launch::async, [this]() { loadTexture(); });
+    auto modelLoad = std::async(std::launch::async, [this]() { loadModel(); });
+
     createLogicalDevice();
-    createSwapChain();
+    if (mSettings.headless)
+    {
+        createOffscreenTargets();
+    }
+    else
+    {
+        createSwapChain();
+    }
     createImageViews();
-    createRenderPass();
+    createRenderGraph();
     createDescriptorSetLayout();
     createGraphicsPipeline();
+    createCullPipeline();
+    createMipmapPipeline();
     createCommandPool();
-    createColourResources();
-    createDepthResources();
-    createFramebuffers();
+
+    // The queries for the uploads are reset on the graphics side, since
+    // transfer queues can't reset query pools.
+    mGpuProfiler.beginFrame(mUploadContext.getGraphicsCommandBuffer(),
+                            mGpuProfiler.getUploadSlot());
+
+    textureLoad.get();
     createTextureImage();
     createTextureImageView();
     createTextureSampler();
-    loadModel();
+
+    modelLoad.get();
+    createDrawList();
+    computeBoundingSphere();
     createVertexBuffer();
     createIndexBuffer();
+    createInstanceBuffer();
+    createMeshletBuffer();
+
+    // Everything that needs to go to the GPU has been recorded at this point,
+    // so kick off the uploads and keep going with the rest of the setup while
+    // they execute.
+    mUploadContext.submit();
+
     createUniformBuffers();
+    createIndirectBuffers();
     createDescriptorPool();
     createDescriptorSets();
     createCommandBuffers();
     createSyncObjects();
+
+    mUploadContext.wait();
+    mGpuProfiler.collect(mGpuProfiler.getUploadSlot());
 }
 
 void Application::mainLoop()
 {
+    mCpuProfiler.init(globals::cpuStatsWindow, !mSettings.cpuStatsFile.empty());
+    if constexpr (globals::enableShaderHotReload)
+    {
+        watchShaders();
+    }
+
+    mNextFrameTime = std::chrono::steady_clock::now();
     while (!glfwWindowShouldClose(mWindow))
     {
-        drawFrame();
+        auto frameStart = std::chrono::high_resolution_clock::now();
+
+        // Wait for the frame's resources and for the limiter before polling,
+        // so the input a frame uses is as fresh as it can be. drawFrame
+        // waits for the same slot, which is then already free.
+        {
+            auto scope = mCpuProfiler.scope(CpuStage::waitForFence);
+            mFrameScheduler.beginFrame();
+        }
+        limitFrameRate();
         glfwPollEvents();
+        if constexpr (globals::enableShaderHotReload)
+        {
+            reloadShaders();
+        }
+
+        drawFrame();
+        std::chrono::duration<double, std::milli> frameTime =
+            std::chrono::high_resolution_clock::now() - frameStart;
+
+        if constexpr (globals::benchmarkInstances)
+        {
+            updateInstanceStats(frameTime.count());
+        }
+
+        if (mCpuProfiler.endFrame())
+        {
+            mCpuProfiler.printSummary();
+        }
     }
 
     mDevice->waitIdle();
@@ -237,8 +490,47 @@ void Application::mainLoop()
 
 void Application::cleanup()
 {
-    glfwDestroyWindow(mWindow);
-    glfwTerminate();
+    // The device is idle by now, whatever is left can go.
+    mDeletionQueue.flush();
+
+    if (mTextureStreaming)
+    {
+        fmt::print("texture streaming: level {} of {} resident, {} of {} "
+                   "bytes, {} bytes streamed\n",
+                   mTextureStreamer.getResidentLevel(0),
+                   mTextureStreamer.getLevelCount(0),
+                   mTextureStreamer.getResidentSize(),
+                   mTextureStreamer.getBudget(),
+                   mTextureStreamer.getStreamedSize());
+    }
+
+    if (!mPipelineCache.save())
+    {
+        fmt::print("warning: unable to write pipeline cache.\n");
+    }
+
+    if (!mSettings.cpuStatsFile.empty() &&
+        !mCpuProfiler.writeCsv(mSettings.cpuStatsFile))
+    {
+        fmt::print("warning: unable to write CPU stats {}.\n",
+                   mSettings.cpuStatsFile);
+    }
+
+    if (mGpuProfiler.isEnabled())
+    {
+        mGpuProfiler.printSummary();
+        if (!mGpuProfiler.writeTrace(globals::gpuTraceFile))
+        {
+            fmt::print("warning: unable to write GPU trace {}.\n",
+                       globals::gpuTraceFile);
+        }
+    }
+
+    if (!mSettings.headless)
+    {
+        glfwDestroyWindow(mWindow);
+        glfwTerminate();
+    }
 }
 
 void Application::initWindow()
@@ -314,12 +606,17 @@ void Application::listExtensions()
 
 std::vector<const char*> Application::getRequiredExtensions()
 {
-    std::uint32_t glfwExtensionCount{0};
-    const char** glfwExtensionNames;
-    glfwExtensionNames = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-    std::vector<const char*> extensions(
-        glfwExtensionNames, glfwExtensionNames + glfwExtensionCount);
+    // Without a window there is no surface, so GLFW has nothing to ask for.
+    std::vector<const char*> extensions;
+    if (!mSettings.headless)
+    {
+        std::uint32_t glfwExtensionCount{0};
+        const char** glfwExtensionNames;
+        glfwExtensionNames =
+            glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        extensions.assign(glfwExtensionNames,
+                          glfwExtensionNames + glfwExtensionCount);
+    }
 
     if constexpr (globals::enableValidationLayers)
     {
@@ -398,21 +695,91 @@ void Application::pickPhysicalDevice()
             "error: there are no devices that support Vulkan."};
     }
 
-    for (auto const& device : devices)
+    // The override is either the index the device is listed at, which has
+    // to be suitable, or part of a name, in which case the best suitable
+    // device of those that match is used.
+    bool isIndex = !mSettings.device.empty() &&
+                   std::all_of(mSettings.device.begin(),
+                               mSettings.device.end(),
+                               [](char c) { return c >= '0' && c <= '9'; });
+
+    std::optional<std::size_t> chosen;
+    DeviceRating bestRating;
+    bool hasMatch{false};
+    for (std::size_t i{0}; i < devices.size(); ++i)
     {
-        if (isDeviceSuitable(device))
+        auto properties = devices[i].getProperties();
+        std::string_view name{properties.deviceName};
+        bool isSuitable = isDeviceSuitable(devices[i]);
+        auto rating     = rateDevice(devices[i]);
+        fmt::print("device {}: {}, {} MiB, {} async queue(s), {}x MSAA{}\n",
+                   i,
+                   name,
+                   rating.localMemory,
+                   rating.queues,
+                   rating.samples,
+                   isSuitable ? "" : " (not suitable)");
+
+        if (!mSettings.device.empty())
         {
-            mPhysicalDevice = device;
-            mMSAASamples    = getMaxUsableSampleCount();
-            break;
+            bool isMatch = isIndex ? std::to_string(i) == mSettings.device
+                                   : name.find(mSettings.device) !=
+                                         std::string_view::npos;
+            if (!isMatch)
+            {
+                continue;
+            }
+
+            if (isIndex && !isSuitable)
+            {
+                throw std::runtime_error{"error: device \"" +
+                                         std::string{name} +
+                                         "\" is not suitable."};
+            }
+            hasMatch = true;
         }
 
-        if (mPhysicalDevice)
+        if (isSuitable && (!chosen || bestRating < rating))
         {
-            throw std::runtime_error{
-                "error: there are no devices that support Vulkan."};
+            chosen     = i;
+            bestRating = rating;
+        }
+    }
+
+    if (!chosen)
+    {
+        if (mSettings.device.empty())
+        {
+            throw std::runtime_error{"error: there are no suitable devices."};
+        }
+
+        throw std::runtime_error{
+            hasMatch ? "error: no device matching \"" + mSettings.device +
+                           "\" is suitable."
+                     : "error: there is no device \"" + mSettings.device +
+                           "\"."};
+    }
+
+    mPhysicalDevice = devices[*chosen];
+    mDeviceName     = mPhysicalDevice.getProperties().deviceName;
+    mMSAASamples    = chooseSampleCount();
+
+    // Linked GPUs show up as one group with several devices in it.
+    for (auto const& group : mInstance->enumeratePhysicalDeviceGroups())
+    {
+        for (std::uint32_t i{0}; i < group.physicalDeviceCount; ++i)
+        {
+            if (group.physicalDevices[i] == mPhysicalDevice)
+            {
+                mDeviceGroupSize = group.physicalDeviceCount;
+            }
         }
     }
+
+    fmt::print("using device {}: {}, {} device(s) in its group\n",
+               *chosen,
+               mDeviceName,
+               mDeviceGroupSize);
 }
 
 bool Application::isDeviceSuitable(vk::PhysicalDevice const& device)
@@ -424,10 +791,11 @@ bool Application::isDeviceSuitable(vk::PhysicalDevice const& device)
     bool isDeviceValid =
         deviceProperties.deviceType == vk::PhysicalDeviceType::eDiscreteGpu ||
         deviceProperties.deviceType == vk::PhysicalDeviceType::eIntegratedGpu;
-    bool areExtensionsSupported = checkDeviceExtensionSupport(device);
+    bool areExtensionsSupported =
+        mSettings.headless || checkDeviceExtensionSupport(device);
 
-    bool isSwapChainAdequate{false};
-    if (areExtensionsSupported)
+    bool isSwapChainAdequate{mSettings.headless};
+    if (areExtensionsSupported && !mSettings.headless)
     {
         auto swapChainDetails = querySwapChainSupport(device);
         isSwapChainAdequate   = !swapChainDetails.formats.empty() &&
@@ -438,6 +806,61 @@ bool Application::isDeviceSuitable(vk::PhysicalDevice const& device)
            isSwapChainAdequate && deviceFeatures.samplerAnisotropy;
 }
 
+DeviceRating Application::rateDevice(vk::PhysicalDevice const& device)
+{
+    DeviceRating rating;
+
+    auto deviceType = device.getProperties().deviceType;
+    if (deviceType == vk::PhysicalDeviceType::eDiscreteGpu)
+    {
+        rating.type = 2;
+    }
+    else if (deviceType == vk::PhysicalDeviceType::eIntegratedGpu)
+    {
+        rating.type = 1;
+    }
+
+    // Integrated GPUs often mark their share of system memory as device
+    // local too, which is why the kind of GPU is compared first.
+    auto memProperties = device.getMemoryProperties();
+    for (std::uint32_t i{0}; i < memProperties.memoryHeapCount; ++i)
+    {
+        auto const& heap = memProperties.memoryHeaps[i];
+        if (heap.flags & vk::MemoryHeapFlagBits::eDeviceLocal)
+        {
+            rating.localMemory += heap.size / (1024 * 1024);
+        }
+    }
+
+    // A family with transfers but no compute is usually a copy engine, and
+    // one with compute but no graphics runs compute asynchronously.
+    bool hasCopyFamily{false};
+    bool hasComputeFamily{false};
+    for (auto const& queueFamily : device.getQueueFamilyProperties())
+    {
+        if (queueFamily.queueCount == 0 ||
+            queueFamily.queueFlags & vk::QueueFlagBits::eGraphics)
+        {
+            continue;
+        }
+
+        if (queueFamily.queueFlags & vk::QueueFlagBits::eCompute)
+        {
+            hasComputeFamily = true;
+        }
+        else if (queueFamily.queueFlags & vk::QueueFlagBits::eTransfer)
+        {
+            hasCopyFamily = true;
+        }
+    }
+    rating.queues = static_cast<std::uint32_t>(hasCopyFamily) +
+                    static_cast<std::uint32_t>(hasComputeFamily);
+
+    rating.samples =
+        static_cast<std::uint32_t>(getMaxUsableSampleCount(device));
+    return rating;
+}
+
 QueueFamilyIndices
 Application::findQueueFamilies(vk::PhysicalDevice const& device)
 {
@@ -445,6 +868,8 @@ Application::findQueueFamilies(vk::PhysicalDevice const& device)
 
     std::vector<vk::QueueFamilyProperties> queueFamilies =
         device.getQueueFamilyProperties();
+    std::optional<std::uint32_t> transferOnlyFamily;
+    std::optional<std::uint32_t> asyncTransferFamily;
     std::uint32_t i{0};
     for (auto const& queueFamily : queueFamilies)
     {
@@ -454,14 +879,59 @@ Application::findQueueFamilies(vk::PhysicalDevice const& device)
             indices.graphicsFamily = i;
         }
 
-        vk::Bool32 presetSupport = device.getSurfaceSupportKHR(i, *mSurface);
-        if (queueFamily.queueCount > 0 && presetSupport)
+        // Families without graphics support map to the copy engines on most
+        // hardware, so prefer those for uploads.
+        if (queueFamily.queueCount > 0 &&
+            queueFamily.queueFlags & vk::QueueFlagBits::eTransfer &&
+            !(queueFamily.queueFlags & vk::QueueFlagBits::eGraphics))
+        {
+            if (!(queueFamily.queueFlags & vk::QueueFlagBits::eCompute))
+            {
+                if (!transferOnlyFamily)
+                {
+                    transferOnlyFamily = i;
+                }
+            }
+            else if (!asyncTransferFamily)
+            {
+                asyncTransferFamily = i;
+            }
+        }
+
+        if (!mSettings.headless)
         {
-            indices.presentFamily = i;
+            vk::Bool32 presetSupport =
+                device.getSurfaceSupportKHR(i, *mSurface);
+            if (queueFamily.queueCount > 0 && presetSupport)
+            {
+                indices.presentFamily = i;
+            }
         }
         ++i;
     }
 
+    // Nothing is presented when headless, so the graphics family stands in
+    // for the present one.
+    if (mSettings.headless)
+    {
+        indices.presentFamily = indices.graphicsFamily;
+    }
+
+    // Graphics queues always support transfers, so fall back to that if there
+    // is nothing better.
+    if (transferOnlyFamily)
+    {
+        indices.transferFamily = transferOnlyFamily;
+    }
+    else if (asyncTransferFamily)
+    {
+        indices.transferFamily = asyncTransferFamily;
+    }
+    else
+    {
+        indices.transferFamily = indices.graphicsFamily;
+    }
+
     return indices;
 }
 
@@ -471,7 +941,8 @@ void Application::createLogicalDevice()
 
     std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
     std::set<std::uint32_t> uniqueQueueFamilies{*indices.graphicsFamily,
-                                                *indices.presentFamily};
+                                                *indices.presentFamily,
+                                                *indices.transferFamily};
 
     float queuePriority{1.0f};
     for (auto queueFamily : uniqueQueueFamilies)
@@ -483,8 +954,132 @@ void Application::createLogicalDevice()
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    auto supportedFeatures = mPhysicalDevice.getFeatures();
+    auto queueFamilies     = mPhysicalDevice.getQueueFamilyProperties();
+    mGpuCulling = globals::enableGpuCulling && mSettings.gpuCulling &&
+                  supportedFeatures.multiDrawIndirect &&
+                  supportedFeatures.drawIndirectFirstInstance &&
+                  (queueFamilies[*indices.graphicsFamily].queueFlags &
+                   vk::QueueFlagBits::eCompute);
+
     vk::PhysicalDeviceFeatures deviceFeatures;
-    deviceFeatures.samplerAnisotropy = true;
+    deviceFeatures.samplerAnisotropy         = true;
+    deviceFeatures.multiDrawIndirect         = mGpuCulling;
+    deviceFeatures.drawIndirectFirstInstance = mGpuCulling;
+
+    // Shading every sample only makes a difference with more than one.
+    mHasSampleShading = supportedFeatures.sampleRateShading &&
+                        mMSAASamples != vk::SampleCountFlagBits::e1;
+    deviceFeatures.sampleRateShading = mHasSampleShading;
+
+    mSupportedFeatures = globals::variantFeatures & featureTexture;
+    if (mHasSampleShading)
+    {
+        mSupportedFeatures |= globals::variantFeatures & featureSampleShading;
+    }
+    mMeshFeatures = globals::meshFeatures & mSupportedFeatures;
+    if (!mSettings.texture)
+    {
+        mMeshFeatures &= ~featureTexture;
+    }
+    mDepthPrepass = globals::enableDepthPrepass && mSettings.depthPrepass;
+
+    // The draw count is optional, without it every instance gets a command.
+    std::vector<char const*> extensions;
+    if (!mSettings.headless)
+    {
+        extensions = globals::deviceExtensions;
+    }
+
+    // So is descriptor indexing. All the texture array needs from it is to be
+    // partially bound and updatable while in use. Indices come from push
+    // constants, so they are always uniform.
+    auto available = mPhysicalDevice.enumerateDeviceExtensionProperties();
+    vk::PhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures;
+    if (std::any_of(
+            available.begin(), available.end(), [](auto const& extension) {
+                return compareExtensions(
+                    VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME, extension);
+            }))
+    {
+        auto featureChain = mPhysicalDevice.getFeatures2<
+            vk::PhysicalDeviceFeatures2,
+            vk::PhysicalDeviceDescriptorIndexingFeaturesEXT>();
+        auto const& supported =
+            featureChain.get<vk::PhysicalDeviceDescriptorIndexingFeaturesEXT>();
+        mBindlessTextures =
+            supported.descriptorBindingPartiallyBound &&
+            supported.descriptorBindingSampledImageUpdateAfterBind;
+    }
+
+    auto limits      = mPhysicalDevice.getProperties().limits;
+    mTextureCapacity = std::min({globals::maxBindlessTextures,
+                                 limits.maxPerStageDescriptorSampledImages,
+                                 limits.maxDescriptorSetSampledImages});
+    if (mBindlessTextures)
+    {
+        extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        indexingFeatures.descriptorBindingPartiallyBound = true;
+        indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = true;
+
+        auto propertyChain = mPhysicalDevice.getProperties2<
+            vk::PhysicalDeviceProperties2,
+            vk::PhysicalDeviceDescriptorIndexingPropertiesEXT>();
+        auto const& indexingLimits = propertyChain.get<
+            vk::PhysicalDeviceDescriptorIndexingPropertiesEXT>();
+        mTextureCapacity = std::min(
+            {mTextureCapacity,
+             indexingLimits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+             indexingLimits.maxDescriptorSetUpdateAfterBindSampledImages});
+    }
+
+    // Without a memory budget texture streaming settles for a share of the
+    // device local heap.
+    mHasMemoryBudget = std::any_of(
+        available.begin(), available.end(), [](auto const& extension) {
+            return compareExtensions(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+                                     extension);
+        });
+    if (mHasMemoryBudget)
+    {
+        extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
+    vk::PhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures;
+    if (globals::enableTimelineSemaphores &&
+        std::any_of(
+            available.begin(), available.end(), [](auto const& extension) {
+                return compareExtensions(
+                    VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME, extension);
+            }))
+    {
+        auto featureChain = mPhysicalDevice.getFeatures2<
+            vk::PhysicalDeviceFeatures2,
+            vk::PhysicalDeviceTimelineSemaphoreFeaturesKHR>();
+        mHasTimelineSemaphore =
+            featureChain.get<vk::PhysicalDeviceTimelineSemaphoreFeaturesKHR>()
+                .timelineSemaphore;
+    }
+
+    if (mHasTimelineSemaphore)
+    {
+        extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+        timelineFeatures.timelineSemaphore = true;
+    }
+
+    if (mGpuCulling)
+    {
+        mHasDrawIndirectCount = std::any_of(
+            available.begin(), available.end(), [](auto const& extension) {
+                return compareExtensions(
+                    VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME, extension);
+            });
+        if (mHasDrawIndirectCount)
+        {
+            extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        }
+    }
+
     std::uint32_t layerCount =
         (globals::enableValidationLayers)
             ? static_cast<std::uint32_t>(globals::validationLayers.size())
@@ -500,13 +1095,52 @@ void Application::createLogicalDevice()
     createInfo.enabledLayerCount   = layerCount;
     createInfo.ppEnabledLayerNames = layerNames;
     createInfo.enabledExtensionCount =
-        static_cast<std::uint32_t>(globals::deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = globals::deviceExtensions.data();
-    createInfo.pEnabledFeatures        = &deviceFeatures;
+        static_cast<std::uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
+
+    // Extension features can only be enabled through the features2 chain.
+    vk::PhysicalDeviceFeatures2 enabledFeatures;
+    enabledFeatures.features = deviceFeatures;
+    enabledFeatures.pNext    = mBindlessTextures ? &indexingFeatures : nullptr;
+    createInfo.pNext         = &enabledFeatures;
+    if (mHasTimelineSemaphore)
+    {
+        timelineFeatures.pNext = enabledFeatures.pNext;
+        enabledFeatures.pNext  = &timelineFeatures;
+    }
 
     mDevice        = mPhysicalDevice.createDeviceUnique(createInfo);
     mGraphicsQueue = mDevice->getQueue(*indices.graphicsFamily, 0);
     mPresentQueue  = mDevice->getQueue(*indices.presentFamily, 0);
+    mTransferQueue = mDevice->getQueue(*indices.transferFamily, 0);
+
+    if (mHasDrawIndirectCount)
+    {
+        globals::pfnVkCmdDrawIndexedIndirectCountKHR =
+            reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+                mDevice->getProcAddr("vkCmdDrawIndexedIndirectCountKHR"));
+        mHasDrawIndirectCount =
+            globals::pfnVkCmdDrawIndexedIndirectCountKHR != nullptr;
+    }
+
+    mAllocator.init(mPhysicalDevice, *mDevice);
+    mFrameScheduler.init(*mDevice,
+                         mGraphicsQueue,
+                         mHasTimelineSemaphore,
+                         mSettings.framesInFlight);
+    mDeletionQueue.init(mFrameScheduler, mAllocator);
+
+    std::string shaderRoot{ShaderPath};
+    mPipelineCache.init(
+        mPhysicalDevice, *mDevice, shaderRoot + "pipeline.cache");
+
+    if constexpr (globals::enableGpuProfiling)
+    {
+        mGpuProfiler.init(mPhysicalDevice,
+                          *mDevice,
+                          *indices.graphicsFamily,
+                          mSettings.framesInFlight);
+    }
 }
 
 void Application::createSurface()
@@ -531,27 +1165,13 @@ bool Application::checkDeviceExtensionSupport(vk::PhysicalDevice const& device)
 SwapChainSupportDetails
 Application::querySwapChainSupport(vk::PhysicalDevice const& device)
 {
-    SwapChainSupportDetails details;
-    details.capabilities = device.getSurfaceCapabilitiesKHR(*mSurface);
-    details.formats      = device.getSurfaceFormatsKHR(*mSurface);
-    details.presentModes = device.getSurfacePresentModesKHR(*mSurface);
-
-    return details;
+    return core::querySwapChainSupport(device, *mSurface);
 }
 
 vk::SurfaceFormatKHR Application::chooseSwapSurfaceFormat(
     std::vector<vk::SurfaceFormatKHR> const& availableFormats)
 {
-    for (auto const& availableFormat : availableFormats)
-    {
-        if (availableFormat.format == vk::Format::eB8G8R8A8Unorm &&
-            availableFormat.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear)
-        {
-            return availableFormat;
-        }
-    }
-
-    return availableFormats[0];
+    return core::chooseSwapSurfaceFormat(availableFormats);
 }
 
 vk::PresentModeKHR Application::chooseSwapPresentMode(
@@ -559,42 +1179,28 @@ vk::PresentModeKHR Application::chooseSwapPresentMode(
 {
     for (auto const& availablePresentMode : availablePresentModes)
     {
-        if (availablePresentMode == vk::PresentModeKHR::eMailbox)
+        if (availablePresentMode == mSettings.presentMode)
         {
             return availablePresentMode;
         }
     }
 
+    if (mSettings.isPresentModeRequested)
+    {
+        fmt::print("warning: requested present mode is not supported, "
+                   "falling back to FIFO.\n");
+    }
+
     return vk::PresentModeKHR::eFifo;
 }
 
 vk::Extent2D
 Application::chooseSwapExtent(vk::SurfaceCapabilitiesKHR const& capabilities)
 {
-    if (capabilities.currentExtent.width !=
-        std::numeric_limits<std::uint32_t>::max())
-    {
-        return capabilities.currentExtent;
-    }
-    else
-    {
-        int width, height;
-        glfwGetFramebufferSize(mWindow, &width, &height);
-        vk::Extent2D actualExtent = {static_cast<std::uint32_t>(width),
-                                     static_cast<std::uint32_t>(height)};
-
-        actualExtent.width = std::max(
-            capabilities.minImageExtent.width,
-            std::min(capabilities.maxImageExtent.width, actualExtent.width));
-        actualExtent.height = std::max(
-            capabilities.minImageExtent.height,
-            std::min(capabilities.maxImageExtent.height, actualExtent.height));
-
-        return actualExtent;
-    }
+    return core::chooseSwapExtent(capabilities, mWindow);
 }
 
-void Application::createSwapChain()
+void Application::createSwapChain(vk::SwapchainKHR oldSwapchain)
 {
     SwapChainSupportDetails swapChainDetails =
         querySwapChainSupport(mPhysicalDevice);
@@ -646,6 +1252,7 @@ void Application::createSwapChain()
     createInfo.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque;
     createInfo.presentMode    = presentMode;
     createInfo.clipped        = true;
+    createInfo.oldSwapchain   = oldSwapchain;
 
     mSwapchain            = mDevice->createSwapchainKHRUnique(createInfo);
     mSwapchainImages      = mDevice->getSwapchainImagesKHR(*mSwapchain);
@@ -653,6 +1260,36 @@ void Application::createSwapChain()
     mSwapchainExtent      = extent;
 }
 
+void Application::createOffscreenTargets()
+{
+    // One target per frame in flight means the frame's slot being free is
+    // all that is needed to know its target is free again.
+    mSwapchainImageFormat = globals::offscreenFormat;
+    mSwapchainExtent      = vk::Extent2D{globals::windowWidth,
+                                    globals::windowHeight};
+
+    mOffscreenImages.resize(mSettings.framesInFlight);
+    mOffscreenImageMemory.resize(mSettings.framesInFlight);
+    mSwapchainImages.resize(mSettings.framesInFlight);
+    for (std::size_t i{0}; i < mOffscreenImages.size(); ++i)
+    {
+        vk::Image image;
+        createImage(mSwapchainExtent.width,
+                    mSwapchainExtent.height,
+                    1,
+                    vk::SampleCountFlagBits::e1,
+                    mSwapchainImageFormat,
+                    vk::ImageTiling::eOptimal,
+                    vk::ImageUsageFlagBits::eColorAttachment |
+                        vk::ImageUsageFlagBits::eTransferSrc,
+                    vk::MemoryPropertyFlagBits::eDeviceLocal,
+                    image,
+                    mOffscreenImageMemory[i]);
+        mOffscreenImages[i] = vk::UniqueImage(image, *mDevice);
+        mSwapchainImages[i] = image;
+    }
+}
+
 void Application::createImageViews()
 {
     mSwapchainImageViews.resize(mSwapchainImages.size());
@@ -670,8 +1307,8 @@ void Application::createImageViews()
 void Application::createGraphicsPipeline()
 {
     std::string root{ShaderPath};
-    auto vertexShaderCode   = readFile(root + "triangle.vert.spv");
-    auto fragmentShaderCode = readFile(root + "triangle.frag.spv");
+    auto vertexShaderCode   = core::readFile(root + "triangle.vert.spv");
+    auto fragmentShaderCode = core::readFile(root + "triangle.frag.spv");
 
     vk::UniqueShaderModule vertModule = createShaderModule(vertexShaderCode);
     vk::UniqueShaderModule fragModule = createShaderModule(fragmentShaderCode);
@@ -686,15 +1323,64 @@ void Application::createGraphicsPipeline()
     fragShaderInfo.module = *fragModule;
     fragShaderInfo.pName  = "main";
 
+    // The texture array is sized by a specialisation constant, since the
+    // device limits are only known at runtime. Whether the variant samples
+    // the texture at all is another, seen by both stages.
+    ShaderConstants constants;
+    constants.textureCount = mTextureCapacity;
+    constants.textured     = true;
+
+    std::array<vk::SpecializationMapEntry, 2> constantEntries;
+    constantEntries[0].constantID = 0;
+    constantEntries[0].offset     = offsetof(ShaderConstants, textureCount);
+    constantEntries[0].size       = sizeof(std::uint32_t);
+    constantEntries[1].constantID = 1;
+    constantEntries[1].offset     = offsetof(ShaderConstants, textured);
+    constantEntries[1].size       = sizeof(vk::Bool32);
+
+    vk::SpecializationInfo vertSpecialisation;
+    vertSpecialisation.mapEntryCount = 1;
+    vertSpecialisation.pMapEntries   = &constantEntries[1];
+    vertSpecialisation.dataSize      = sizeof(ShaderConstants);
+    vertSpecialisation.pData         = &constants;
+    vertShaderInfo.pSpecializationInfo = &vertSpecialisation;
+
+    vk::SpecializationInfo fragSpecialisation;
+    fragSpecialisation.mapEntryCount =
+        static_cast<std::uint32_t>(constantEntries.size());
+    fragSpecialisation.pMapEntries = constantEntries.data();
+    fragSpecialisation.dataSize    = sizeof(ShaderConstants);
+    fragSpecialisation.pData       = &constants;
+    fragShaderInfo.pSpecializationInfo = &fragSpecialisation;
+
     std::array<vk::PipelineShaderStageCreateInfo, 2> shaderStages{
         vertShaderInfo, fragShaderInfo};
 
-    auto bindingDescription    = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+    constexpr auto instanceBinding = globals::VertexLayout::bindingCount;
+    std::vector<vk::VertexInputBindingDescription> bindingDescriptions;
+    for (auto const& binding : globals::VertexLayout::getBindingDescriptions())
+    {
+        bindingDescriptions.push_back(binding);
+    }
+    bindingDescriptions.push_back(
+        InstanceData::getBindingDescription(instanceBinding));
+
+    std::vector<vk::VertexInputAttributeDescription> attributeDescriptions;
+    for (auto const& attribute :
+         globals::VertexLayout::getAttributeDescriptions())
+    {
+        attributeDescriptions.push_back(attribute);
+    }
+    for (auto const& attribute :
+         InstanceData::getAttributeDescriptions(instanceBinding))
+    {
+        attributeDescriptions.push_back(attribute);
+    }
 
     vk::PipelineVertexInputStateCreateInfo vertexInputInfo;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions    = &bindingDescription;
+    vertexInputInfo.vertexBindingDescriptionCount =
+        static_cast<std::uint32_t>(bindingDescriptions.size());
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
     vertexInputInfo.vertexAttributeDescriptionCount =
         static_cast<std::uint32_t>(attributeDescriptions.size());
     vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
@@ -703,18 +1389,6 @@ void Application::createGraphicsPipeline()
     inputAssembly.topology               = vk::PrimitiveTopology::eTriangleList;
     inputAssembly.primitiveRestartEnable = false;
 
-    vk::Viewport viewport;
-    viewport.x        = 0.0f;
-    viewport.y        = 0.0f;
-    viewport.width    = static_cast<float>(mSwapchainExtent.width);
-    viewport.height   = static_cast<float>(mSwapchainExtent.height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    vk::Rect2D scissor;
-    scissor.offset = {0, 0};
-    scissor.extent = mSwapchainExtent;
-
     vk::PipelineDepthStencilStateCreateInfo depthStencil;
     depthStencil.depthTestEnable       = true;
     depthStencil.depthWriteEnable      = true;
@@ -722,11 +1396,11 @@ void Application::createGraphicsPipeline()
     depthStencil.depthBoundsTestEnable = false;
     depthStencil.stencilTestEnable     = false;
 
+    // The viewport and scissor are set when recording, so the pipeline does
+    // not depend on the swap chain extent and survives a resize.
     vk::PipelineViewportStateCreateInfo viewportState;
     viewportState.viewportCount = 1;
-    viewportState.pViewports    = &viewport;
     viewportState.scissorCount  = 1;
-    viewportState.pScissors     = &scissor;
 
     vk::PipelineRasterizationStateCreateInfo rasterizer;
     rasterizer.depthClampEnable        = false;
@@ -761,16 +1435,27 @@ void Application::createGraphicsPipeline()
     colourBlending.pAttachments    = &colourBlendAttachment;
 
     std::array<vk::DynamicState, 2> dynamicStates{vk::DynamicState::eViewport,
-                                                  vk::DynamicState::eLineWidth};
+                                                  vk::DynamicState::eScissor};
     vk::PipelineDynamicStateCreateInfo dynamicState;
     dynamicState.dynamicStateCount =
         static_cast<std::uint32_t>(dynamicStates.size());
     dynamicState.pDynamicStates = dynamicStates.data();
 
+    std::array<vk::PushConstantRange, 2> pushConstantRanges;
+    pushConstantRanges[0].stageFlags = vk::ShaderStageFlagBits::eVertex;
+    pushConstantRanges[0].offset     = offsetof(DrawPushConstants, model);
+    pushConstantRanges[0].size       = sizeof(glm::mat4);
+    pushConstantRanges[1].stageFlags = vk::ShaderStageFlagBits::eFragment;
+    pushConstantRanges[1].offset = offsetof(DrawPushConstants, textureIndex);
+    pushConstantRanges[1].size   = sizeof(std::uint32_t);
+
     vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
     pipelineLayoutCreateInfo.setLayoutCount = 1;
     pipelineLayoutCreateInfo.pSetLayouts    = &(*mDescriptorSetLayout);
-    mPipelineLayout =
+    pipelineLayoutCreateInfo.pushConstantRangeCount =
+        static_cast<std::uint32_t>(pushConstantRanges.size());
+    pipelineLayoutCreateInfo.pPushConstantRanges = pushConstantRanges.data();
+    auto pipelineLayout =
         mDevice->createPipelineLayoutUnique(pipelineLayoutCreateInfo);
 
     vk::GraphicsPipelineCreateInfo pipelineInfo;
@@ -783,426 +1468,1106 @@ void Application::createGraphicsPipeline()
     pipelineInfo.pMultisampleState   = &multisampling;
     pipelineInfo.pColorBlendState    = &colourBlending;
     pipelineInfo.pDepthStencilState  = &depthStencil;
-    pipelineInfo.layout              = *mPipelineLayout;
-    pipelineInfo.renderPass          = *mRenderPass;
+    pipelineInfo.pDynamicState       = &dynamicState;
+    pipelineInfo.layout              = *pipelineLayout;
+    pipelineInfo.renderPass = mRenderGraph.getRenderPass(mScenePass);
     pipelineInfo.subpass             = 0;
     pipelineInfo.basePipelineIndex   = -1;
 
-    mGraphicsPipeline = mDevice->createGraphicsPipelineUnique({}, pipelineInfo);
-}
-
-vk::UniqueShaderModule
-Application::createShaderModule(std::vector<char> const& code)
-{
-    vk::ShaderModuleCreateInfo createInfo;
-    createInfo.codeSize = code.size();
-    createInfo.pCode    = reinterpret_cast<std::uint32_t const*>(code.data());
-    return mDevice->createShaderModuleUnique(createInfo);
-}
+    vk::UniquePipeline depthPipeline;
+    if (mDepthPrepass)
+    {
+        // The prepass has no fragment shader and writes no colour. It fetches
+        // the position stream and the instance matrices and nothing else,
+        // so it gets a vertex shader of its own.
+        auto positionBinding =
+            globals::VertexLayout::getPositionBindingDescription();
+        auto positionAttribute =
+            globals::VertexLayout::getPositionAttributeDescription();
+
+        std::array<vk::VertexInputBindingDescription, 2> depthBindings{
+            positionBinding, bindingDescriptions.back()};
+        std::vector<vk::VertexInputAttributeDescription> depthAttributes{
+            positionAttribute};
+        for (auto const& attribute :
+             InstanceData::getAttributeDescriptions(instanceBinding))
+        {
+            depthAttributes.push_back(attribute);
+        }
 
-void Application::createRenderPass()
-{
-    vk::AttachmentDescription colourAttachment;
-    colourAttachment.format         = mSwapchainImageFormat;
-    colourAttachment.samples        = mMSAASamples;
-    colourAttachment.loadOp         = vk::AttachmentLoadOp::eClear;
-    colourAttachment.storeOp        = vk::AttachmentStoreOp::eStore;
-    colourAttachment.stencilLoadOp  = vk::AttachmentLoadOp::eDontCare;
-    colourAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-    colourAttachment.initialLayout  = vk::ImageLayout::eUndefined;
-    colourAttachment.finalLayout    = vk::ImageLayout::eColorAttachmentOptimal;
-
-    vk::AttachmentDescription depthAttachment;
-    depthAttachment.format         = findDepthFormat();
-    depthAttachment.samples        = mMSAASamples;
-    depthAttachment.loadOp         = vk::AttachmentLoadOp::eClear;
-    depthAttachment.storeOp        = vk::AttachmentStoreOp::eDontCare;
-    depthAttachment.stencilLoadOp  = vk::AttachmentLoadOp::eDontCare;
-    depthAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-    depthAttachment.initialLayout  = vk::ImageLayout::eUndefined;
-    depthAttachment.finalLayout =
-        vk::ImageLayout::eDepthStencilAttachmentOptimal;
-
-    vk::AttachmentDescription colourResolveAttachment;
-    colourResolveAttachment.format         = mSwapchainImageFormat;
-    colourResolveAttachment.samples        = vk::SampleCountFlagBits::e1;
-    colourResolveAttachment.loadOp         = vk::AttachmentLoadOp::eDontCare;
-    colourResolveAttachment.storeOp        = vk::AttachmentStoreOp::eDontCare;
-    colourResolveAttachment.stencilLoadOp  = vk::AttachmentLoadOp::eDontCare;
-    colourResolveAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-    colourResolveAttachment.initialLayout  = vk::ImageLayout::eUndefined;
-    colourResolveAttachment.finalLayout    = vk::ImageLayout::ePresentSrcKHR;
-
-    vk::AttachmentReference colourAttachmentRef;
-    colourAttachmentRef.attachment = 0;
-    colourAttachmentRef.layout     = vk::ImageLayout::eColorAttachmentOptimal;
-
-    vk::AttachmentReference depthAttachmentRef;
-    depthAttachmentRef.attachment = 1;
-    depthAttachmentRef.layout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
-
-    vk::AttachmentReference colourAttachmentResolveRef;
-    colourAttachmentResolveRef.attachment = 2;
-    colourAttachmentResolveRef.layout =
-        vk::ImageLayout::eColorAttachmentOptimal;
-
-    vk::SubpassDescription subPass;
-    subPass.pipelineBindPoint       = vk::PipelineBindPoint::eGraphics;
-    subPass.colorAttachmentCount    = 1;
-    subPass.pColorAttachments       = &colourAttachmentRef;
-    subPass.pDepthStencilAttachment = &depthAttachmentRef;
-    subPass.pResolveAttachments     = &colourAttachmentResolveRef;
-
-    vk::SubpassDependency dependency;
-    dependency.srcSubpass   = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass   = 0;
-    dependency.srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-    dependency.dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-    dependency.dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead |
-                               vk::AccessFlagBits::eColorAttachmentWrite;
-
-    std::array<vk::AttachmentDescription, 3> attachments = {
-        colourAttachment, depthAttachment, colourResolveAttachment};
-    vk::RenderPassCreateInfo createInfo;
-    createInfo.attachmentCount = static_cast<std::uint32_t>(attachments.size());
-    createInfo.pAttachments    = attachments.data();
-    createInfo.subpassCount    = 1;
-    createInfo.pSubpasses      = &subPass;
-    createInfo.dependencyCount = 1;
-    createInfo.pDependencies   = &dependency;
-
-    mRenderPass = mDevice->createRenderPassUnique(createInfo);
-}
-
-void Application::createFramebuffers()
-{
-    mSwapchainFramebuffers.resize(mSwapchainImageViews.size());
-
-    for (std::size_t i{0}; i < mSwapchainImageViews.size(); ++i)
-    {
-        std::array<vk::ImageView, 3> attachments{
-            *mColourImageView, *mDepthImageView, *mSwapchainImageViews[i]};
-
-        vk::FramebufferCreateInfo createInfo;
-        createInfo.renderPass = *mRenderPass;
-        createInfo.attachmentCount =
-            static_cast<std::uint32_t>(attachments.size());
-        createInfo.pAttachments = attachments.data();
-        createInfo.width        = mSwapchainExtent.width;
-        createInfo.height       = mSwapchainExtent.height;
-        createInfo.layers       = 1;
-
-        mSwapchainFramebuffers[i] =
-            mDevice->createFramebufferUnique(createInfo);
+        // Only binding 0 and the instance binding are declared, which can
+        // leave a gap in the binding numbers. That is allowed.
+        vk::PipelineVertexInputStateCreateInfo depthInputInfo;
+        depthInputInfo.vertexBindingDescriptionCount =
+            static_cast<std::uint32_t>(depthBindings.size());
+        depthInputInfo.pVertexBindingDescriptions = depthBindings.data();
+        depthInputInfo.vertexAttributeDescriptionCount =
+            static_cast<std::uint32_t>(depthAttributes.size());
+        depthInputInfo.pVertexAttributeDescriptions = depthAttributes.data();
+
+        vk::PipelineColorBlendAttachmentState depthBlendAttachment;
+        depthBlendAttachment.blendEnable    = false;
+        depthBlendAttachment.colorWriteMask = {};
+
+        vk::PipelineColorBlendStateCreateInfo depthBlending;
+        depthBlending.attachmentCount = 1;
+        depthBlending.pAttachments    = &depthBlendAttachment;
+
+        auto depthShaderCode = core::readFile(root + "depth.vert.spv");
+        auto depthModule     = createShaderModule(depthShaderCode);
+
+        vk::PipelineShaderStageCreateInfo depthShaderInfo;
+        depthShaderInfo.stage  = vk::ShaderStageFlagBits::eVertex;
+        depthShaderInfo.module = *depthModule;
+        depthShaderInfo.pName  = "main";
+
+        vk::GraphicsPipelineCreateInfo depthPipelineInfo{pipelineInfo};
+        depthPipelineInfo.stageCount        = 1;
+        depthPipelineInfo.pStages           = &depthShaderInfo;
+        depthPipelineInfo.pVertexInputState = &depthInputInfo;
+        depthPipelineInfo.pColorBlendState  = &depthBlending;
+
+        depthPipeline = mDevice->createGraphicsPipelineUnique(
+            mPipelineCache.get(), depthPipelineInfo);
+
+        // The main pass now only shades the closest surface. Depth is already
+        // final, so there is no need to write it again.
+        depthStencil.depthWriteEnable = false;
+        depthStencil.depthCompareOp   = vk::CompareOp::eEqual;
     }
-}
 
-void Application::createCommandPool()
-{
-    auto indices = findQueueFamilies(mPhysicalDevice);
-    vk::CommandPoolCreateInfo createInfo;
-    createInfo.queueFamilyIndex = *indices.graphicsFamily;
+    // Walks every subset of the supported features, the full set first.
+    // Variants that differ only in pipeline state share their shader code
+    // through the pipeline cache.
+    std::map<ShaderFeatures, vk::UniquePipeline> variants;
+    for (ShaderFeatures variant{mSupportedFeatures};;
+         variant = (variant - 1) & mSupportedFeatures)
+    {
+        constants.textured = (variant & featureTexture) != 0;
+        multisampling.sampleShadingEnable =
+            (variant & featureSampleShading) != 0;
 
-    mCommandPool = mDevice->createCommandPoolUnique(createInfo);
+        variants[variant] = mDevice->createGraphicsPipelineUnique(
+            mPipelineCache.get(), pipelineInfo);
 
-    createInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
-    mBufferPool      = mDevice->createCommandPoolUnique(createInfo);
+        if (variant == 0)
+        {
+            break;
+        }
+    }
+
+    // Nothing is replaced until all of it has been built, so a rebuild that
+    // fails keeps the old pipelines. Frames in flight may still use those.
+    mDeletionQueue.retire(std::move(mPipelineLayout));
+    mDeletionQueue.retire(std::move(mDepthPipeline));
+    for (auto& variant : mPipelineVariants)
+    {
+        mDeletionQueue.retire(std::move(variant.second));
+    }
+    mPipelineLayout   = std::move(pipelineLayout);
+    mDepthPipeline    = std::move(depthPipeline);
+    mPipelineVariants = std::move(variants);
 }
 
-void Application::createCommandBuffers()
+void Application::createCullPipeline()
 {
-    mCommandBuffers.resize(mSwapchainFramebuffers.size());
+    if (!mGpuCulling)
+    {
+        return;
+    }
 
-    vk::CommandBufferAllocateInfo allocInfo;
-    allocInfo.commandPool = *mCommandPool;
-    allocInfo.level       = vk::CommandBufferLevel::ePrimary;
-    allocInfo.commandBufferCount =
-        static_cast<std::uint32_t>(mCommandBuffers.size());
+    std::string root{ShaderPath};
+    auto computeShaderCode = core::readFile(root + "cull.comp.spv");
+    auto computeModule     = createShaderModule(computeShaderCode);
 
-    mCommandBuffers = mDevice->allocateCommandBuffersUnique(allocInfo);
+    vk::PushConstantRange pushConstantRange;
+    pushConstantRange.stageFlags = vk::ShaderStageFlagBits::eCompute;
+    pushConstantRange.offset     = 0;
+    pushConstantRange.size       = sizeof(CullPushConstants);
 
-    for (std::size_t i{0}; i < mCommandBuffers.size(); ++i)
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+    pipelineLayoutCreateInfo.setLayoutCount         = 1;
+    pipelineLayoutCreateInfo.pSetLayouts            = &(*mCullSetLayout);
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges    = &pushConstantRange;
+    auto pipelineLayout =
+        mDevice->createPipelineLayoutUnique(pipelineLayoutCreateInfo);
+
+    vk::ComputePipelineCreateInfo pipelineInfo;
+    pipelineInfo.stage.stage  = vk::ShaderStageFlagBits::eCompute;
+    pipelineInfo.stage.module = *computeModule;
+    pipelineInfo.stage.pName  = "main";
+    pipelineInfo.layout       = *pipelineLayout;
+
+    auto pipeline = mDevice->createComputePipelineUnique(mPipelineCache.get(),
+                                                         pipelineInfo);
+
+    // As with the graphics pipelines, only replaced once both were built.
+    mDeletionQueue.retire(std::move(mCullPipelineLayout));
+    mDeletionQueue.retire(std::move(mCullPipeline));
+    mCullPipelineLayout = std::move(pipelineLayout);
+    mCullPipeline       = std::move(pipeline);
+}
+
+void Application::createMipmapPipeline()
+{
+    // The shader's images are declared as rgba8, so it only works for the
+    // one format, and only where that can be used as a storage image.
+    auto properties =
+        mPhysicalDevice.getFormatProperties(globals::mipmapFormat);
+    bool hasStorage = static_cast<bool>(
+        properties.optimalTilingFeatures &
+        vk::FormatFeatureFlagBits::eStorageImage);
+    if (!hasStorage || mSettings.mipmapMode == MipmapMode::eBlit)
     {
-        vk::CommandBufferBeginInfo beginInfo;
-        mCommandBuffers[i]->begin(beginInfo);
+        return;
+    }
 
-        std::array<vk::ClearValue, 2> clearValues;
-        clearValues[0].color =
-            vk::ClearColorValue{std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f}};
-        clearValues[1].depthStencil = {1.0f, 0};
+    // The level a dispatch starts from, then every level it writes.
+    std::vector<vk::DescriptorSetLayoutBinding> bindings(
+        globals::mipmapDispatchLevels + 1);
+    for (std::uint32_t i{0}; i < bindings.size(); ++i)
+    {
+        bindings[i].binding         = i;
+        bindings[i].descriptorType  = vk::DescriptorType::eStorageImage;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags      = vk::ShaderStageFlagBits::eCompute;
+    }
 
-        vk::RenderPassBeginInfo renderPassInfo;
-        renderPassInfo.renderPass  = *mRenderPass;
-        renderPassInfo.framebuffer = *mSwapchainFramebuffers[i];
-        renderPassInfo.renderArea  = {{0, 0}, mSwapchainExtent};
-        renderPassInfo.clearValueCount =
-            static_cast<std::uint32_t>(clearValues.size());
-        renderPassInfo.pClearValues = clearValues.data();
+    vk::DescriptorSetLayoutCreateInfo layoutInfo;
+    layoutInfo.bindingCount = static_cast<std::uint32_t>(bindings.size());
+    layoutInfo.pBindings    = bindings.data();
+    mMipmapSetLayout = mDevice->createDescriptorSetLayoutUnique(layoutInfo);
 
-        mCommandBuffers[i]->beginRenderPass(&renderPassInfo,
-                                            vk::SubpassContents::eInline);
+    std::string root{ShaderPath};
+    auto computeShaderCode = core::readFile(root + "mipmaps.comp.spv");
+    auto computeModule     = createShaderModule(computeShaderCode);
 
-        mCommandBuffers[i]->bindPipeline(vk::PipelineBindPoint::eGraphics,
-                                         *mGraphicsPipeline);
-        std::array<vk::Buffer, 1> vertexBuffers{*mVertexBuffer};
-        std::array<vk::DeviceSize, 1> offsets{0};
+    vk::PushConstantRange pushConstantRange;
+    pushConstantRange.stageFlags = vk::ShaderStageFlagBits::eCompute;
+    pushConstantRange.offset     = 0;
+    pushConstantRange.size       = sizeof(MipmapPushConstants);
 
-        mCommandBuffers[i]->bindVertexBuffers(0, vertexBuffers, offsets);
-        mCommandBuffers[i]->bindIndexBuffer(
-            *mIndexBuffer, 0, vk::IndexType::eUint32);
-        mCommandBuffers[i]->bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-                                               *mPipelineLayout,
-                                               0,
-                                               {*mDescriptorSets[i]},
-                                               {});
-        mCommandBuffers[i]->drawIndexed(
-            static_cast<std::uint32_t>(mIndices.size()), 1, 0, 0, 0);
-        mCommandBuffers[i]->endRenderPass();
-        mCommandBuffers[i]->end();
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+    pipelineLayoutCreateInfo.setLayoutCount         = 1;
+    pipelineLayoutCreateInfo.pSetLayouts            = &(*mMipmapSetLayout);
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges    = &pushConstantRange;
+    mMipmapPipelineLayout =
+        mDevice->createPipelineLayoutUnique(pipelineLayoutCreateInfo);
+
+    vk::ComputePipelineCreateInfo pipelineInfo;
+    pipelineInfo.stage.stage  = vk::ShaderStageFlagBits::eCompute;
+    pipelineInfo.stage.module = *computeModule;
+    pipelineInfo.stage.pName  = "main";
+    pipelineInfo.layout       = *mMipmapPipelineLayout;
+
+    mMipmapPipeline = mDevice->createComputePipelineUnique(
+        mPipelineCache.get(), pipelineInfo);
+}
+
+void Application::watchShaders()
+{
+    std::string root{ShaderPath};
+    mShaderWatcher.init(globals::shaderCompileFlags,
+                        globals::shaderPollInterval);
+    mShaderWatcher.watch(root + "triangle.vert");
+    mShaderWatcher.watch(root + "triangle.frag");
+    if (mDepthPrepass)
+    {
+        mShaderWatcher.watch(root + "depth.vert");
+    }
+    if (mGpuCulling)
+    {
+        mShaderWatcher.watch(root + "cull.comp");
     }
 }
 
-void Application::createSyncObjects()
+void Application::reloadShaders()
+{
+    auto compiled = mShaderWatcher.poll();
+    if (compiled.empty())
+    {
+        return;
+    }
+
+    std::string root{ShaderPath};
+    auto hasChanged = [&compiled, &root](char const* name) {
+        return std::find(compiled.begin(), compiled.end(), root + name) !=
+               compiled.end();
+    };
+
+    // The graphics and depth pipelines are built together, but whichever of
+    // them didn't change comes straight out of the pipeline cache. Buffers,
+    // textures and descriptors are left alone, and the old pipelines are
+    // retired rather than waited on.
+    try
+    {
+        if (hasChanged("triangle.vert") || hasChanged("triangle.frag") ||
+            hasChanged("depth.vert"))
+        {
+            createGraphicsPipeline();
+        }
+
+        if (hasChanged("cull.comp"))
+        {
+            createCullPipeline();
+        }
+    }
+    catch (std::exception const& error)
+    {
+        fmt::print("warning: unable to rebuild pipelines: {}.\n",
+                   error.what());
+        return;
+    }
+
+    for (auto const& source : compiled)
+    {
+        fmt::print("reloaded {}\n", source);
+    }
+}
+
+vk::UniqueShaderModule
+Application::createShaderModule(std::vector<char> const& code)
 {
-    mImageAvailableSemaphores.resize(globals::maxFramesInFlight);
-    mRenderFinishedSemaphores.resize(globals::maxFramesInFlight);
-    mInFlightFences.resize(globals::maxFramesInFlight);
+    vk::ShaderModuleCreateInfo createInfo;
+    createInfo.codeSize = code.size();
+    createInfo.pCode    = reinterpret_cast<std::uint32_t const*>(code.data());
+    return mDevice->createShaderModuleUnique(createInfo);
+}
+
+void Application::createRenderGraph()
+{
+    // Declared once per surface format. Only the swap chain images and the
+    // sizes change with the swap chain, see compileRenderGraph.
+    mRenderGraph.clear(mDeletionQueue);
+
+    vk::ClearValue clearColour;
+    clearColour.color =
+        vk::ClearColorValue{std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f}};
+    vk::ClearValue clearDepth;
+    clearDepth.depthStencil = vk::ClearDepthStencilValue{1.0f, 0};
+
+    // The present layout only exists with the swap chain extension. Offscreen
+    // targets are left ready to be read back instead.
+    mSwapchainResource = mRenderGraph.importImage(mSwapchainImageFormat,
+                                                  vk::SampleCountFlagBits::e1);
+    mRenderGraph.setFinalUsage(mSwapchainResource,
+                               (mSettings.headless)
+                                   ? ResourceUsage::eTransferRead
+                                   : ResourceUsage::ePresent);
+
+    auto depth = mRenderGraph.createImage(findDepthFormat(), mMSAASamples);
+    mRenderGraph.setClearValue(depth, clearDepth);
+
+    // Both draw buffers have a slice per frame in flight.
+    auto drawCommands = mRenderGraph.importBuffer(true);
+    auto drawCount    = mRenderGraph.importBuffer(true);
+    if (mGpuCulling)
+    {
+        auto clear = mRenderGraph.addPass(
+            "clear draw count", false, [this](PassContext const& context) {
+                context.commandBuffer.fillBuffer(
+                    *mDrawCountBuffer,
+                    context.frame * mDrawCountSliceSize,
+                    sizeof(std::uint32_t),
+                    0);
+            });
+        mRenderGraph.use(clear, drawCount, ResourceUsage::eTransferWrite);
+
+        auto cull = mRenderGraph.addPass(
+            "cull", false, [this](PassContext const& context) {
+                recordCulling(context.commandBuffer, context.frame);
+            });
+        mRenderGraph.use(cull, drawCommands, ResourceUsage::eComputeWrite);
+        mRenderGraph.use(cull, drawCount, ResourceUsage::eComputeWrite);
+    }
 
-    vk::SemaphoreCreateInfo semaphoreInfo{};
-    vk::FenceCreateInfo fenceInfo{vk::FenceCreateFlagBits::eSignaled};
+    // The MSAA resolve happens as the subpass ends, so it is part of this
+    // scope. There is no way to time it on its own without a separate pass.
+    mScenePass = mRenderGraph.addPass(
+        "render pass", true, [this](PassContext const& context) {
+            recordScenePass(context);
+        });
+    if (mGpuCulling)
+    {
+        mRenderGraph.use(
+            mScenePass, drawCommands, ResourceUsage::eIndirectRead);
+        mRenderGraph.use(mScenePass, drawCount, ResourceUsage::eIndirectRead);
+    }
 
-    for (std::size_t i{0}; i < globals::maxFramesInFlight; ++i)
+    // Only the resolved image is ever stored. The samples are resolved on
+    // tile at the end of the subpass and depth is thrown away, which is what
+    // lets both live in transient memory. Resolving needs more than one
+    // sample though, so with one we render straight to the final image.
+    if (mMSAASamples == vk::SampleCountFlagBits::e1)
+    {
+        mRenderGraph.setClearValue(mSwapchainResource, clearColour);
+        mRenderGraph.use(
+            mScenePass, mSwapchainResource, ResourceUsage::eColourAttachment);
+    }
+    else
     {
-        mImageAvailableSemaphores[i] =
-            mDevice->createSemaphoreUnique(semaphoreInfo);
-        mRenderFinishedSemaphores[i] =
-            mDevice->createSemaphoreUnique(semaphoreInfo);
-        mInFlightFences[i] = mDevice->createFenceUnique(fenceInfo);
+        auto colour =
+            mRenderGraph.createImage(mSwapchainImageFormat, mMSAASamples);
+        mRenderGraph.setClearValue(colour, clearColour);
+        mRenderGraph.use(mScenePass, colour, ResourceUsage::eColourAttachment);
+        mRenderGraph.use(
+            mScenePass, mSwapchainResource, ResourceUsage::eResolveAttachment);
     }
+    mRenderGraph.use(mScenePass, depth, ResourceUsage::eDepthAttachment);
+
+    compileRenderGraph();
+    fmt::print("render graph: {} barrier(s), {} -> {} bytes of transient "
+               "memory\n",
+               mRenderGraph.getBarrierCount(),
+               mRenderGraph.getTransientSize(),
+               mRenderGraph.getAliasedSize());
 }
 
-void Application::drawFrame()
+void Application::compileRenderGraph()
+{
+    std::vector<vk::ImageView> views;
+    for (auto const& view : mSwapchainImageViews)
+    {
+        views.push_back(*view);
+    }
+
+    mRenderGraph.setImages(mSwapchainResource, mSwapchainImages, views);
+    mRenderGraph.compile(
+        *mDevice, mAllocator, mDeletionQueue, mSwapchainExtent);
+}
+
+void Application::createCommandPool()
+{
+    auto indices = findQueueFamilies(mPhysicalDevice);
+    vk::CommandPoolCreateInfo createInfo;
+    createInfo.flags            = vk::CommandPoolCreateFlagBits::eTransient;
+    createInfo.queueFamilyIndex = *indices.graphicsFamily;
+
+    mJobSystem.init(std::max(std::thread::hardware_concurrency(), 1u));
+
+    mFrameCommands.resize(mSettings.framesInFlight);
+    for (auto& frame : mFrameCommands)
+    {
+        frame.commandPool = mDevice->createCommandPoolUnique(createInfo);
+
+        frame.threads.resize(mJobSystem.getThreadCount());
+        for (auto& thread : frame.threads)
+        {
+            thread.commandPool = mDevice->createCommandPoolUnique(createInfo);
+        }
+    }
+
+    mUploadContext.init(*mDevice,
+                        mAllocator,
+                        *indices.transferFamily,
+                        mTransferQueue,
+                        *indices.graphicsFamily,
+                        mFrameScheduler,
+                        mDeletionQueue);
+}
+
+void Application::createCommandBuffers()
+{
+    for (auto& frame : mFrameCommands)
+    {
+        vk::CommandBufferAllocateInfo allocInfo;
+        allocInfo.commandPool        = *frame.commandPool;
+        allocInfo.level              = vk::CommandBufferLevel::ePrimary;
+        allocInfo.commandBufferCount = 1;
+
+        frame.commandBuffer =
+            std::move(mDevice->allocateCommandBuffersUnique(allocInfo)[0]);
+
+        for (auto& thread : frame.threads)
+        {
+            allocInfo.commandPool = *thread.commandPool;
+            allocInfo.level       = vk::CommandBufferLevel::eSecondary;
+            thread.commandBuffer =
+                std::move(mDevice->allocateCommandBuffersUnique(allocInfo)[0]);
+        }
+    }
+}
+
+void Application::recordCommandBuffer(std::size_t frame,
+                                      std::uint32_t imageIndex)
 {
-    mDevice->waitForFences({*mInFlightFences[mCurrentFrame]},
-                           VK_TRUE,
-                           std::numeric_limits<std::uint64_t>::max());
+    // The scheduler is past this frame's last submission, so nothing
+    // recorded from this pool can still be executing.
+    auto& frameCommands = mFrameCommands[frame];
+    mDevice->resetCommandPool(*frameCommands.commandPool, {});
+
+    auto commandBuffer = *frameCommands.commandBuffer;
+
+    vk::CommandBufferBeginInfo beginInfo;
+    beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+    commandBuffer.begin(beginInfo);
+    auto slot = static_cast<std::uint32_t>(frame);
+    mGpuProfiler.beginFrame(commandBuffer, slot);
+
+    if (!mGpuCulling)
+    {
+        cullClusters();
+    }
+
+    // Every pass is timed in a scope of its own name.
+    bool isInline = !globals::useSecondaryCommandBuffers && mRecordThreads == 1;
+    mRenderGraph.setSubpassContents(
+        mScenePass,
+        (isInline) ? vk::SubpassContents::eInline
+                   : vk::SubpassContents::eSecondaryCommandBuffers);
+
+    PassContext context;
+    context.commandBuffer = commandBuffer;
+    context.frame         = frame;
+    context.imageIndex    = imageIndex;
+    mRenderGraph.execute(context, mGpuProfiler, slot);
+    commandBuffer.end();
+}
+
+void Application::recordScenePass(PassContext const& context)
+{
+    if (context.contents == vk::SubpassContents::eInline)
+    {
+        recordScene(
+            context.commandBuffer, context.frame, 0, mVisibleDraws.size());
+        return;
+    }
+
+    // Each thread records an even share of the draw list into its own
+    // secondary buffer. They are executed in thread order so the draw order
+    // is the same as when recording inline.
+    std::size_t threadCount = mRecordThreads;
+    std::size_t drawCount   = mVisibleDraws.size();
+    std::vector<vk::CommandBuffer> secondaries(threadCount);
+    mJobSystem.dispatch(threadCount, [&](std::size_t thread) {
+        std::size_t first = drawCount * thread / threadCount;
+        std::size_t last  = drawCount * (thread + 1) / threadCount;
+
+        auto secondary =
+            beginSecondaryCommandBuffer(context.frame, thread, context);
+        recordScene(secondary, context.frame, first, last - first);
+        secondary.end();
+        secondaries[thread] = secondary;
+    });
+
+    context.commandBuffer.executeCommands(secondaries);
+}
+
+vk::CommandBuffer
+Application::beginSecondaryCommandBuffer(std::size_t frame,
+                                         std::size_t thread,
+                                         PassContext const& context)
+{
+    // Only the thread that owns the pool ever touches it, so it can reset it
+    // here without any locking.
+    auto& threadCommands = mFrameCommands[frame].threads[thread];
+    mDevice->resetCommandPool(*threadCommands.commandPool, {});
+
+    vk::CommandBufferInheritanceInfo inheritanceInfo;
+    inheritanceInfo.renderPass  = context.renderPass;
+    inheritanceInfo.subpass     = 0;
+    inheritanceInfo.framebuffer = context.framebuffer;
+
+    vk::CommandBufferBeginInfo beginInfo;
+    beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit |
+                      vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    auto commandBuffer = *threadCommands.commandBuffer;
+    commandBuffer.begin(beginInfo);
+    return commandBuffer;
+}
+
+void Application::recordScene(vk::CommandBuffer const& commandBuffer,
+                              std::size_t frame,
+                              std::size_t firstDraw,
+                              std::size_t drawCount)
+{
+    // Secondary command buffers don't inherit any state from the primary, so
+    // everything the draws need is bound here.
+    vk::Viewport viewport;
+    viewport.x        = 0.0f;
+    viewport.y        = 0.0f;
+    viewport.width    = static_cast<float>(mSwapchainExtent.width);
+    viewport.height   = static_cast<float>(mSwapchainExtent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    commandBuffer.setViewport(0, {viewport});
+
+    vk::Rect2D scissor;
+    scissor.offset = vk::Offset2D{0, 0};
+    scissor.extent = mSwapchainExtent;
+    commandBuffer.setScissor(0, {scissor});
+
+    // Every stream of the vertex layout comes out of the same buffer.
+    std::vector<vk::Buffer> vertexBuffers;
+    std::vector<vk::DeviceSize> offsets;
+    for (auto offset :
+         globals::VertexLayout::getBindingOffsets(mMesh.vertexCount))
+    {
+        vertexBuffers.push_back(*mVertexBuffer);
+        offsets.push_back(offset);
+    }
+    vertexBuffers.push_back(*mInstanceBuffer);
+    offsets.push_back(0);
+    commandBuffer.bindVertexBuffers(0, vertexBuffers, offsets);
+    commandBuffer.bindIndexBuffer(*mIndexBuffer, 0, vk::IndexType::eUint32);
+
+    // Both pipelines share a layout, so the descriptors stay bound across the
+    // pipeline switch.
+    auto dynamicOffset = static_cast<std::uint32_t>(frame * mUniformSliceSize);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                     *mPipelineLayout,
+                                     0,
+                                     {*mDescriptorSet},
+                                     {dynamicOffset});
+
+    // There is a single object (drawn once per instance), so one push covers
+    // all the draws below. Each stage only sees its own range.
+    DrawPushConstants constants;
+    constants.model        = mModelMatrix;
+    constants.textureIndex = mMeshTextureIndex;
+    commandBuffer.pushConstants(*mPipelineLayout,
+                                vk::ShaderStageFlagBits::eVertex,
+                                offsetof(DrawPushConstants, model),
+                                sizeof(glm::mat4),
+                                &constants.model);
+    commandBuffer.pushConstants(*mPipelineLayout,
+                                vk::ShaderStageFlagBits::eFragment,
+                                offsetof(DrawPushConstants, textureIndex),
+                                sizeof(std::uint32_t),
+                                &constants.textureIndex);
+
+    // The profiler can only be used from one thread, so the passes are only
+    // timed separately when recording inline into the primary.
+    auto slot      = static_cast<std::uint32_t>(frame);
+    bool isPrimary = commandBuffer == *mFrameCommands[frame].commandBuffer;
+
+    // When recording across threads each secondary lays down depth for its
+    // own range only. That is still correct, later ranges just save less.
+    if (mDepthPrepass)
+    {
+        auto scope = isPrimary ? mGpuProfiler.beginScope(
+                                     commandBuffer, slot, "depth prepass")
+                               : GpuProfiler::noScope;
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                                   *mDepthPipeline);
+        recordDraws(commandBuffer, frame, firstDraw, drawCount);
+        mGpuProfiler.endScope(commandBuffer, slot, scope);
+    }
 
-    auto result =
-        mDevice->acquireNextImageKHR(*mSwapchain,
-                                     std::numeric_limits<std::uint32_t>::max(),
-                                     *mImageAvailableSemaphores[mCurrentFrame],
-                                     {});
+    auto scope = isPrimary
+                     ? mGpuProfiler.beginScope(commandBuffer, slot, "main pass")
+                     : GpuProfiler::noScope;
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                               *mPipelineVariants.at(mMeshFeatures));
+    recordDraws(commandBuffer, frame, firstDraw, drawCount);
+    mGpuProfiler.endScope(commandBuffer, slot, scope);
+}
 
-    if (result.result == vk::Result::eErrorOutOfDateKHR ||
-        result.result == vk::Result::eSuboptimalKHR || mFramebufferResized)
+void Application::recordDraws(vk::CommandBuffer const& commandBuffer,
+                              std::size_t frame,
+                              std::size_t firstDraw,
+                              std::size_t drawCount)
+{
+    if (mGpuCulling)
     {
-        if (mFramebufferResized && result.result == vk::Result::eSuccess)
+        // A single indirect draw covers the whole scene, so it is issued by
+        // whoever was handed the start of the draw list.
+        if (firstDraw != 0 || drawCount == 0)
         {
-            mImageAvailableSemaphores[mCurrentFrame].reset();
+            return;
+        }
 
-            vk::SemaphoreCreateInfo semaphoreInfo{};
-            mImageAvailableSemaphores[mCurrentFrame] =
-                mDevice->createSemaphoreUnique(semaphoreInfo);
+        auto stride      = static_cast<std::uint32_t>(
+            sizeof(vk::DrawIndexedIndirectCommand));
+        auto drawOffset  = frame * mDrawCommandSliceSize;
+        auto countOffset = frame * mDrawCountSliceSize;
+        if (mHasDrawIndirectCount)
+        {
+            globals::pfnVkCmdDrawIndexedIndirectCountKHR(commandBuffer,
+                                                         *mDrawCommandBuffer,
+                                                         drawOffset,
+                                                         *mDrawCountBuffer,
+                                                         countOffset,
+                                                         mDrawCommandCapacity,
+                                                         stride);
         }
+        else
+        {
+            commandBuffer.drawIndexedIndirect(
+                *mDrawCommandBuffer, drawOffset, mInstanceCount, stride);
+        }
+        return;
+    }
 
-        mFramebufferResized = false;
-        recreateSwapChain();
+    for (std::size_t i{firstDraw}; i < firstDraw + drawCount; ++i)
+    {
+        auto const& draw = mVisibleDraws[i];
+        commandBuffer.drawIndexed(draw.indexCount,
+                                  draw.instanceCount,
+                                  draw.firstIndex,
+                                  0,
+                                  draw.firstInstance);
+    }
+}
+
+void Application::recordCulling(vk::CommandBuffer const& commandBuffer,
+                                std::size_t frame)
+{
+    auto uniformOffset = static_cast<std::uint32_t>(frame * mUniformSliceSize);
+    auto drawOffset =
+        static_cast<std::uint32_t>(frame * mDrawCommandSliceSize);
+    auto countOffset = static_cast<std::uint32_t>(frame * mDrawCountSliceSize);
+
+    // The count was cleared and the draw buffers are synchronised by the
+    // render graph, see createRenderGraph.
+    CullPushConstants constants;
+    constants.model          = mModelMatrix;
+    constants.boundingSphere = mBoundingSphere;
+    constants.instanceCount  = mInstanceCount;
+    constants.lodCount       = static_cast<std::uint32_t>(mMesh.lodCount);
+    constants.compact        = mHasDrawIndirectCount ? 1 : 0;
+    constants.meshletCount    = mMesh.lods[0].meshletCount;
+    constants.commandCapacity = mDrawCommandCapacity;
+    constants.lodScale        = mLodScale;
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *mCullPipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                     *mCullPipelineLayout,
+                                     0,
+                                     {*mCullDescriptorSet},
+                                     {uniformOffset, drawOffset, countOffset});
+    commandBuffer.pushConstants(*mCullPipelineLayout,
+                                vk::ShaderStageFlagBits::eCompute,
+                                0,
+                                sizeof(CullPushConstants),
+                                &constants);
+
+    // Compacted output culls every meshlet of every instance, one invocation
+    // each. Otherwise there is one invocation (and command) per instance.
+    auto groupCount = [](std::uint32_t count) {
+        return (count + globals::cullGroupSize - 1) / globals::cullGroupSize;
+    };
+    if (mHasDrawIndirectCount)
+    {
+        commandBuffer.dispatch(
+            groupCount(constants.meshletCount), mInstanceCount, 1);
+    }
+    else
+    {
+        commandBuffer.dispatch(groupCount(mInstanceCount), 1, 1);
+    }
+}
+
+void Application::updateRecordingStats(double milliseconds)
+{
+    // Once every thread count has been measured, recording stays on all of
+    // them.
+    if (mRecordSweepDone)
+    {
+        return;
+    }
+
+    mRecordTime += milliseconds;
+    if (++mRecordFrames < globals::recordSampleFrames)
+    {
         return;
     }
-    else if (result.result != vk::Result::eSuccess)
+
+    fmt::print("recording: {} thread(s), {} draws, {:.3f} ms/frame\n",
+               mRecordThreads,
+               mVisibleDraws.size(),
+               mRecordTime / mRecordFrames);
+
+    mRecordTime   = 0.0;
+    mRecordFrames = 0;
+    if (mRecordThreads == mJobSystem.getThreadCount())
     {
-        throw std::runtime_error{"error: unable to acquire swap chain image."};
+        mRecordSweepDone = true;
+        return;
     }
 
-    std::uint32_t imageIndex = result.value;
+    ++mRecordThreads;
+}
 
-    updateUniformBuffer(imageIndex);
+void Application::createSyncObjects()
+{
+    // The frame slots are set up with the device, so that uploads can go
+    // through the scheduler from the start. Only the images are left.
+    mFrameScheduler.setImageCount(
+        static_cast<std::uint32_t>(mSwapchainImages.size()), mDeletionQueue);
+}
 
-    std::array<vk::Semaphore, 1> waitSemaphores{
-        *mImageAvailableSemaphores[mCurrentFrame]};
-    std::array<vk::PipelineStageFlags, 1> waitStages{
-        vk::PipelineStageFlagBits::eColorAttachmentOutput};
-    std::array<vk::Semaphore, 1> signalSemaphores{
-        *mRenderFinishedSemaphores[mCurrentFrame]};
+void Application::drawFrame()
+{
+    mCurrentFrame = mFrameScheduler.beginFrame();
+    mDeletionQueue.collect();
 
-    vk::SubmitInfo submitInfo;
-    submitInfo.waitSemaphoreCount =
-        static_cast<std::uint32_t>(waitSemaphores.size());
-    submitInfo.pWaitSemaphores    = waitSemaphores.data();
-    submitInfo.pWaitDstStageMask  = waitStages.data();
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers    = &(*mCommandBuffers[imageIndex]);
-    submitInfo.signalSemaphoreCount =
-        static_cast<std::uint32_t>(signalSemaphores.size());
-    submitInfo.pSignalSemaphores = signalSemaphores.data();
+    // Offscreen there is nothing to acquire, the frame's own target is used.
+    auto imageIndex = static_cast<std::uint32_t>(mCurrentFrame);
+    bool isOutdated{false};
+    if (!mSettings.headless)
+    {
+        vk::ResultValue<std::uint32_t> result{vk::Result::eNotReady, 0};
+        {
+            auto scope = mCpuProfiler.scope(CpuStage::acquireImage);
+            result     = mDevice->acquireNextImageKHR(
+                *mSwapchain,
+                std::numeric_limits<std::uint32_t>::max(),
+                mFrameScheduler.getAcquireSemaphore(),
+                {});
+        }
 
-    mDevice->resetFences({*mInFlightFences[mCurrentFrame]});
+        // Nothing was acquired, so the semaphore is still unsignalled.
+        if (result.result == vk::Result::eErrorOutOfDateKHR)
+        {
+            mFramebufferResized = false;
+            recreateSwapChain();
+            return;
+        }
+        else if (result.result != vk::Result::eSuccess &&
+                 result.result != vk::Result::eSuboptimalKHR)
+        {
+            throw std::runtime_error{
+                "error: unable to acquire swap chain image."};
+        }
 
-    mGraphicsQueue.submit({submitInfo}, *mInFlightFences[mCurrentFrame]);
+        // An image that was acquired is still drawn and presented, which is
+        // what waits on the semaphore, and the swap chain is recreated after.
+        isOutdated = result.result == vk::Result::eSuboptimalKHR ||
+                     mFramebufferResized;
+        imageIndex = result.value;
+
+        // Images aren't handed out in order, so the last frame to render to
+        // this one may be in another slot and still running.
+        mFrameScheduler.useImage(imageIndex);
+    }
+
+    {
+        auto scope = mCpuProfiler.scope(CpuStage::updateUniforms);
+        updateUniformBuffer(mCurrentFrame);
+    }
+
+    if (mTextureStreaming)
+    {
+        updateTextureStreaming();
+    }
+
+    auto recordStart = std::chrono::high_resolution_clock::now();
+    recordCommandBuffer(mCurrentFrame, imageIndex);
+    std::chrono::duration<double, std::milli> recordTime =
+        std::chrono::high_resolution_clock::now() - recordStart;
+    mCpuProfiler.addTime(CpuStage::recordCommands, recordTime.count());
+    updateRecordingStats(recordTime.count());
+
+    {
+        auto scope = mCpuProfiler.scope(CpuStage::submit);
+        auto commandBuffer = *mFrameCommands[mCurrentFrame].commandBuffer;
+        mFrameScheduler.submitFrame(
+            commandBuffer, imageIndex, !mSettings.headless);
+    }
+
+    if (mSettings.headless)
+    {
+        return;
+    }
 
     std::array<vk::SwapchainKHR, 1> swapchains{*mSwapchain};
+    auto presentSemaphore = mFrameScheduler.getPresentSemaphore(imageIndex);
 
     // The last step is to submit the resulting render back into the swap chain
     // so that it can be shown on the screen.
     vk::PresentInfoKHR presentInfo;
-    presentInfo.waitSemaphoreCount =
-        static_cast<std::uint32_t>(signalSemaphores.size());
-    presentInfo.pWaitSemaphores = signalSemaphores.data();
-    presentInfo.swapchainCount  = static_cast<std::uint32_t>(swapchains.size());
-    presentInfo.pSwapchains     = swapchains.data();
-    presentInfo.pImageIndices   = &imageIndex;
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores    = &presentSemaphore;
+    presentInfo.swapchainCount = static_cast<std::uint32_t>(swapchains.size());
+    presentInfo.pSwapchains    = swapchains.data();
+    presentInfo.pImageIndices  = &imageIndex;
+
+    try
+    {
+        auto scope = mCpuProfiler.scope(CpuStage::present);
+        isOutdated |= mPresentQueue.presentKHR(presentInfo) ==
+                      vk::Result::eSuboptimalKHR;
+    }
+    catch (vk::OutOfDateKHRError const&)
+    {
+        isOutdated = true;
+    }
 
-    mPresentQueue.presentKHR(presentInfo);
-    mCurrentFrame = (mCurrentFrame + 1) % globals::maxFramesInFlight;
+    if (isOutdated)
+    {
+        mFramebufferResized = false;
+        recreateSwapChain();
+    }
 }
 
-void Application::recreateSwapChain()
+void Application::limitFrameRate()
 {
-    int width{0}, height{0};
-    while (width == 0 || height == 0)
+    if (mSettings.frameLimit <= 0.0)
     {
-        glfwGetFramebufferSize(mWindow, &width, &height);
-        glfwWaitEvents();
+        return;
+    }
+
+    // Deadlines advance by a fixed period so small oversleeps average out.
+    // If a frame ran long there is no point trying to catch up, so the
+    // schedule restarts from now instead of rushing the following frames.
+    auto now = std::chrono::steady_clock::now();
+    auto period =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>{1.0 / mSettings.frameLimit});
+    mNextFrameTime += period;
+    if (mNextFrameTime < now)
+    {
+        mNextFrameTime = now;
+        return;
+    }
+
+    std::this_thread::sleep_until(mNextFrameTime);
+}
+
+void Application::runBenchmark()
+{
+    // Recording stays on one thread so that runs are comparable, rather than
+    // stepping through thread counts part way.
+    mRecordSweepDone = true;
+
+    for (std::uint32_t i{0}; i < globals::benchmarkWarmupFrames; ++i)
+    {
+        drawFrame();
+    }
+
+    // A single window covering every measured frame. The first endFrame only
+    // starts the clock.
+    mCpuProfiler.init(mSettings.benchmarkFrames,
+                      !mSettings.cpuStatsFile.empty());
+    mCpuProfiler.endFrame();
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::uint32_t i{0}; i < mSettings.benchmarkFrames; ++i)
+    {
+        {
+            auto scope = mCpuProfiler.scope(CpuStage::waitForFence);
+            mFrameScheduler.beginFrame();
+        }
+
+        drawFrame();
+        mCpuProfiler.endFrame();
     }
 
     mDevice->waitIdle();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
 
-    cleanupSwapChain();
+    // Every frame has finished, so the last ones can be read back as well.
+    for (std::uint32_t i{0}; i < mSettings.framesInFlight; ++i)
+    {
+        mGpuProfiler.collect(i);
+    }
 
-    createSwapChain();
-    createImageViews();
-    createRenderPass();
-    createGraphicsPipeline();
-    createColourResources();
-    createDepthResources();
-    createFramebuffers();
-    createUniformBuffers();
-    createDescriptorPool();
-    createDescriptorSets();
-    createCommandBuffers();
+    writeBenchmarkReport(elapsed.count());
 }
 
-void Application::cleanupSwapChain()
+void Application::writeBenchmarkReport(double seconds)
 {
-    mDevice->destroyImageView(*mColourImageView);
-    mColourImageView.release();
-    mDevice->destroyImage(*mColourImage);
-    mColourImage.release();
-    mDevice->freeMemory(*mColourImageMemory);
-    mColourImageMemory.release();
+    auto writeSummary = [](std::string const& name,
+                           CpuProfiler::Summary const& summary) {
+        return fmt::format(
+            "\"{}\":{{\"p50\":{:.4f},\"p95\":{:.4f},\"p99\":{:.4f}}}",
+            name,
+            summary.p50,
+            summary.p95,
+            summary.p99);
+    };
+
+    // All times are in milliseconds.
+    std::string report = fmt::format(
+        "{{\"frames\":{},\"seconds\":{:.4f},\"fps\":{:.2f},"
+        "\"startupSeconds\":{:.4f},\"deviceLocalBytes\":{},"
+        "\"width\":{},\"height\":{},\"samples\":{},"
+        "\"framesInFlight\":{},\"instances\":{},\"gpuCulling\":{},"
+        "\"depthPrepass\":{},\"recordThreads\":{},\"computeMipmaps\":{},"
+        "\"device\":\"{}\",\"deviceGroupSize\":{},",
+        mSettings.benchmarkFrames,
+        seconds,
+        mSettings.benchmarkFrames / seconds,
+        mStartupSeconds,
+        mAllocator.getDeviceLocalUsage(),
+        mSwapchainExtent.width,
+        mSwapchainExtent.height,
+        static_cast<std::uint32_t>(mMSAASamples),
+        mSettings.framesInFlight,
+        mInstanceCount,
+        mGpuCulling,
+        mDepthPrepass,
+        mRecordThreads,
+        mComputeMipmaps,
+        escapeJson(mDeviceName),
+        mDeviceGroupSize);
+
+    report += "\"cpu\":{" +
+              writeSummary("frameTime", mCpuProfiler.getFrameSummary());
+    for (std::size_t i{0}; i < static_cast<std::size_t>(CpuStage::count); ++i)
+    {
+        auto stage = static_cast<CpuStage>(i);
+        report += "," + writeSummary(CpuProfiler::getStageName(stage),
+                                     mCpuProfiler.getStageSummary(stage));
+    }
 
-    mDevice->destroyImageView(*mDepthImageView);
-    mDepthImageView.release();
-    mDevice->destroyImage(*mDepthImage);
-    mDepthImage.release();
-    mDevice->freeMemory(*mDepthImageMemory);
-    mDepthImageMemory.release();
+    report += "},\"gpu\":{";
+    auto averages = mGpuProfiler.getAverages();
+    for (std::size_t i{0}; i < averages.size(); ++i)
+    {
+        report += fmt::format("{}\"{}\":{:.4f}",
+                              i == 0 ? "" : ",",
+                              averages[i].first,
+                              averages[i].second);
+    }
+    report += "}}\n";
 
-    for (std::size_t i{0}; i < mSwapchainFramebuffers.size(); ++i)
+    if (mSettings.reportFile.empty())
     {
-        mDevice->destroyFramebuffer(*mSwapchainFramebuffers[i]);
-        mSwapchainFramebuffers[i].release();
+        fmt::print("{}", report);
+        return;
     }
-    mSwapchainFramebuffers.clear();
 
-    std::vector<vk::CommandBuffer> tempBuffers;
-    for (std::size_t i{0}; i < mCommandBuffers.size(); ++i)
+    std::ofstream file{mSettings.reportFile, std::ios::trunc};
+    file << report;
+    if (!file.good())
     {
-        tempBuffers.push_back(*mCommandBuffers[i]);
-        mCommandBuffers[i].release();
+        throw std::runtime_error{"error: unable to write benchmark report " +
+                                 mSettings.reportFile + "."};
     }
-    mCommandBuffers.clear();
+}
 
-    mDevice->freeCommandBuffers(*mCommandPool, tempBuffers);
+void Application::recreateSwapChain()
+{
+    int width{0}, height{0};
+    while (width == 0 || height == 0)
+    {
+        glfwGetFramebufferSize(mWindow, &width, &height);
+        glfwWaitEvents();
+    }
 
-    mDevice->destroyPipeline(*mGraphicsPipeline);
-    mGraphicsPipeline.release();
-    mDevice->destroyPipelineLayout(*mPipelineLayout);
-    mPipelineLayout.release();
-    mDevice->destroyRenderPass(*mRenderPass);
-    mRenderPass.release();
+    // Nothing waits for the device to go idle. What the frames in flight
+    // still use is retired instead, and the old swap chain is only destroyed
+    // once they are done, so it can be handed over to the new one.
+    auto oldFormat    = mSwapchainImageFormat;
+    auto oldSwapchain = *mSwapchain;
+    cleanupSwapChain();
 
-    for (std::size_t i{0}; i < mSwapchainImageViews.size(); ++i)
+    createSwapChain(oldSwapchain);
+    createImageViews();
+    mFrameScheduler.setImageCount(
+        static_cast<std::uint32_t>(mSwapchainImages.size()), mDeletionQueue);
+
+    // The render passes only care about attachment formats, and the pipeline
+    // takes its viewport and scissor dynamically, so neither needs rebuilding
+    // unless the surface format itself changed. Recompiling the graph is
+    // enough for the new sizes and images.
+    if (mSwapchainImageFormat != oldFormat)
     {
-        mDevice->destroyImageView(*mSwapchainImageViews[i]);
-        mSwapchainImageViews[i].release();
+        createRenderGraph();
+        createGraphicsPipeline();
     }
-    mSwapchainImageViews.clear();
-
-    mDevice->destroySwapchainKHR(*mSwapchain);
-    mSwapchain.release();
+    else
+    {
+        compileRenderGraph();
+    }
+}
 
-    mUniformBuffers.clear();
-    mUniformBuffersMemory.clear();
+void Application::cleanupSwapChain()
+{
+    // Frames in flight may still be rendering to any of these. The graph's
+    // own images and framebuffers are retired when it is compiled again.
+    for (auto& imageView : mSwapchainImageViews)
+    {
+        mDeletionQueue.retire(std::move(imageView));
+    }
+    mSwapchainImageViews.clear();
 
-    mDescriptorSets.clear();
-    mDevice->destroyDescriptorPool(*mDescriptorPool);
-    mDescriptorPool.release();
+    mDeletionQueue.retire(std::move(mSwapchain));
 }
 
 void Application::createVertexBuffer()
 {
-    vk::DeviceSize bufferSize = sizeof(mVertices[0]) * mVertices.size();
-
-    // Create staging buffer.
-    vk::Buffer stagingBuffer;
-    vk::DeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize,
-                 vk::BufferUsageFlagBits::eTransferSrc,
-                 vk::MemoryPropertyFlagBits::eHostVisible |
-                     vk::MemoryPropertyFlagBits::eHostCoherent,
-                 stagingBuffer,
-                 stagingBufferMemory);
+    // The cache holds full precision vertices, so they are packed into the
+    // GPU layout on the way out.
+    auto vertices = globals::VertexLayout::encode(
+        mMesh.vertices, mMesh.vertexCount, mMeshMinimum, mMeshMaximum);
+    vk::DeviceSize bufferSize = vertices.size();
 
-    // Map and copy the data over.
-    void* data;
-    mDevice->mapMemory(stagingBufferMemory, 0, bufferSize, {}, &data);
-    memcpy(data, mVertices.data(), static_cast<std::size_t>(bufferSize));
-    mDevice->unmapMemory(stagingBufferMemory);
+    // The upload context owns the staging buffer and keeps it alive until the
+    // copy has executed.
+    auto stagingBuffer = mUploadContext.stage(vertices.data(), bufferSize);
 
     // Now create the vertex buffer.
     vk::Buffer vertexBuffer;
-    vk::DeviceMemory vertexMemory;
     createBuffer(bufferSize,
                  vk::BufferUsageFlagBits::eTransferDst |
                      vk::BufferUsageFlagBits::eVertexBuffer,
                  vk::MemoryPropertyFlagBits::eDeviceLocal,
                  vertexBuffer,
-                 vertexMemory);
-    mVertexBuffer       = vk::UniqueBuffer(vertexBuffer, *mDevice);
-    mVertexBufferMemory = vk::UniqueDeviceMemory(vertexMemory, *mDevice);
+                 mVertexBufferMemory);
+    mVertexBuffer = vk::UniqueBuffer(vertexBuffer, *mDevice);
 
     copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
-
-    // The staging buffer data is not in unique handles, so we have to release
-    // them manually.
-    mDevice->destroyBuffer(stagingBuffer);
-    mDevice->freeMemory(stagingBufferMemory);
+    mUploadContext.transferBufferOwnership(
+        vertexBuffer,
+        vk::AccessFlagBits::eVertexAttributeRead,
+        vk::PipelineStageFlagBits::eVertexInput);
 }
 
-std::uint32_t
-Application::findMemoryType(std::uint32_t typeFilter,
-                            vk::MemoryPropertyFlags const& properties)
+void Application::createInstanceBuffer()
 {
-    auto memProperties = mPhysicalDevice.getMemoryProperties();
-    for (std::uint32_t i{0}; i < memProperties.memoryTypeCount; ++i)
+    // Every instance that could be drawn is uploaded once, so changing the
+    // instance count is just a matter of changing the draw.
+    mInstanceCount = std::min(mSettings.instanceCount, globals::maxInstances);
+    if (mInstanceCount < mSettings.instanceCount)
     {
-        if (typeFilter & (1 << i) &&
-            (memProperties.memoryTypes[i].propertyFlags & properties) ==
-                properties)
-        {
-            return i;
-        }
+        fmt::print("warning: drawing {} instances, the most there is room "
+                   "for.\n",
+                   mInstanceCount);
+    }
+    std::vector<InstanceData> instances(globals::maxInstances);
+    for (std::uint32_t i{0}; i < globals::maxInstances; ++i)
+    {
+        instances[i].model =
+            glm::translate(glm::mat4{1.0f}, getInstanceOffset(i));
     }
 
-    throw std::runtime_error{"error: failed to find suitable memory type."};
+    vk::DeviceSize bufferSize = sizeof(InstanceData) * instances.size();
+    auto stagingBuffer = mUploadContext.stage(instances.data(), bufferSize);
+
+    // The culling shader reads the transforms as well, so the buffer has to
+    // be visible to it.
+    vk::Buffer instanceBuffer;
+    createBuffer(bufferSize,
+                 vk::BufferUsageFlagBits::eTransferDst |
+                     vk::BufferUsageFlagBits::eVertexBuffer |
+                     vk::BufferUsageFlagBits::eStorageBuffer,
+                 vk::MemoryPropertyFlagBits::eDeviceLocal,
+                 instanceBuffer,
+                 mInstanceBufferMemory);
+    mInstanceBuffer = vk::UniqueBuffer(instanceBuffer, *mDevice);
+
+    copyBuffer(stagingBuffer, instanceBuffer, bufferSize);
+    mUploadContext.transferBufferOwnership(
+        instanceBuffer,
+        vk::AccessFlagBits::eVertexAttributeRead |
+            vk::AccessFlagBits::eShaderRead,
+        vk::PipelineStageFlagBits::eVertexInput |
+            vk::PipelineStageFlagBits::eComputeShader);
 }
 
 void Application::createBuffer(vk::DeviceSize const& size,
                                vk::BufferUsageFlags const& usage,
                                vk::MemoryPropertyFlags const& properties,
                                vk::Buffer& buffer,
-                               vk::DeviceMemory& bufferMemory)
+                               Allocation& bufferMemory)
 {
     vk::BufferCreateInfo bufferInfo;
     bufferInfo.size        = size;
@@ -1213,263 +2578,710 @@ void Application::createBuffer(vk::DeviceSize const& size,
 
     auto memRequirements = mDevice->getBufferMemoryRequirements(buffer);
 
-    vk::MemoryAllocateInfo allocInfo;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex =
-        findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    bufferMemory = mDevice->allocateMemory(allocInfo);
-    mDevice->bindBufferMemory(buffer, bufferMemory, 0);
+    bufferMemory = mAllocator.allocate(memRequirements, properties, true);
+    mDevice->bindBufferMemory(
+        buffer, bufferMemory.memory, bufferMemory.offset);
 }
 
 void Application::copyBuffer(vk::Buffer const& srcBuffer,
                              vk::Buffer const& dstBuffer,
                              vk::DeviceSize const& size)
 {
-    auto commandBuffer = beginSingleTimeCommands();
-
-    vk::BufferCopy copyRegion;
-    copyRegion.srcOffset = 0;
-    copyRegion.dstOffset = 0;
-    copyRegion.size      = size;
-    commandBuffer.copyBuffer(srcBuffer, dstBuffer, 1, &copyRegion);
-
-    endSingleTimeCommands(commandBuffer);
+    core::copyBuffer(
+        mUploadContext.getCommandBuffer(), srcBuffer, dstBuffer, size);
 }
 
 void Application::createIndexBuffer()
 {
-    vk::DeviceSize bufferSize = sizeof(mIndices[0]) * mIndices.size();
+    vk::DeviceSize bufferSize = sizeof(std::uint32_t) * mMesh.indexCount;
 
-    vk::Buffer stagingBuffer;
-    vk::DeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize,
-                 vk::BufferUsageFlagBits::eTransferSrc,
-                 vk::MemoryPropertyFlagBits::eHostVisible |
-                     vk::MemoryPropertyFlagBits::eHostCoherent,
-                 stagingBuffer,
-                 stagingBufferMemory);
-
-    void* data;
-    mDevice->mapMemory(stagingBufferMemory, 0, bufferSize, {}, &data);
-    memcpy(data, mIndices.data(), static_cast<std::size_t>(bufferSize));
-    mDevice->unmapMemory(stagingBufferMemory);
+    auto stagingBuffer = mUploadContext.stage(mMesh.indices, bufferSize);
 
     vk::Buffer indexBuffer;
-    vk::DeviceMemory indexMemory;
     createBuffer(bufferSize,
                  vk::BufferUsageFlagBits::eTransferDst |
                      vk::BufferUsageFlagBits::eIndexBuffer,
                  vk::MemoryPropertyFlagBits::eDeviceLocal,
                  indexBuffer,
-                 indexMemory);
-    mIndexBuffer       = vk::UniqueBuffer(indexBuffer, *mDevice);
-    mIndexBufferMemory = vk::UniqueDeviceMemory(indexMemory, *mDevice);
+                 mIndexBufferMemory);
+    mIndexBuffer = vk::UniqueBuffer(indexBuffer, *mDevice);
 
     copyBuffer(stagingBuffer, indexBuffer, bufferSize);
-
-    mDevice->destroyBuffer(stagingBuffer);
-    mDevice->freeMemory(stagingBufferMemory);
+    mUploadContext.transferBufferOwnership(
+        indexBuffer,
+        vk::AccessFlagBits::eIndexRead,
+        vk::PipelineStageFlagBits::eVertexInput);
 }
 
 void Application::createDescriptorSetLayout()
 {
     vk::DescriptorSetLayoutBinding uboLayoutBinding;
-    uboLayoutBinding.binding         = 0;
-    uboLayoutBinding.descriptorType  = vk::DescriptorType::eUniformBuffer;
+    uboLayoutBinding.binding = 0;
+    uboLayoutBinding.descriptorType =
+        vk::DescriptorType::eUniformBufferDynamic;
     uboLayoutBinding.descriptorCount = 1;
     uboLayoutBinding.stageFlags      = vk::ShaderStageFlagBits::eVertex;
 
+    // One sampler is shared by the whole texture array.
     vk::DescriptorSetLayoutBinding samplerLayoutBinding;
-    samplerLayoutBinding.binding         = 1;
-    samplerLayoutBinding.descriptorCount = 1;
-    samplerLayoutBinding.descriptorType =
-        vk::DescriptorType::eCombinedImageSampler;
+    samplerLayoutBinding.binding            = 1;
+    samplerLayoutBinding.descriptorCount    = 1;
+    samplerLayoutBinding.descriptorType     = vk::DescriptorType::eSampler;
     samplerLayoutBinding.pImmutableSamplers = nullptr;
     samplerLayoutBinding.stageFlags = vk::ShaderStageFlagBits::eFragment;
 
-    std::array<vk::DescriptorSetLayoutBinding, 2> bindings = {
-        uboLayoutBinding, samplerLayoutBinding};
+    vk::DescriptorSetLayoutBinding textureLayoutBinding;
+    textureLayoutBinding.binding         = 2;
+    textureLayoutBinding.descriptorCount = mTextureCapacity;
+    textureLayoutBinding.descriptorType  = vk::DescriptorType::eSampledImage;
+    textureLayoutBinding.stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+    std::array<vk::DescriptorSetLayoutBinding, 3> bindings = {
+        uboLayoutBinding, samplerLayoutBinding, textureLayoutBinding};
     vk::DescriptorSetLayoutCreateInfo createInfo;
     createInfo.bindingCount = static_cast<std::uint32_t>(bindings.size());
     createInfo.pBindings    = bindings.data();
 
+    std::array<vk::DescriptorBindingFlagsEXT, 3> bindingFlags{
+        {{},
+         {},
+         vk::DescriptorBindingFlagBitsEXT::ePartiallyBound |
+             vk::DescriptorBindingFlagBitsEXT::eUpdateAfterBind}};
+    vk::DescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo;
+    bindingFlagsInfo.bindingCount =
+        static_cast<std::uint32_t>(bindingFlags.size());
+    bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+    if (mBindlessTextures)
+    {
+        createInfo.flags =
+            vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPoolEXT;
+        createInfo.pNext = &bindingFlagsInfo;
+    }
+
     mDescriptorSetLayout = mDevice->createDescriptorSetLayoutUnique(createInfo);
+
+    if (!mGpuCulling)
+    {
+        return;
+    }
+
+    // The uniforms, the instances, this frame's slice of the draw commands
+    // and the draw count, the meshlets and the levels of detail.
+    std::array<vk::DescriptorSetLayoutBinding, 6> cullBindings;
+    std::array<vk::DescriptorType, 6> cullTypes{
+        vk::DescriptorType::eUniformBufferDynamic,
+        vk::DescriptorType::eStorageBuffer,
+        vk::DescriptorType::eStorageBufferDynamic,
+        vk::DescriptorType::eStorageBufferDynamic,
+        vk::DescriptorType::eStorageBuffer,
+        vk::DescriptorType::eStorageBuffer};
+    for (std::uint32_t i{0}; i < cullBindings.size(); ++i)
+    {
+        cullBindings[i].binding         = i;
+        cullBindings[i].descriptorType  = cullTypes[i];
+        cullBindings[i].descriptorCount = 1;
+        cullBindings[i].stageFlags      = vk::ShaderStageFlagBits::eCompute;
+    }
+
+    createInfo.flags        = {};
+    createInfo.pNext        = nullptr;
+    createInfo.bindingCount = static_cast<std::uint32_t>(cullBindings.size());
+    createInfo.pBindings    = cullBindings.data();
+
+    mCullSetLayout = mDevice->createDescriptorSetLayoutUnique(createInfo);
 }
 
 void Application::createUniformBuffers()
 {
-    vk::DeviceSize bufferSize = sizeof(UniformMatrices);
+    // All frames in flight share a single buffer. Each frame owns a slice of
+    // it that is selected through a dynamic offset when the descriptor set is
+    // bound, so the slices must respect the minimum offset alignment.
+    auto alignment =
+        mPhysicalDevice.getProperties().limits.minUniformBufferOffsetAlignment;
+    mUniformSliceSize = alignUp(sizeof(UniformMatrices), alignment);
 
-    mUniformBuffers.resize(mSwapchainImages.size());
-    mUniformBuffersMemory.resize(mSwapchainImages.size());
+    vk::DeviceSize bufferSize = mUniformSliceSize * mSettings.framesInFlight;
 
-    for (std::size_t i{0}; i < mSwapchainImages.size(); ++i)
+    vk::Buffer buffer;
+    createBuffer(bufferSize,
+                 vk::BufferUsageFlagBits::eUniformBuffer,
+                 vk::MemoryPropertyFlagBits::eHostVisible |
+                     vk::MemoryPropertyFlagBits::eHostCoherent,
+                 buffer,
+                 mUniformBufferMemory);
+    mUniformBuffer = vk::UniqueBuffer(buffer, *mDevice);
+}
+
+void Application::createIndirectBuffers()
+{
+    if (!mGpuCulling)
     {
-        vk::Buffer buffer;
-        vk::DeviceMemory memory;
-        createBuffer(bufferSize,
-                     vk::BufferUsageFlagBits::eUniformBuffer,
-                     vk::MemoryPropertyFlagBits::eHostVisible |
-                         vk::MemoryPropertyFlagBits::eHostCoherent,
-                     buffer,
-                     memory);
-        mUniformBuffers[i]       = vk::UniqueBuffer(buffer, *mDevice);
-        mUniformBuffersMemory[i] = vk::UniqueDeviceMemory(memory, *mDevice);
+        return;
     }
+
+    // Like the uniforms, every frame in flight gets a slice of each buffer so
+    // that culling for one frame never overwrites commands still being read
+    // by another.
+    auto alignment =
+        mPhysicalDevice.getProperties().limits.minStorageBufferOffsetAlignment;
+    mDrawCommandCapacity  = mHasDrawIndirectCount ? globals::maxDrawCommands
+                                                  : globals::maxInstances;
+    mDrawCommandSliceSize = alignUp(
+        sizeof(vk::DrawIndexedIndirectCommand) * mDrawCommandCapacity,
+        alignment);
+    mDrawCountSliceSize = alignUp(sizeof(std::uint32_t), alignment);
+
+    vk::Buffer commandBuffer;
+    createBuffer(mDrawCommandSliceSize * mSettings.framesInFlight,
+                 vk::BufferUsageFlagBits::eStorageBuffer |
+                     vk::BufferUsageFlagBits::eIndirectBuffer,
+                 vk::MemoryPropertyFlagBits::eDeviceLocal,
+                 commandBuffer,
+                 mDrawCommandBufferMemory);
+    mDrawCommandBuffer = vk::UniqueBuffer(commandBuffer, *mDevice);
+
+    vk::Buffer countBuffer;
+    createBuffer(mDrawCountSliceSize * mSettings.framesInFlight,
+                 vk::BufferUsageFlagBits::eStorageBuffer |
+                     vk::BufferUsageFlagBits::eIndirectBuffer |
+                     vk::BufferUsageFlagBits::eTransferDst,
+                 vk::MemoryPropertyFlagBits::eDeviceLocal,
+                 countBuffer,
+                 mDrawCountBufferMemory);
+    mDrawCountBuffer = vk::UniqueBuffer(countBuffer, *mDevice);
 }
 
-void Application::updateUniformBuffer(std::uint32_t currentImage)
+void Application::updateUniformBuffer(std::size_t currentFrame)
 {
-    UniformMatrices ubo;
-    ubo.model = glm::rotate(
+    // The buffer is persistently mapped and host coherent, so writing the
+    // matrices straight into this frame's slice is all that's needed.
+    // A copy is kept on the CPU for cluster culling, since reading back from
+    // mapped (and likely write-combined) memory is slow.
+    auto ubo = &mUniforms;
+
+    // The model matrix is pushed with the draws rather than written here.
+    mModelMatrix = glm::rotate(
         glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    ubo.view       = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f),
-                           glm::vec3(0.0f, 0.0f, 0.0f),
-                           glm::vec3(0.0f, 0.0f, 1.0f));
-    ubo.projection = glm::perspective(
-        glm::radians(45.0f),
+    ubo->cameraPosition = glm::vec4{2.0f, 2.0f, 2.0f, 1.0f};
+    auto view       = glm::lookAt(glm::vec3(ubo->cameraPosition),
+                            glm::vec3(0.0f, 0.0f, 0.0f),
+                            glm::vec3(0.0f, 0.0f, 1.0f));
+    auto projection = glm::perspective(
+        glm::radians(globals::cameraFieldOfView),
         mSwapchainExtent.width / static_cast<float>(mSwapchainExtent.height),
         0.1f,
         10.0f);
-    ubo.projection[1][1] *= -1;
+    projection[1][1] *= -1;
+    ubo->viewProjection = projection * view;
+
+    // Turns a bounding sphere's radius over its distance into the square
+    // root of the number of triangles it should be drawn with.
+    mLodScale = static_cast<float>(mSwapchainExtent.height) /
+                (std::tan(glm::radians(globals::cameraFieldOfView) * 0.5f) *
+                 std::sqrt(globals::lodPixelsPerTriangle));
+
+    // Gribb-Hartmann plane extraction. With a [0, 1] depth range the near
+    // plane is just the third row.
+    auto planes        = glm::transpose(ubo->viewProjection);
+    ubo->frustumPlanes = {planes[3] + planes[0],
+                          planes[3] - planes[0],
+                          planes[3] + planes[1],
+                          planes[3] - planes[1],
+                          planes[2],
+                          planes[3] - planes[2]};
+    for (auto& plane : ubo->frustumPlanes)
+    {
+        plane /= glm::length(glm::vec3{plane});
+    }
+
+    ubo->positionScale = globals::VertexLayout::getPositionScale(
+        mMeshMinimum, mMeshMaximum);
+    ubo->positionOffset =
+        globals::VertexLayout::getPositionOffset(mMeshMinimum);
 
-    void* data;
-    mDevice->mapMemory(
-        *mUniformBuffersMemory[currentImage], 0, sizeof(ubo), {}, &data);
-    memcpy(data, &ubo, sizeof(ubo));
-    mDevice->unmapMemory(*mUniformBuffersMemory[currentImage]);
+    std::memcpy(static_cast<char*>(mUniformBufferMemory.mapped) +
+                    currentFrame * mUniformSliceSize,
+                ubo,
+                sizeof(UniformMatrices));
 }
 
 void Application::createDescriptorPool()
 {
-    std::array<vk::DescriptorPoolSize, 2> poolSizes;
-    poolSizes[0].type = vk::DescriptorType::eUniformBuffer;
-    poolSizes[0].descriptorCount =
-        static_cast<std::uint32_t>(mSwapchainImages.size());
-    poolSizes[1].type = vk::DescriptorType::eCombinedImageSampler;
-    poolSizes[1].descriptorCount =
-        static_cast<std::uint32_t>(mSwapchainImages.size());
+    // Room for the culling set as well, even if it ends up unused.
+    std::array<vk::DescriptorPoolSize, 5> poolSizes;
+    poolSizes[0].type            = vk::DescriptorType::eUniformBufferDynamic;
+    poolSizes[0].descriptorCount = 2;
+    poolSizes[1].type            = vk::DescriptorType::eSampler;
+    poolSizes[1].descriptorCount = 1;
+    poolSizes[2].type            = vk::DescriptorType::eStorageBuffer;
+    poolSizes[2].descriptorCount = 3;
+    poolSizes[3].type            = vk::DescriptorType::eStorageBufferDynamic;
+    poolSizes[3].descriptorCount = 2;
+    poolSizes[4].type            = vk::DescriptorType::eSampledImage;
+    poolSizes[4].descriptorCount = mTextureCapacity;
 
     vk::DescriptorPoolCreateInfo createInfo;
     createInfo.poolSizeCount = static_cast<std::uint32_t>(poolSizes.size());
     createInfo.pPoolSizes    = poolSizes.data();
-    createInfo.maxSets = static_cast<std::uint32_t>(mSwapchainImages.size());
+    createInfo.maxSets       = 2;
 
     // Because of the way we are freeing the descriptor pool, this flag needs
     // to be added to prevent the validation layers from issuing an error.
     createInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+    if (mBindlessTextures)
+    {
+        createInfo.flags |=
+            vk::DescriptorPoolCreateFlagBits::eUpdateAfterBindEXT;
+    }
 
     mDescriptorPool = mDevice->createDescriptorPoolUnique(createInfo);
 }
 
 void Application::createDescriptorSets()
 {
-    std::vector<vk::DescriptorSetLayout> layouts(mSwapchainImages.size(),
-                                                 *mDescriptorSetLayout);
     vk::DescriptorSetAllocateInfo allocInfo;
     allocInfo.descriptorPool     = *mDescriptorPool;
-    allocInfo.descriptorSetCount = static_cast<std::uint32_t>(layouts.size());
-    allocInfo.pSetLayouts        = layouts.data();
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts        = &(*mDescriptorSetLayout);
+
+    mDescriptorSet =
+        std::move(mDevice->allocateDescriptorSetsUnique(allocInfo).front());
+
+    // The range covers a single slice, the dynamic offset supplied at bind
+    // time selects which one.
+    vk::DescriptorBufferInfo bufferInfo;
+    bufferInfo.buffer = *mUniformBuffer;
+    bufferInfo.offset = 0;
+    bufferInfo.range  = sizeof(UniformMatrices);
+
+    vk::DescriptorImageInfo samplerInfo;
+    samplerInfo.sampler = *mTextureSampler;
+
+    std::array<vk::WriteDescriptorSet, 2> descriptorWrites;
+
+    descriptorWrites[0].dstSet          = *mDescriptorSet;
+    descriptorWrites[0].dstBinding      = 0;
+    descriptorWrites[0].dstArrayElement = 0;
+    descriptorWrites[0].descriptorType =
+        vk::DescriptorType::eUniformBufferDynamic;
+    descriptorWrites[0].descriptorCount = 1;
+    descriptorWrites[0].pBufferInfo     = &bufferInfo;
+
+    descriptorWrites[1].dstSet          = *mDescriptorSet;
+    descriptorWrites[1].dstBinding      = 1;
+    descriptorWrites[1].dstArrayElement = 0;
+    descriptorWrites[1].descriptorType  = vk::DescriptorType::eSampler;
+    descriptorWrites[1].descriptorCount = 1;
+    descriptorWrites[1].pImageInfo      = &samplerInfo;
+
+    mDevice->updateDescriptorSets(descriptorWrites, {});
+
+    // Without partially bound descriptors every slot that a shader could
+    // reach has to be valid, so they all start out as the mesh texture.
+    if (!mBindlessTextures)
+    {
+        std::vector<vk::DescriptorImageInfo> imageInfos(
+            mTextureCapacity,
+            vk::DescriptorImageInfo{{},
+                                    *mTextureImageView,
+                                    vk::ImageLayout::eShaderReadOnlyOptimal});
+
+        vk::WriteDescriptorSet textureWrite;
+        textureWrite.dstSet          = *mDescriptorSet;
+        textureWrite.dstBinding      = 2;
+        textureWrite.dstArrayElement = 0;
+        textureWrite.descriptorType  = vk::DescriptorType::eSampledImage;
+        textureWrite.descriptorCount = mTextureCapacity;
+        textureWrite.pImageInfo      = imageInfos.data();
+        mDevice->updateDescriptorSets({textureWrite}, {});
+    }
 
-    mDescriptorSets = mDevice->allocateDescriptorSetsUnique(allocInfo);
+    // A streamed texture alternates between two slots, so the one being
+    // written is never the one frames in flight are sampling.
+    if (mTextureStreaming)
+    {
+        auto imageView    = mTextureStreamer.getImageView(0);
+        mMeshTextureSlots = {registerTexture(imageView),
+                             registerTexture(imageView)};
+        mMeshTextureIndex = mMeshTextureSlots[0];
+    }
+    else
+    {
+        mMeshTextureIndex = registerTexture(*mTextureImageView);
+    }
 
-    for (std::size_t i{0}; i < mSwapchainImages.size(); ++i)
+    if (!mGpuCulling)
     {
-        vk::DescriptorBufferInfo bufferInfo;
-        bufferInfo.buffer = *mUniformBuffers[i];
-        bufferInfo.offset = 0;
-        bufferInfo.range  = sizeof(UniformMatrices);
+        return;
+    }
+
+    allocInfo.pSetLayouts = &(*mCullSetLayout);
+    mCullDescriptorSet =
+        std::move(mDevice->allocateDescriptorSetsUnique(allocInfo).front());
+
+    std::array<vk::DescriptorBufferInfo, 6> cullBufferInfos;
+    cullBufferInfos[0] = bufferInfo;
+    cullBufferInfos[1] = vk::DescriptorBufferInfo{
+        *mInstanceBuffer, 0, sizeof(InstanceData) * globals::maxInstances};
+    cullBufferInfos[2] = vk::DescriptorBufferInfo{
+        *mDrawCommandBuffer, 0, mDrawCommandSliceSize};
+    cullBufferInfos[3] = vk::DescriptorBufferInfo{
+        *mDrawCountBuffer, 0, sizeof(std::uint32_t)};
+    cullBufferInfos[4] =
+        vk::DescriptorBufferInfo{*mMeshletBuffer, 0, VK_WHOLE_SIZE};
+    cullBufferInfos[5] =
+        vk::DescriptorBufferInfo{*mLodBuffer, 0, VK_WHOLE_SIZE};
+
+    std::array<vk::DescriptorType, 6> cullTypes{
+        vk::DescriptorType::eUniformBufferDynamic,
+        vk::DescriptorType::eStorageBuffer,
+        vk::DescriptorType::eStorageBufferDynamic,
+        vk::DescriptorType::eStorageBufferDynamic,
+        vk::DescriptorType::eStorageBuffer,
+        vk::DescriptorType::eStorageBuffer};
+
+    std::array<vk::WriteDescriptorSet, 6> cullWrites;
+    for (std::uint32_t i{0}; i < cullWrites.size(); ++i)
+    {
+        cullWrites[i].dstSet          = *mCullDescriptorSet;
+        cullWrites[i].dstBinding      = i;
+        cullWrites[i].dstArrayElement = 0;
+        cullWrites[i].descriptorType  = cullTypes[i];
+        cullWrites[i].descriptorCount = 1;
+        cullWrites[i].pBufferInfo     = &cullBufferInfos[i];
+    }
+
+    mDevice->updateDescriptorSets(cullWrites, {});
+}
 
-        vk::DescriptorImageInfo imageInfo;
-        imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-        imageInfo.imageView   = *mTextureImageView;
-        imageInfo.sampler     = *mTextureSampler;
+std::uint32_t Application::registerTexture(vk::ImageView const& imageView)
+{
+    if (mTextureCount == mTextureCapacity)
+    {
+        throw std::runtime_error{"error: the texture array is full."};
+    }
 
-        std::array<vk::WriteDescriptorSet, 2> descriptorWrites;
+    writeTexture(mTextureCount, imageView);
+    return mTextureCount++;
+}
 
-        descriptorWrites[0].dstSet          = *mDescriptorSets[i];
-        descriptorWrites[0].dstBinding      = 0;
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType = vk::DescriptorType::eUniformBuffer;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pBufferInfo     = &bufferInfo;
+void Application::writeTexture(std::uint32_t slot,
+                               vk::ImageView const& imageView)
+{
+    vk::DescriptorImageInfo imageInfo;
+    imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    imageInfo.imageView   = imageView;
+
+    vk::WriteDescriptorSet textureWrite;
+    textureWrite.dstSet          = *mDescriptorSet;
+    textureWrite.dstBinding      = 2;
+    textureWrite.dstArrayElement = slot;
+    textureWrite.descriptorType  = vk::DescriptorType::eSampledImage;
+    textureWrite.descriptorCount = 1;
+    textureWrite.pImageInfo      = &imageInfo;
+    mDevice->updateDescriptorSets({textureWrite}, {});
+}
 
-        descriptorWrites[1].dstSet          = *mDescriptorSets[i];
-        descriptorWrites[1].dstBinding      = 1;
-        descriptorWrites[1].dstArrayElement = 0;
-        descriptorWrites[1].descriptorType =
-            vk::DescriptorType::eCombinedImageSampler;
-        descriptorWrites[1].descriptorCount = 1;
-        descriptorWrites[1].pImageInfo      = &imageInfo;
+void Application::updateTextureStreaming()
+{
+    // The texture is mapped once over the model, so the finest level worth
+    // having is the one with about as many texels across as the nearest
+    // copy of the model covers pixels on screen.
+    glm::vec3 cameraPosition{mUniforms.cameraPosition};
+    glm::vec3 centre{mModelMatrix *
+                     glm::vec4{glm::vec3{mBoundingSphere}, 1.0f}};
+    auto radius = mBoundingSphere.w;
+
+    auto distance = std::numeric_limits<float>::max();
+    for (std::uint32_t i{0}; i < mInstanceCount; ++i)
+    {
+        distance = std::min(
+            distance,
+            glm::length(centre + getInstanceOffset(i) - cameraPosition));
+    }
 
-        mDevice->updateDescriptorSets(descriptorWrites, {});
+    // The diameter of the sphere over the height of the view at its nearest
+    // point, in pixels.
+    auto const& container = mTextureData.container;
+    auto textureSize      = static_cast<float>(
+        std::max(container.getWidth(), container.getHeight()));
+    auto tanHalfFov = std::tan(glm::radians(globals::cameraFieldOfView) * 0.5f);
+    auto nearest    = std::max(distance - radius, 0.01f);
+    auto pixels     = radius / (nearest * tanHalfFov) *
+                  static_cast<float>(mSwapchainExtent.height);
+
+    auto level = std::floor(std::log2(textureSize / std::max(pixels, 1.0f)));
+    mTextureStreamer.setDesiredLevel(
+        0, static_cast<std::uint32_t>(std::max(level, 0.0f)));
+
+    if (!mTextureStreamer.update())
+    {
+        return;
     }
+
+    auto slot = (mMeshTextureIndex == mMeshTextureSlots[0])
+                    ? mMeshTextureSlots[1]
+                    : mMeshTextureSlots[0];
+    writeTexture(slot, mTextureStreamer.getImageView(0));
+    mMeshTextureIndex = slot;
 }
 
-void Application::createTextureImage()
+void Application::loadTexture()
+{
+    std::string root{ImagePath};
+    std::string filename{root + "chalet.jpg"};
+    std::string cacheName{filename + ".ktx2"};
+
+    // Benchmarking either GPU path means always taking it, so neither the
+    // containers nor the cache are used.
+    if (mSettings.mipmapMode != MipmapMode::eAuto)
+    {
+        decodeTexture(filename);
+        return;
+    }
+
+    // Block compressed versions have to be authored offline, so just take the
+    // first one that exists and that the device can sample from. Failing that,
+    // use the RGBA8 container built from the JPEG on a previous run.
+    for (auto const& [name, format] : globals::textureCandidates)
+    {
+        auto properties = mPhysicalDevice.getFormatProperties(format);
+        if ((properties.optimalTilingFeatures & globals::textureFeatures) !=
+            globals::textureFeatures)
+        {
+            continue;
+        }
+
+        if (mTextureData.container.open(root + name))
+        {
+            mTextureData.hasContainer = true;
+            return;
+        }
+    }
+
+    namespace fs = std::filesystem;
+    std::error_code error;
+    auto cacheTime  = fs::last_write_time(cacheName, error);
+    auto sourceTime = fs::last_write_time(filename, error);
+    if (!error && cacheTime >= sourceTime &&
+        mTextureData.container.open(cacheName))
+    {
+        mTextureData.hasContainer = true;
+        return;
+    }
+
+    decodeTexture(filename);
+
+    // Bake the mip chain into a container so the next run can skip both the
+    // decode and the blits.
+    auto width  = mTextureData.width;
+    auto height = mTextureData.height;
+    if (!writeTextureContainer(
+            cacheName,
+            width,
+            height,
+            generateMipChain(mTextureData.pixels.data(), width, height)))
+    {
+        fmt::print("warning: unable to write texture cache {}.\n", cacheName);
+        return;
+    }
+
+    // Streaming needs every level up front, which the cache now has.
+    if (mTextureData.container.open(cacheName))
+    {
+        mTextureData.hasContainer = true;
+        mTextureData.pixels       = {};
+    }
+}
+
+void Application::decodeTexture(std::string const& filename)
 {
     int texWidth, texHeight, texChannels;
-    std::string root{ImagePath};
-    std::string filename{root + "chalet.jpg"};
     stbi_set_flip_vertically_on_load(1);
     stbi_uc* pixels = stbi_load(
         filename.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    mMipLevels = static_cast<std::uint32_t>(
-        std::floor(std::log2(std::max(texWidth, texHeight))));
-
-    vk::DeviceSize imageSize = texWidth * texHeight * 4;
 
     if (!pixels)
     {
         throw std::runtime_error{"error: failed to load texture image."};
     }
 
-    vk::Buffer stagingBuffer;
-    vk::DeviceMemory stagingMemory;
+    auto width  = static_cast<std::uint32_t>(texWidth);
+    auto height = static_cast<std::uint32_t>(texHeight);
+    mTextureData.pixels.assign(pixels, pixels + width * height * 4);
+    mTextureData.width  = width;
+    mTextureData.height = height;
+    stbi_image_free(pixels);
+}
 
-    createBuffer(imageSize,
-                 vk::BufferUsageFlagBits::eTransferSrc,
-                 vk::MemoryPropertyFlagBits::eHostVisible |
-                     vk::MemoryPropertyFlagBits::eHostCoherent,
-                 stagingBuffer,
-                 stagingMemory);
+void Application::createTextureImage()
+{
+    mTextureStreaming = globals::enableTextureStreaming &&
+                        mBindlessTextures && mTextureData.hasContainer;
+    if (mTextureStreaming)
+    {
+        auto const& container = mTextureData.container;
+        mMipLevels =
+            static_cast<std::uint32_t>(container.getLevels().size());
+        mTextureFormat = container.getFormat();
+
+        mTextureStreamer.init(mPhysicalDevice,
+                              *mDevice,
+                              mAllocator,
+                              mUploadContext,
+                              mFrameScheduler,
+                              mDeletionQueue,
+                              mHasMemoryBudget,
+                              globals::textureUploadBudget);
+        mTextureStreamer.addTexture(container, globals::textureTailSize);
+
+        fmt::print("texture: {}x{}, {} levels, streaming from level {}\n",
+                   container.getWidth(),
+                   container.getHeight(),
+                   mMipLevels,
+                   mTextureStreamer.getResidentLevel(0));
+        return;
+    }
 
-    void* data;
-    mDevice->mapMemory(stagingMemory, 0, imageSize, {}, &data);
-    memcpy(data, pixels, static_cast<std::size_t>(imageSize));
-    mDevice->unmapMemory(stagingMemory);
-    stbi_image_free(pixels);
+    if (mTextureData.hasContainer)
+    {
+        createTextureImageFromContainer();
+        return;
+    }
+
+    auto texWidth  = mTextureData.width;
+    auto texHeight = mTextureData.height;
+    auto largest   = std::max(texWidth, texHeight);
+    mMipLevels = static_cast<std::uint32_t>(std::floor(std::log2(largest))) + 1;
+    mTextureFormat = vk::Format::eR8G8B8A8Unorm;
+
+    mComputeMipmaps =
+        mMipmapPipeline && mTextureFormat == globals::mipmapFormat;
+    if (mSettings.mipmapMode == MipmapMode::eCompute && !mComputeMipmaps)
+    {
+        fmt::print("warning: compute mipmaps are not supported, falling back "
+                   "to blits.\n");
+    }
+
+    auto stagingBuffer = mUploadContext.stage(mTextureData.pixels.data(),
+                                              mTextureData.pixels.size());
+    mTextureData.pixels = {};
+
+    vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eTransferDst |
+                                vk::ImageUsageFlagBits::eSampled;
+    usage |= (mComputeMipmaps) ? vk::ImageUsageFlagBits::eStorage
+                               : vk::ImageUsageFlagBits::eTransferSrc;
 
     vk::Image image;
-    vk::DeviceMemory imageMemory;
     createImage(texWidth,
                 texHeight,
                 mMipLevels,
                 vk::SampleCountFlagBits::e1,
-                vk::Format::eR8G8B8A8Unorm,
+                mTextureFormat,
                 vk::ImageTiling::eOptimal,
-                vk::ImageUsageFlagBits::eTransferSrc |
-                    vk::ImageUsageFlagBits::eTransferDst |
-                    vk::ImageUsageFlagBits::eSampled,
+                usage,
                 vk::MemoryPropertyFlagBits::eDeviceLocal,
                 image,
-                imageMemory);
+                mTextureImageMemory);
 
-    mTextureImage       = vk::UniqueImage(image, *mDevice);
-    mTextureImageMemory = vk::UniqueDeviceMemory(imageMemory, *mDevice);
+    mTextureImage = vk::UniqueImage(image, *mDevice);
 
     transitionImageLayout(image,
-                          vk::Format::eR8G8B8A8Unorm,
+                          mTextureFormat,
                           vk::ImageLayout::eUndefined,
                           vk::ImageLayout::eTransferDstOptimal,
                           mMipLevels);
+
+    auto slot  = mGpuProfiler.getUploadSlot();
+    auto scope = beginTransferScope("copyBufferToImage");
     copyBufferToImage(stagingBuffer, image, texWidth, texHeight);
-    generateMipmaps(
-        image, vk::Format::eR8G8B8A8Unorm, texWidth, texHeight, mMipLevels);
+    mGpuProfiler.endScope(mUploadContext.getCommandBuffer(), slot, scope);
+
+    // The copy happens on the transfer queue, but the blits or dispatches for
+    // the mip chain need a graphics queue, so hand the image over before
+    // generating them.
+    mUploadContext.transferImageOwnership(
+        image,
+        vk::ImageLayout::eTransferDstOptimal,
+        mMipLevels,
+        vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite,
+        vk::PipelineStageFlagBits::eTransfer);
+    generateMipmaps(image,
+                    mTextureFormat,
+                    static_cast<std::int32_t>(texWidth),
+                    static_cast<std::int32_t>(texHeight),
+                    mMipLevels);
+}
+
+void Application::createTextureImageFromContainer()
+{
+    auto const& container = mTextureData.container;
+    auto const& levels    = container.getLevels();
+    mMipLevels            = static_cast<std::uint32_t>(levels.size());
+    mTextureFormat        = container.getFormat();
+
+    // The level offsets index into the file, so staging the whole file lets
+    // every level be copied out of the one buffer.
+    auto stagingBuffer =
+        mUploadContext.stage(container.getData(), container.getSize());
+
+    vk::Image image;
+    createImage(container.getWidth(),
+                container.getHeight(),
+                mMipLevels,
+                vk::SampleCountFlagBits::e1,
+                mTextureFormat,
+                vk::ImageTiling::eOptimal,
+                vk::ImageUsageFlagBits::eTransferDst |
+                    vk::ImageUsageFlagBits::eSampled,
+                vk::MemoryPropertyFlagBits::eDeviceLocal,
+                image,
+                mTextureImageMemory);
+
+    mTextureImage = vk::UniqueImage(image, *mDevice);
+
+    transitionImageLayout(image,
+                          mTextureFormat,
+                          vk::ImageLayout::eUndefined,
+                          vk::ImageLayout::eTransferDstOptimal,
+                          mMipLevels);
+
+    std::vector<vk::BufferImageCopy> regions(levels.size());
+    for (std::uint32_t i{0}; i < mMipLevels; ++i)
+    {
+        auto& subresource          = regions[i].imageSubresource;
+        subresource.aspectMask     = vk::ImageAspectFlagBits::eColor;
+        subresource.mipLevel       = i;
+        subresource.baseArrayLayer = 0;
+        subresource.layerCount     = 1;
+
+        regions[i].bufferOffset = levels[i].offset;
+        regions[i].imageExtent  = {levels[i].width, levels[i].height, 1};
+    }
+
+    auto slot  = mGpuProfiler.getUploadSlot();
+    auto scope = beginTransferScope("copyBufferToImage");
+    mUploadContext.getCommandBuffer().copyBufferToImage(
+        stagingBuffer, image, vk::ImageLayout::eTransferDstOptimal, regions);
+    mGpuProfiler.endScope(mUploadContext.getCommandBuffer(), slot, scope);
+
+    mUploadContext.transferImageOwnership(
+        image,
+        vk::ImageLayout::eTransferDstOptimal,
+        mMipLevels,
+        vk::AccessFlagBits::eTransferWrite,
+        vk::PipelineStageFlagBits::eTransfer);
+    transitionImageLayout(image,
+                          mTextureFormat,
+                          vk::ImageLayout::eTransferDstOptimal,
+                          vk::ImageLayout::eShaderReadOnlyOptimal,
+                          mMipLevels);
 
-    mDevice->destroyBuffer(stagingBuffer);
-    mDevice->freeMemory(stagingMemory);
+    fmt::print("texture: {}x{}, {} levels, {} bytes\n",
+               container.getWidth(),
+               container.getHeight(),
+               mMipLevels,
+               container.getSize());
 }
 
 void Application::createImage(std::uint32_t width,
@@ -1481,125 +3293,67 @@ void Application::createImage(std::uint32_t width,
                               vk::ImageUsageFlags const& usage,
                               vk::MemoryPropertyFlags const& properties,
                               vk::Image& image,
-                              vk::DeviceMemory& imageMemory)
-{
-    vk::ImageCreateInfo imageInfo;
-    imageInfo.imageType     = vk::ImageType::e2D;
-    imageInfo.extent        = {width, height, 1};
-    imageInfo.mipLevels     = mipLevel;
-    imageInfo.arrayLayers   = 1;
-    imageInfo.format        = format;
-    imageInfo.tiling        = tiling;
-    imageInfo.initialLayout = vk::ImageLayout::eUndefined;
-    imageInfo.usage         = usage;
-    imageInfo.sharingMode   = vk::SharingMode::eExclusive;
-    imageInfo.samples       = numSamples;
-
+                              Allocation& imageMemory)
+{
+    auto imageInfo = core::getImageCreateInfo(
+        width, height, mipLevel, numSamples, format, tiling, usage);
     image = mDevice->createImage(imageInfo);
 
     auto memRequirements = mDevice->getImageMemoryRequirements(image);
 
-    vk::MemoryAllocateInfo allocInfo;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex =
-        findMemoryType(memRequirements.memoryTypeBits, properties);
-    imageMemory = mDevice->allocateMemory(allocInfo);
-    mDevice->bindImageMemory(image, imageMemory, 0);
-}
-
-vk::CommandBuffer Application::beginSingleTimeCommands()
-{
-    vk::CommandBufferAllocateInfo allocInfo;
-    allocInfo.level              = vk::CommandBufferLevel::ePrimary;
-    allocInfo.commandPool        = *mBufferPool;
-    allocInfo.commandBufferCount = 1;
-
-    vk::CommandBuffer commandBuffer =
-        mDevice->allocateCommandBuffers(allocInfo).front();
-
-    vk::CommandBufferBeginInfo beginInfo;
-    beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
-
-    commandBuffer.begin(beginInfo);
-    return commandBuffer;
-}
-
-void Application::endSingleTimeCommands(vk::CommandBuffer const& commandBuffer)
-{
-    commandBuffer.end();
-
-    vk::SubmitInfo submitInfo;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers    = &commandBuffer;
-
-    mGraphicsQueue.submit({submitInfo}, {});
-    mGraphicsQueue.waitIdle();
+    // Transient attachments never leave tile memory on tiled GPUs, so back
+    // them with lazily allocated memory wherever the device has some.
+    auto memoryProperties = properties;
+    if (usage & vk::ImageUsageFlagBits::eTransientAttachment)
+    {
+        auto lazy = properties | vk::MemoryPropertyFlagBits::eLazilyAllocated;
+        if (mAllocator.hasMemoryType(memRequirements.memoryTypeBits, lazy))
+        {
+            memoryProperties = lazy;
+        }
+    }
 
-    mDevice->freeCommandBuffers(*mBufferPool, commandBuffer);
+    imageMemory = mAllocator.allocate(
+        memRequirements, memoryProperties, tiling == vk::ImageTiling::eLinear);
+    mDevice->bindImageMemory(image, imageMemory.memory, imageMemory.offset);
 }
 
 void Application::transitionImageLayout(
     vk::Image const& image,
-    [[maybe_unused]] vk::Format const& format,
+    vk::Format const& format,
     vk::ImageLayout const& oldLayout,
     vk::ImageLayout const& newLayout,
     std::uint32_t mipLevels)
 {
-    vk::PipelineStageFlags sourceStage;
-    vk::PipelineStageFlags destinationStage;
-
-    auto commandBuffer = beginSingleTimeCommands();
-
-    vk::ImageMemoryBarrier barrier;
-    barrier.oldLayout                       = oldLayout;
-    barrier.newLayout                       = newLayout;
-    barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image                           = image;
-    barrier.subresourceRange.aspectMask     = vk::ImageAspectFlagBits::eColor;
-    barrier.subresourceRange.baseMipLevel   = 0;
-    barrier.subresourceRange.levelCount     = mipLevels;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount     = 1;
-
-    if (oldLayout == vk::ImageLayout::eUndefined &&
-        newLayout == vk::ImageLayout::eTransferDstOptimal)
-    {
-        barrier.srcAccessMask = {};
-        barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
-
-        sourceStage      = vk::PipelineStageFlagBits::eTopOfPipe;
-        destinationStage = vk::PipelineStageFlagBits::eTransfer;
-    }
-    else if (oldLayout == vk::ImageLayout::eTransferDstOptimal &&
-             newLayout == vk::ImageLayout::eShaderReadOnlyOptimal)
-    {
-        barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-
-        sourceStage      = vk::PipelineStageFlagBits::eTransfer;
-        destinationStage = vk::PipelineStageFlagBits::eFragmentShader;
-    }
-    else if (oldLayout == vk::ImageLayout::eUndefined &&
-             newLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal)
-    {
-        barrier.srcAccessMask = {};
-        barrier.dstAccessMask =
-            vk::AccessFlagBits::eDepthStencilAttachmentRead |
-            vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+    auto transition = core::getLayoutTransition(
+        image, format, oldLayout, newLayout, mipLevels);
+
+    // Transfer queues only understand the transfer stages, so anything that
+    // targets the rest of the pipeline has to be recorded on the graphics side.
+    auto commandBuffer =
+        (transition.destinationStage == vk::PipelineStageFlagBits::eTransfer)
+            ? mUploadContext.getCommandBuffer()
+            : mUploadContext.getGraphicsCommandBuffer();
+    commandBuffer.pipelineBarrier(transition.sourceStage,
+                                  transition.destinationStage,
+                                  {},
+                                  {},
+                                  {},
+                                  {transition.barrier});
+}
 
-        sourceStage      = vk::PipelineStageFlagBits::eTopOfPipe;
-        destinationStage = vk::PipelineStageFlagBits::eEarlyFragmentTests;
-    }
-    else
+std::uint32_t Application::beginTransferScope(char const* name)
+{
+    // Timestamps on a dedicated transfer queue would be written to queries
+    // that the graphics queue only resets afterwards, so only copies that
+    // share the graphics queue are timed.
+    if (mUploadContext.hasTransferQueue())
     {
-        throw std::runtime_error{"error: unsupported layout transition."};
+        return GpuProfiler::noScope;
     }
 
-    commandBuffer.pipelineBarrier(
-        sourceStage, destinationStage, {}, {}, {}, {barrier});
-
-    endSingleTimeCommands(commandBuffer);
+    return mGpuProfiler.beginScope(
+        mUploadContext.getCommandBuffer(), mGpuProfiler.getUploadSlot(), name);
 }
 
 void Application::copyBufferToImage(vk::Buffer const& buffer,
@@ -1607,33 +3361,22 @@ void Application::copyBufferToImage(vk::Buffer const& buffer,
                                     std::uint32_t width,
                                     std::uint32_t height)
 {
-    auto commandBuffer = beginSingleTimeCommands();
-
-    vk::BufferImageCopy region;
-    region.bufferOffset      = 0;
-    region.bufferRowLength   = 0;
-    region.bufferImageHeight = 0;
-
-    region.imageSubresource.aspectMask     = vk::ImageAspectFlagBits::eColor;
-    region.imageSubresource.mipLevel       = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount     = 1;
-
-    region.imageOffset = {0, 0, 0};
-    region.imageExtent = {width, height, 1};
-
-    commandBuffer.copyBufferToImage(
-        buffer, image, vk::ImageLayout::eTransferDstOptimal, {region});
-
-    endSingleTimeCommands(commandBuffer);
+    core::copyBufferToImage(
+        mUploadContext.getCommandBuffer(), buffer, image, width, height);
 }
 
 void Application::createTextureImageView()
 {
+    // The streamer makes a view for every image it builds.
+    if (mTextureStreaming)
+    {
+        return;
+    }
+
     auto view         = createImageView(*mTextureImage,
-                                vk::Format::eR8G8B8A8Unorm,
+                                mTextureFormat,
                                 vk::ImageAspectFlagBits::eColor,
-                                1);
+                                mMipLevels);
     mTextureImageView = vk::UniqueImageView(view, *mDevice);
 }
 
@@ -1643,17 +3386,8 @@ Application::createImageView(vk::Image const& image,
                              vk::ImageAspectFlags const& aspectFlags,
                              std::uint32_t mipLevels)
 {
-    vk::ImageViewCreateInfo viewInfo;
-    viewInfo.image                           = image;
-    viewInfo.viewType                        = vk::ImageViewType::e2D;
-    viewInfo.format                          = format;
-    viewInfo.subresourceRange.aspectMask     = aspectFlags;
-    viewInfo.subresourceRange.baseMipLevel   = 0;
-    viewInfo.subresourceRange.levelCount     = mipLevels;
-    viewInfo.subresourceRange.baseArrayLayer = 0;
-    viewInfo.subresourceRange.layerCount     = 1;
-
-    return mDevice->createImageView(viewInfo);
+    return core::createImageView(
+        *mDevice, image, format, aspectFlags, mipLevels);
 }
 
 void Application::createTextureSampler()
@@ -1678,73 +3412,54 @@ void Application::createTextureSampler()
     mTextureSampler = mDevice->createSamplerUnique(samplerInfo);
 }
 
-void Application::createDepthResources()
-{
-    auto depthFormat = findDepthFormat();
-
-    vk::Image image;
-    vk::DeviceMemory imageMemory;
-    createImage(mSwapchainExtent.width,
-                mSwapchainExtent.height,
-                1,
-                mMSAASamples,
-                depthFormat,
-                vk::ImageTiling::eOptimal,
-                vk::ImageUsageFlagBits::eDepthStencilAttachment,
-                vk::MemoryPropertyFlagBits::eDeviceLocal,
-                image,
-                imageMemory);
-    auto imageView =
-        createImageView(image, depthFormat, vk::ImageAspectFlagBits::eDepth, 1);
-
-    mDepthImage       = vk::UniqueImage(image, *mDevice);
-    mDepthImageMemory = vk::UniqueDeviceMemory(imageMemory, *mDevice);
-    mDepthImageView   = vk::UniqueImageView(imageView, *mDevice);
-}
-
 vk::Format
 Application::findSupportedFormat(std::vector<vk::Format> const& candidates,
                                  vk::ImageTiling const& tiling,
                                  vk::FormatFeatureFlags const& features)
 {
-    for (auto format : candidates)
-    {
-        auto props = mPhysicalDevice.getFormatProperties(format);
-        if (tiling == vk::ImageTiling::eLinear &&
-            (props.linearTilingFeatures & features) == features)
-        {
-            return format;
-        }
-        else if (tiling == vk::ImageTiling::eOptimal &&
-                 (props.optimalTilingFeatures & features) == features)
-        {
-            return format;
-        }
-    }
-
-    throw std::runtime_error{"error: failed to find supported format."};
+    return core::findSupportedFormat(
+        mPhysicalDevice, candidates, tiling, features);
 }
 
 vk::Format Application::findDepthFormat()
 {
-    return findSupportedFormat(
-        {vk::Format::eD32Sfloat,
-         vk::Format::eD32SfloatS8Uint,
-         vk::Format::eD24UnormS8Uint},
-        vk::ImageTiling::eOptimal,
-        vk::FormatFeatureFlagBits::eDepthStencilAttachment);
+    return core::findDepthFormat(mPhysicalDevice);
 }
 
 bool Application::hasStencilComponent(vk::Format const& format)
 {
-    return format == vk::Format::eD32SfloatS8Uint ||
-           format == vk::Format::eD24UnormS8Uint;
+    return core::hasStencilComponent(format);
 }
 
 void Application::loadModel()
 {
     std::string dataRoot{DataPath};
-    std::string filename = dataRoot + "chalet.obj";
+    std::string filename  = dataRoot + "chalet.obj";
+    std::string cacheName = filename + ".meshcache";
+
+    // The cache is laid out exactly like the GPU buffers, so on a hit the
+    // mapped arrays are handed straight to the upload without touching them.
+    auto cacheKey = getMeshCacheKey(filename);
+    if (mMeshCache.open(cacheName, cacheKey, sizeof(Vertex)))
+    {
+        mMesh.vertices =
+            static_cast<Vertex const*>(mMeshCache.getVertices());
+        mMesh.vertexCount = mMeshCache.getVertexCount();
+        mMesh.indices     = mMeshCache.getIndices();
+        mMesh.indexCount   = mMeshCache.getIndexCount();
+        mMesh.meshlets     = mMeshCache.getMeshlets();
+        mMesh.meshletCount = mMeshCache.getMeshletCount();
+        mMesh.lods         = mMeshCache.getLods();
+        mMesh.lodCount     = mMeshCache.getLodCount();
+
+        fmt::print("{}: {} vertices, {} indices, {} meshlets, {} LODs\n",
+                   cacheName,
+                   mMesh.vertexCount,
+                   mMesh.indexCount,
+                   mMesh.meshletCount,
+                   mMesh.lodCount);
+        return;
+    }
 
     auto result = atlas::utils::loadObjMesh(filename);
     if (!result)
@@ -1752,25 +3467,326 @@ void Application::loadModel()
         throw std::runtime_error{"error: could not find mesh."};
     }
 
-    auto mesh = *result;
+    auto const& shape = result->shapes[0];
 
-    mIndices.resize(mesh.shapes[0].indices.size());
-    std::transform(mesh.shapes[0].indices.begin(),
-                   mesh.shapes[0].indices.end(),
-                   mIndices.begin(),
-                   [](std::size_t i) -> std::uint32_t {
-                       return static_cast<std::uint32_t>(i);
-                   });
+    // The OBJ loader emits one vertex per face corner, so most of them are
+    // duplicates. Collapse them so that each unique vertex is uploaded (and
+    // shaded) once.
+    std::unordered_map<Vertex, std::uint32_t> uniqueVertices;
+    uniqueVertices.reserve(shape.vertices.size());
+    mVertices.reserve(shape.vertices.size());
+    mIndices.reserve(shape.indices.size());
 
-    for (auto& vertex : mesh.shapes[0].vertices)
+    for (auto index : shape.indices)
     {
+        auto const& vertex = shape.vertices[index];
+
         Vertex v;
         v.pos      = vertex.position;
         v.texCoord = vertex.texCoord;
         v.colour   = {1.0f, 1.0f, 1.0f};
 
-        mVertices.push_back(v);
+        auto [it, isNew] = uniqueVertices.try_emplace(
+            v, static_cast<std::uint32_t>(mVertices.size()));
+        if (isNew)
+        {
+            mVertices.push_back(v);
+        }
+
+        mIndices.push_back(it->second);
+    }
+    mVertices.shrink_to_fit();
+
+    auto acmrBefore = computeACMR(mIndices, mVertices.size());
+    optimiseVertexCache(mIndices, mVertices.size());
+    optimiseVertexFetch(mVertices, mIndices);
+    auto acmrAfter = computeACMR(mIndices, mVertices.size());
+
+    auto positions =
+        reinterpret_cast<char const*>(mVertices.data()) + offsetof(Vertex, pos);
+    mMeshlets = buildMeshlets(
+        mIndices, positions, sizeof(Vertex), mVertices.size());
+    mMeshLods = {MeshLod{0,
+                         static_cast<std::uint32_t>(mIndices.size()),
+                         0,
+                         static_cast<std::uint32_t>(mMeshlets.size())}};
+
+    // Every coarser level is simplified from the full mesh, and goes after
+    // the levels before it in the index and meshlet arrays.
+    std::vector<std::uint32_t> fullIndices{mIndices};
+    while (mMeshLods.size() < globals::maxMeshLods)
+    {
+        auto target  = mMeshLods.back().indexCount / 6 * 3;
+        auto indices = simplifyMesh(
+            fullIndices, positions, sizeof(Vertex), mVertices.size(), target);
+        if (indices.empty())
+        {
+            break;
+        }
+
+        optimiseVertexCache(indices, mVertices.size());
+        auto meshlets = buildMeshlets(
+            indices, positions, sizeof(Vertex), mVertices.size());
+
+        MeshLod lod;
+        lod.firstIndex   = static_cast<std::uint32_t>(mIndices.size());
+        lod.indexCount   = static_cast<std::uint32_t>(indices.size());
+        lod.firstMeshlet = static_cast<std::uint32_t>(mMeshlets.size());
+        lod.meshletCount = static_cast<std::uint32_t>(meshlets.size());
+        for (auto& meshlet : meshlets)
+        {
+            meshlet.firstIndex += lod.firstIndex;
+        }
+
+        mIndices.insert(mIndices.end(), indices.begin(), indices.end());
+        mMeshlets.insert(mMeshlets.end(), meshlets.begin(), meshlets.end());
+        mMeshLods.push_back(lod);
+    }
+
+    fmt::print("{}: {} -> {} vertices ({} -> {} bytes), {} indices, "
+               "ACMR {:.3f} -> {:.3f}, {} meshlets, {} LODs\n",
+               filename,
+               shape.vertices.size(),
+               mVertices.size(),
+               shape.vertices.size() * sizeof(Vertex),
+               mVertices.size() * sizeof(Vertex),
+               mIndices.size(),
+               acmrBefore,
+               acmrAfter,
+               mMeshlets.size(),
+               mMeshLods.size());
+    for (std::size_t i{0}; i < mMeshLods.size(); ++i)
+    {
+        fmt::print("  LOD {}: {} indices, {} meshlets\n",
+                   i,
+                   mMeshLods[i].indexCount,
+                   mMeshLods[i].meshletCount);
+    }
+
+    if (!writeMeshCache(cacheName,
+                        cacheKey,
+                        mVertices.data(),
+                        sizeof(Vertex),
+                        mVertices.size(),
+                        mIndices.data(),
+                        mIndices.size(),
+                        mMeshlets.data(),
+                        mMeshlets.size(),
+                        mMeshLods.data(),
+                        mMeshLods.size()))
+    {
+        fmt::print("warning: unable to write mesh cache {}.\n", cacheName);
+    }
+
+    mMesh.vertices    = mVertices.data();
+    mMesh.vertexCount = mVertices.size();
+    mMesh.indices      = mIndices.data();
+    mMesh.indexCount   = mIndices.size();
+    mMesh.meshlets     = mMeshlets.data();
+    mMesh.meshletCount = mMeshlets.size();
+    mMesh.lods         = mMeshLods.data();
+    mMesh.lodCount     = mMeshLods.size();
+}
+
+void Application::updateInstanceStats(double milliseconds)
+{
+    mInstanceTime += milliseconds;
+    if (++mInstanceFrames < globals::instanceSampleFrames)
+    {
+        return;
+    }
+
+    // The whole frame is timed, which includes waiting for the GPU, so once
+    // the GPU is the bottleneck this tracks the cost of the extra instances.
+    fmt::print("instancing: {} instance(s), {} draws, {:.3f} ms/frame\n",
+               mInstanceCount,
+               mVisibleDraws.size(),
+               mInstanceTime / mInstanceFrames);
+
+    mInstanceTime   = 0.0;
+    mInstanceFrames = 0;
+    if (mInstanceCount < globals::maxInstances)
+    {
+        mInstanceCount = std::min(mInstanceCount * 4, globals::maxInstances);
+    }
+}
+
+void Application::createDrawList()
+{
+    mDrawItems.clear();
+    for (std::uint32_t i{0}; i < mMesh.meshletCount; ++i)
+    {
+        auto const& meshlet = mMesh.meshlets[i];
+        mDrawItems.push_back({meshlet.firstIndex, meshlet.indexCount, i, 0, 1});
+    }
+    mVisibleDraws.assign(mDrawItems.begin(),
+                         mDrawItems.begin() + mMesh.lods[0].meshletCount);
+}
+
+void Application::cullClusters()
+{
+    glm::vec3 meshCentre{mModelMatrix *
+                         glm::vec4{glm::vec3{mBoundingSphere}, 1.0f}};
+    mVisibleDraws.clear();
+
+    // Clusters are culled against the model's own transform, so with more
+    // than one instance they would need testing once per instance. That is
+    // what the GPU path is for; here neighbouring instances mostly agree on
+    // a level of detail, so each run of them gets one instanced draw.
+    if (mInstanceCount != 1)
+    {
+        std::uint32_t firstInstance{0};
+        auto lod = selectLod(meshCentre + getInstanceOffset(0));
+        for (std::uint32_t i{1}; i <= mInstanceCount; ++i)
+        {
+            auto next = (i < mInstanceCount)
+                            ? selectLod(meshCentre + getInstanceOffset(i))
+                            : lod + 1;
+            if (next == lod)
+            {
+                continue;
+            }
+
+            auto const& range = mMesh.lods[lod];
+            mVisibleDraws.push_back({range.firstIndex,
+                                     range.indexCount,
+                                     range.firstMeshlet,
+                                     firstInstance,
+                                     i - firstInstance});
+            firstInstance = i;
+            lod           = next;
+        }
+        return;
+    }
+
+    auto const& range = mMesh.lods[selectLod(meshCentre)];
+    auto firstDraw    = mDrawItems.begin() + range.firstMeshlet;
+    auto lastDraw     = firstDraw + range.meshletCount;
+    if (!globals::enableClusterCulling)
+    {
+        mVisibleDraws.assign(firstDraw, lastDraw);
+        return;
+    }
+
+    glm::vec3 camera{mUniforms.cameraPosition};
+    for (auto it = firstDraw; it != lastDraw; ++it)
+    {
+        auto const& draw    = *it;
+        auto const& meshlet = mMesh.meshlets[draw.meshlet];
+        glm::vec3 centre{mModelMatrix *
+                         glm::vec4{glm::make_vec3(meshlet.centre), 1.0f}};
+        glm::vec3 axis{mModelMatrix *
+                       glm::vec4{glm::make_vec3(meshlet.coneAxis), 0.0f}};
+
+        auto const& planes = mUniforms.frustumPlanes;
+        bool visible       = std::all_of(
+            planes.begin(), planes.end(), [&](glm::vec4 const& plane) {
+                return glm::dot(glm::vec3{plane}, centre) + plane.w >=
+                       -meshlet.radius;
+            });
+
+        // The cluster faces away from the camera if the camera lies inside
+        // the cone opposite to its normals (offset by the bounding sphere).
+        glm::vec3 toCentre = centre - camera;
+        bool backFacing    = glm::dot(toCentre, axis) >=
+                          meshlet.coneCutoff * glm::length(toCentre) +
+                              meshlet.radius;
+
+        if (visible && !backFacing)
+        {
+            mVisibleDraws.push_back(draw);
+        }
+    }
+}
+
+std::uint32_t Application::selectLod(glm::vec3 const& centre) const
+{
+    // The same selection as cull.comp. The sphere's size on screen, scaled
+    // by mLodScale, is the square root of the triangles it is worth drawing.
+    auto radius   = mBoundingSphere.w;
+    auto distance = std::max(
+        glm::length(centre - glm::vec3{mUniforms.cameraPosition}) - radius,
+        0.01f);
+    auto size      = radius * mLodScale / distance;
+    auto triangles = size * size;
+
+    std::uint32_t lod{0};
+    while (lod + 1 < mMesh.lodCount &&
+           static_cast<float>(mMesh.lods[lod + 1].indexCount / 3) >= triangles)
+    {
+        ++lod;
+    }
+    return lod;
+}
+
+void Application::createMeshletBuffer()
+{
+    if (!mGpuCulling)
+    {
+        return;
+    }
+
+    vk::DeviceSize bufferSize = sizeof(Meshlet) * mMesh.meshletCount;
+    auto stagingBuffer = mUploadContext.stage(mMesh.meshlets, bufferSize);
+
+    vk::Buffer meshletBuffer;
+    createBuffer(bufferSize,
+                 vk::BufferUsageFlagBits::eTransferDst |
+                     vk::BufferUsageFlagBits::eStorageBuffer,
+                 vk::MemoryPropertyFlagBits::eDeviceLocal,
+                 meshletBuffer,
+                 mMeshletBufferMemory);
+    mMeshletBuffer = vk::UniqueBuffer(meshletBuffer, *mDevice);
+
+    copyBuffer(stagingBuffer, meshletBuffer, bufferSize);
+    mUploadContext.transferBufferOwnership(
+        meshletBuffer,
+        vk::AccessFlagBits::eShaderRead,
+        vk::PipelineStageFlagBits::eComputeShader);
+
+    // Culling picks a level of detail per instance, so it needs the ranges
+    // of every level as well.
+    bufferSize    = sizeof(MeshLod) * mMesh.lodCount;
+    stagingBuffer = mUploadContext.stage(mMesh.lods, bufferSize);
+
+    vk::Buffer lodBuffer;
+    createBuffer(bufferSize,
+                 vk::BufferUsageFlagBits::eTransferDst |
+                     vk::BufferUsageFlagBits::eStorageBuffer,
+                 vk::MemoryPropertyFlagBits::eDeviceLocal,
+                 lodBuffer,
+                 mLodBufferMemory);
+    mLodBuffer = vk::UniqueBuffer(lodBuffer, *mDevice);
+
+    copyBuffer(stagingBuffer, lodBuffer, bufferSize);
+    mUploadContext.transferBufferOwnership(
+        lodBuffer,
+        vk::AccessFlagBits::eShaderRead,
+        vk::PipelineStageFlagBits::eComputeShader);
+}
+
+void Application::computeBoundingSphere()
+{
+    // The centre of the bounding box and the furthest vertex from it. Not the
+    // tightest sphere, but conservative, which is all culling needs.
+    glm::vec3 minimum{std::numeric_limits<float>::max()};
+    glm::vec3 maximum{std::numeric_limits<float>::lowest()};
+    for (std::size_t i{0}; i < mMesh.vertexCount; ++i)
+    {
+        minimum = glm::min(minimum, mMesh.vertices[i].pos);
+        maximum = glm::max(maximum, mMesh.vertices[i].pos);
+    }
+
+    glm::vec3 centre = (minimum + maximum) * 0.5f;
+    float radius{0.0f};
+    for (std::size_t i{0}; i < mMesh.vertexCount; ++i)
+    {
+        radius = std::max(radius, glm::length(mMesh.vertices[i].pos - centre));
     }
+
+    mBoundingSphere = glm::vec4{centre, radius};
+    mMeshMinimum    = minimum;
+    mMeshMaximum    = maximum;
 }
 
 void Application::generateMipmaps(vk::Image const& image,
@@ -1779,15 +3795,32 @@ void Application::generateMipmaps(vk::Image const& image,
                                   std::int32_t texHeight,
                                   std::uint32_t mipLevels)
 {
+    // The compute shader averages texels itself, so it has no need for
+    // linear filtering.
     auto formatProperties = mPhysicalDevice.getFormatProperties(format);
-    if (!(formatProperties.optimalTilingFeatures &
+    if (!mComputeMipmaps &&
+        !(formatProperties.optimalTilingFeatures &
           vk::FormatFeatureFlagBits::eSampledImageFilterLinear))
     {
         throw std::runtime_error{
             "error: texture image format does not support linear blitting."};
     }
 
-    auto commandBuffer = beginSingleTimeCommands();
+    auto commandBuffer = mUploadContext.getGraphicsCommandBuffer();
+    auto slot          = mGpuProfiler.getUploadSlot();
+    auto scope =
+        mGpuProfiler.beginScope(commandBuffer, slot, "generateMipmaps");
+    if (mComputeMipmaps)
+    {
+        generateMipmapsCompute(commandBuffer,
+                               image,
+                               vk::ImageLayout::eTransferDstOptimal,
+                               texWidth,
+                               texHeight,
+                               mipLevels);
+        mGpuProfiler.endScope(commandBuffer, slot, scope);
+        return;
+    }
 
     vk::ImageMemoryBarrier barrier;
     barrier.image                           = image;
@@ -1869,42 +3902,192 @@ void Application::generateMipmaps(vk::Image const& image,
                                   {},
                                   {},
                                   {barrier});
-
-    endSingleTimeCommands(commandBuffer);
+    mGpuProfiler.endScope(commandBuffer, slot, scope);
 }
 
-vk::SampleCountFlagBits Application::getMaxUsableSampleCount()
+void Application::generateMipmapsCompute(vk::CommandBuffer const& commandBuffer,
+                                         vk::Image const& image,
+                                         vk::ImageLayout const& oldLayout,
+                                         std::int32_t texWidth,
+                                         std::int32_t texHeight,
+                                         std::uint32_t mipLevels)
 {
-    auto physicalDeviceProperties = mPhysicalDevice.getProperties();
+    // Every level is read or written as a storage image, whatever layout it
+    // was filled in, so textures rendered at runtime can be passed in too.
+    auto transition = core::getLayoutTransition(image,
+                                                globals::mipmapFormat,
+                                                oldLayout,
+                                                vk::ImageLayout::eGeneral,
+                                                mipLevels);
+    transition.barrier.dstAccessMask =
+        vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+    commandBuffer.pipelineBarrier(transition.sourceStage,
+                                  vk::PipelineStageFlagBits::eComputeShader,
+                                  {},
+                                  {},
+                                  {},
+                                  {transition.barrier});
+
+    std::vector<vk::UniqueImageView> views;
+    for (std::uint32_t i{0}; i < mipLevels; ++i)
+    {
+        vk::ImageViewCreateInfo viewInfo;
+        viewInfo.image    = image;
+        viewInfo.viewType = vk::ImageViewType::e2D;
+        viewInfo.format   = globals::mipmapFormat;
+        viewInfo.subresourceRange.aspectMask =
+            vk::ImageAspectFlagBits::eColor;
+        viewInfo.subresourceRange.baseMipLevel   = i;
+        viewInfo.subresourceRange.levelCount     = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount     = 1;
+        views.push_back(mDevice->createImageViewUnique(viewInfo));
+    }
+
+    // Each dispatch writes the next few levels from the last one the
+    // dispatch before it wrote.
+    auto bindingCount = globals::mipmapDispatchLevels + 1;
+    auto dispatchCount =
+        (mipLevels + globals::mipmapDispatchLevels - 2) /
+        globals::mipmapDispatchLevels;
+    if (dispatchCount > 0)
+    {
+        vk::DescriptorPoolSize poolSize;
+        poolSize.type            = vk::DescriptorType::eStorageImage;
+        poolSize.descriptorCount = dispatchCount * bindingCount;
+
+        vk::DescriptorPoolCreateInfo poolInfo;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes    = &poolSize;
+        poolInfo.maxSets       = dispatchCount;
+        auto pool = mDevice->createDescriptorPoolUnique(poolInfo);
+
+        std::vector<vk::DescriptorSetLayout> layouts(dispatchCount,
+                                                     *mMipmapSetLayout);
+        vk::DescriptorSetAllocateInfo allocInfo;
+        allocInfo.descriptorPool     = *pool;
+        allocInfo.descriptorSetCount = dispatchCount;
+        allocInfo.pSetLayouts        = layouts.data();
+        auto sets = mDevice->allocateDescriptorSets(allocInfo);
+
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute,
+                                   *mMipmapPipeline);
+        for (std::uint32_t i{0}; i < dispatchCount; ++i)
+        {
+            // Levels past the end of the chain are never written, but every
+            // binding still needs a view.
+            auto base = i * globals::mipmapDispatchLevels;
+            std::vector<vk::DescriptorImageInfo> imageInfos(bindingCount);
+            std::vector<vk::WriteDescriptorSet> writes(bindingCount);
+            for (std::uint32_t j{0}; j < bindingCount; ++j)
+            {
+                auto level = std::min(base + j, mipLevels - 1);
+                imageInfos[j].imageView   = *views[level];
+                imageInfos[j].imageLayout = vk::ImageLayout::eGeneral;
+
+                writes[j].dstSet          = sets[i];
+                writes[j].dstBinding      = j;
+                writes[j].descriptorCount = 1;
+                writes[j].descriptorType  = vk::DescriptorType::eStorageImage;
+                writes[j].pImageInfo      = &imageInfos[j];
+            }
+            mDevice->updateDescriptorSets(writes, {});
+
+            if (i > 0)
+            {
+                vk::MemoryBarrier barrier;
+                barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+                barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+                commandBuffer.pipelineBarrier(
+                    vk::PipelineStageFlagBits::eComputeShader,
+                    vk::PipelineStageFlagBits::eComputeShader,
+                    {},
+                    {barrier},
+                    {},
+                    {});
+            }
+
+            MipmapPushConstants constants;
+            constants.sourceSize = glm::ivec2{std::max(texWidth >> base, 1),
+                                              std::max(texHeight >> base, 1)};
+            constants.levelCount =
+                std::min(globals::mipmapDispatchLevels, mipLevels - 1 - base);
+
+            commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                             *mMipmapPipelineLayout,
+                                             0,
+                                             {sets[i]},
+                                             {});
+            commandBuffer.pushConstants(*mMipmapPipelineLayout,
+                                        vk::ShaderStageFlagBits::eCompute,
+                                        0,
+                                        sizeof(MipmapPushConstants),
+                                        &constants);
+
+            auto groupCount = [](std::int32_t size) {
+                return (static_cast<std::uint32_t>(size) +
+                        globals::mipmapTileSize - 1) /
+                       globals::mipmapTileSize;
+            };
+            commandBuffer.dispatch(groupCount(constants.sourceSize.x),
+                                   groupCount(constants.sourceSize.y),
+                                   1);
+        }
+
+        mUploadContext.retire(std::move(pool));
+    }
+
+    vk::ImageMemoryBarrier barrier = transition.barrier;
+    barrier.oldLayout     = vk::ImageLayout::eGeneral;
+    barrier.newLayout     = vk::ImageLayout::eShaderReadOnlyOptimal;
+    barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                  vk::PipelineStageFlagBits::eFragmentShader,
+                                  {},
+                                  {},
+                                  {},
+                                  {barrier});
+
+    // The views are only used by this batch.
+    for (auto& view : views)
+    {
+        mUploadContext.retire(std::move(view));
+    }
+}
 
-    auto colorSampleCounts = static_cast<VkMemoryMapFlags>(
-        physicalDeviceProperties.limits.framebufferColorSampleCounts);
-    auto depthSampleCounts = static_cast<VkMemoryMapFlags>(
-        physicalDeviceProperties.limits.framebufferDepthSampleCounts);
+vk::SampleCountFlagBits
+Application::getMaxUsableSampleCount(vk::PhysicalDevice const& device)
+{
+    auto physicalDeviceProperties = device.getProperties();
 
-    std::uint32_t counts = std::min(colorSampleCounts, depthSampleCounts);
+    // The colour and depth attachments share a sample count, so it has to be
+    // one that both of them support.
+    vk::SampleCountFlags counts =
+        physicalDeviceProperties.limits.framebufferColorSampleCounts &
+        physicalDeviceProperties.limits.framebufferDepthSampleCounts;
 
-    if (counts & VK_SAMPLE_COUNT_64_BIT)
+    if (counts & vk::SampleCountFlagBits::e64)
     {
         return vk::SampleCountFlagBits::e64;
     }
-    if (counts & VK_SAMPLE_COUNT_32_BIT)
+    if (counts & vk::SampleCountFlagBits::e32)
     {
         return vk::SampleCountFlagBits::e32;
     }
-    if (counts & VK_SAMPLE_COUNT_16_BIT)
+    if (counts & vk::SampleCountFlagBits::e16)
     {
         return vk::SampleCountFlagBits::e16;
     }
-    if (counts & VK_SAMPLE_COUNT_8_BIT)
+    if (counts & vk::SampleCountFlagBits::e8)
     {
         return vk::SampleCountFlagBits::e8;
     }
-    if (counts & VK_SAMPLE_COUNT_4_BIT)
+    if (counts & vk::SampleCountFlagBits::e4)
     {
         return vk::SampleCountFlagBits::e4;
     }
-    if (counts & VK_SAMPLE_COUNT_2_BIT)
+    if (counts & vk::SampleCountFlagBits::e2)
     {
         return vk::SampleCountFlagBits::e2;
     }
@@ -1912,28 +4095,40 @@ vk::SampleCountFlagBits Application::getMaxUsableSampleCount()
     return vk::SampleCountFlagBits::e1;
 }
 
-void Application::createColourResources()
+vk::SampleCountFlagBits Application::chooseSampleCount()
 {
-    vk::Format colourFormat = mSwapchainImageFormat;
+    // Sample counts are powers of two, as are the flag bits.
+    auto maxSamples =
+        static_cast<std::uint32_t>(getMaxUsableSampleCount(mPhysicalDevice));
+    if (mSettings.sampleCount != 0)
+    {
+        return static_cast<vk::SampleCountFlagBits>(
+            std::min(mSettings.sampleCount, maxSamples));
+    }
 
-    vk::Image image;
-    vk::DeviceMemory imageMemory;
-    createImage(mSwapchainExtent.width,
-                mSwapchainExtent.height,
-                1,
-                mMSAASamples,
-                colourFormat,
-                vk::ImageTiling::eOptimal,
-                vk::ImageUsageFlagBits::eTransientAttachment |
-                    vk::ImageUsageFlagBits::eColorAttachment,
-                vk::MemoryPropertyFlagBits::eDeviceLocal,
-                image,
-                imageMemory);
+    auto samples = std::min(globals::defaultSampleCount, maxSamples);
+
+    bool hasLazyMemory{false};
+    auto memProperties = mPhysicalDevice.getMemoryProperties();
+    for (std::uint32_t i{0}; i < memProperties.memoryTypeCount; ++i)
+    {
+        if (memProperties.memoryTypes[i].propertyFlags &
+            vk::MemoryPropertyFlagBits::eLazilyAllocated)
+        {
+            hasLazyMemory = true;
+            break;
+        }
+    }
 
-    auto imageView = createImageView(
-        image, colourFormat, vk::ImageAspectFlagBits::eColor, 1);
+    if (!hasLazyMemory)
+    {
+        vk::DeviceSize pixels = globals::windowWidth * globals::windowHeight;
+        while (samples > 1 && pixels * samples * globals::msaaBytesPerSample >
+                                  globals::msaaMemoryBudget)
+        {
+            samples /= 2;
+        }
+    }
 
-    mColourImage       = vk::UniqueImage(image, *mDevice);
-    mColourImageMemory = vk::UniqueDeviceMemory(imageMemory, *mDevice);
-    mColourImageView   = vk::UniqueImageView(imageView, *mDevice);
+    return static_cast<vk::SampleCountFlagBits>(samples);
 }
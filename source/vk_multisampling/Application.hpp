@@ -7,20 +7,44 @@
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/hash.hpp>
+
+#include "CpuProfiler.hpp"
+#include "DeletionQueue.hpp"
+#include "FrameScheduler.hpp"
+#include "GpuProfiler.hpp"
+#include "JobSystem.hpp"
+#include "MemoryAllocator.hpp"
+#include "MeshCache.hpp"
+#include "PipelineCache.hpp"
+#include "RenderGraph.hpp"
+#include "Settings.hpp"
+#include "ShaderWatcher.hpp"
+#include "TextureContainer.hpp"
+#include "TextureStreamer.hpp"
+#include "UploadContext.hpp"
+#include "VertexLayout.hpp"
+#include "VulkanHelpers.hpp"
 
 #include <atlas/utils/Cameras.hpp>
 
 #include <algorithm>
 #include <chrono>
 #include <functional>
+#include <future>
+#include <map>
 #include <optional>
+#include <tuple>
 
 struct QueueFamilyIndices
 {
     std::optional<std::uint32_t> graphicsFamily;
     std::optional<std::uint32_t> presentFamily;
+    std::optional<std::uint32_t> transferFamily;
 
     bool isComplete() const
     {
@@ -28,37 +52,197 @@ struct QueueFamilyIndices
     }
 };
 
-struct SwapChainSupportDetails
+// How suitable devices are compared, most important first: the kind of GPU,
+// how much memory it has of its own, how many of uploads and compute can
+// run beside graphics, and how many MSAA samples it goes up to.
+struct DeviceRating
 {
-    vk::SurfaceCapabilitiesKHR capabilities;
-    std::vector<vk::SurfaceFormatKHR> formats;
-    std::vector<vk::PresentModeKHR> presentModes;
+    std::uint32_t type{0};
+    vk::DeviceSize localMemory{0};
+    std::uint32_t queues{0};
+    std::uint32_t samples{0};
+
+    bool operator<(DeviceRating const& other) const
+    {
+        return std::tie(type, localMemory, queues, samples) <
+               std::tie(other.type,
+                        other.localMemory,
+                        other.queues,
+                        other.samples);
+    }
 };
 
+using SwapChainSupportDetails = core::SwapChainSupportDetails;
+
+// The full precision vertex the model is loaded and cached as. What actually
+// gets uploaded is decided by the vertex layout, see VertexLayout.hpp.
 struct Vertex
 {
     glm::vec3 pos;
     glm::vec3 colour;
     glm::vec2 texCoord;
 
-    static vk::VertexInputBindingDescription getBindingDescription();
-    static std::array<vk::VertexInputAttributeDescription, 3>
-    getAttributeDescriptions();
+    bool operator==(Vertex const& other) const
+    {
+        return pos == other.pos && colour == other.colour &&
+               texCoord == other.texCoord;
+    }
+};
+
+namespace std
+{
+    template<>
+    struct hash<Vertex>
+    {
+        std::size_t operator()(Vertex const& vertex) const
+        {
+            std::size_t seed = hash<glm::vec3>()(vertex.pos);
+            seed ^= (hash<glm::vec3>()(vertex.colour) << 1);
+            seed = (seed >> 1) ^ (hash<glm::vec2>()(vertex.texCoord) << 1);
+            return seed;
+        }
+    };
+} // namespace std
+
+// Per-instance attributes, fed through a vertex binding after the ones used
+// by the vertex layout that advances once per instance instead of once per
+// vertex.
+struct InstanceData
+{
+    glm::mat4 model;
+
+    static vk::VertexInputBindingDescription
+    getBindingDescription(std::uint32_t binding);
+    static std::array<vk::VertexInputAttributeDescription, 4>
+    getAttributeDescriptions(std::uint32_t binding);
+};
+
+// The vertex and index data that gets uploaded. It either points into the
+// memory mapped mesh cache or into the arrays built by loadModel.
+struct MeshData
+{
+    Vertex const* vertices{nullptr};
+    std::size_t vertexCount{0};
+    std::uint32_t const* indices{nullptr};
+    std::size_t indexCount{0};
+    Meshlet const* meshlets{nullptr};
+    std::size_t meshletCount{0};
+    MeshLod const* lods{nullptr};
+    std::size_t lodCount{0};
+};
+
+// The CPU side of the texture, filled in by loadTexture. Either a container
+// with its mip chain baked in is mapped, or the source image was decoded.
+struct TextureData
+{
+    TextureContainer container;
+    bool hasContainer{false};
+    std::vector<std::uint8_t> pixels;
+    std::uint32_t width{0};
+    std::uint32_t height{0};
 };
 
+// A contiguous range of the index buffer, one per meshlet. Drawing the mesh
+// as many of these lets clusters be culled individually, and gives a
+// realistic amount of recording work to spread across threads. With several
+// instances a whole level of detail is drawn for a run of instances instead.
+struct DrawItem
+{
+    std::uint32_t firstIndex;
+    std::uint32_t indexCount;
+    std::uint32_t meshlet;
+    std::uint32_t firstInstance;
+    std::uint32_t instanceCount;
+};
+
+// Command pools can't be used from two threads at once, so every recording
+// thread gets its own pool and secondary buffer for each frame in flight.
+struct ThreadCommands
+{
+    vk::UniqueCommandPool commandPool;
+    vk::UniqueCommandBuffer commandBuffer;
+};
+
+// Everything a frame in flight records into. The whole pool is reset once the
+// frame's fence has signalled, which is cheaper than resetting each buffer.
+struct FrameCommands
+{
+    vk::UniqueCommandPool commandPool;
+    vk::UniqueCommandBuffer commandBuffer;
+    std::vector<ThreadCommands> threads;
+};
+
+// Shared by every draw in a frame. The model matrix of each draw is pushed
+// instead, see DrawPushConstants.
 struct UniformMatrices
+{
+    glm::mat4 viewProjection;
+
+    // Left, right, bottom, top, near and far planes of projection * view,
+    // with the normals pointing inwards.
+    std::array<glm::vec4, 6> frustumPlanes;
+    glm::vec4 cameraPosition;
+
+    // Turns the positions stored by the vertex layout back into model space.
+    glm::vec4 positionScale;
+    glm::vec4 positionOffset;
+};
+
+// Pushed before every draw, so moving an object or switching its texture
+// costs no uniform writes or descriptor binds. The model matrix is read by
+// the vertex stage and the texture index by the fragment stage.
+struct DrawPushConstants
 {
     glm::mat4 model;
-    glm::mat4 view;
-    glm::mat4 projection;
+    std::uint32_t textureIndex;
+};
+
+// What the main pass can be built with. Each pipeline variant is keyed by
+// the mask of the features it has. Texturing reaches both shader stages as a
+// specialisation constant, so an untextured variant has no sampling or
+// texture coordinates left in it, while sample shading is pipeline state.
+enum ShaderFeature : std::uint32_t
+{
+    featureTexture       = 1u << 0,
+    featureSampleShading = 1u << 1,
+};
+using ShaderFeatures = std::uint32_t;
+
+// The specialisation data shared by both stages of the main pass. Boolean
+// constants are 32 bits wide.
+struct ShaderConstants
+{
+    std::uint32_t textureCount;
+    vk::Bool32 textured;
+};
+
+struct CullPushConstants
+{
+    glm::mat4 model;
+    glm::vec4 boundingSphere;
+    std::uint32_t instanceCount;
+    std::uint32_t lodCount;
+    std::uint32_t compact;
+    std::uint32_t meshletCount;
+    std::uint32_t commandCapacity;
+    float lodScale;
+};
+
+struct MipmapPushConstants
+{
+    glm::ivec2 sourceSize;
+    std::uint32_t levelCount;
 };
 
 class Application
 {
 public:
+    explicit Application(Settings const& settings = {});
+
     void run();
     void framebuffeResized();
     void redrawWindow();
+    void toggleShaderFeature(ShaderFeature feature);
 
 private:
     void initVulkan();
@@ -98,6 +282,7 @@ private:
 
     void pickPhysicalDevice();
     bool isDeviceSuitable(vk::PhysicalDevice const& device);
+    DeviceRating rateDevice(vk::PhysicalDevice const& device);
     QueueFamilyIndices findQueueFamilies(vk::PhysicalDevice const& device);
 
     void createLogicalDevice();
@@ -113,49 +298,80 @@ private:
         std::vector<vk::PresentModeKHR> const& availablePresentModes);
     vk::Extent2D
     chooseSwapExtent(vk::SurfaceCapabilitiesKHR const& capabilities);
-    void createSwapChain();
+    void createSwapChain(vk::SwapchainKHR oldSwapchain = {});
+    void createOffscreenTargets();
 
     void createImageViews();
 
     void createGraphicsPipeline();
+    void createCullPipeline();
+    void createMipmapPipeline();
+    void watchShaders();
+    void reloadShaders();
     vk::UniqueShaderModule createShaderModule(std::vector<char> const& code);
 
-    void createRenderPass();
-
-    void createFramebuffers();
+    void createRenderGraph();
+    void compileRenderGraph();
 
     void createCommandPool();
     void createCommandBuffers();
+    void recordCommandBuffer(std::size_t frame, std::uint32_t imageIndex);
+    vk::CommandBuffer beginSecondaryCommandBuffer(std::size_t frame,
+                                                  std::size_t thread,
+                                                  PassContext const& context);
+    void recordScenePass(PassContext const& context);
+    void recordCulling(vk::CommandBuffer const& commandBuffer,
+                       std::size_t frame);
+    void recordScene(vk::CommandBuffer const& commandBuffer,
+                     std::size_t frame,
+                     std::size_t firstDraw,
+                     std::size_t drawCount);
+    void recordDraws(vk::CommandBuffer const& commandBuffer,
+                     std::size_t frame,
+                     std::size_t firstDraw,
+                     std::size_t drawCount);
+    void updateRecordingStats(double milliseconds);
+    void updateInstanceStats(double milliseconds);
 
     void createSyncObjects();
     void drawFrame();
+    void limitFrameRate();
+
+    void runBenchmark();
+    void writeBenchmarkReport(double seconds);
 
     void recreateSwapChain();
     void cleanupSwapChain();
 
     void createVertexBuffer();
-    std::uint32_t findMemoryType(std::uint32_t typeFilter,
-                                 vk::MemoryPropertyFlags const& properties);
 
     void createBuffer(vk::DeviceSize const& size,
                       vk::BufferUsageFlags const& usage,
                       vk::MemoryPropertyFlags const& properties,
                       vk::Buffer& buffer,
-                      vk::DeviceMemory& bufferMemory);
+                      Allocation& bufferMemory);
     void copyBuffer(vk::Buffer const& srcBuffer,
                     vk::Buffer const& dstBuffer,
                     vk::DeviceSize const& size);
 
     void createIndexBuffer();
+    void createInstanceBuffer();
 
     void createDescriptorSetLayout();
     void createUniformBuffers();
-    void updateUniformBuffer(std::uint32_t currentImage);
+    void createIndirectBuffers();
+    void updateUniformBuffer(std::size_t currentFrame);
 
     void createDescriptorPool();
     void createDescriptorSets();
+    std::uint32_t registerTexture(vk::ImageView const& imageView);
+    void writeTexture(std::uint32_t slot, vk::ImageView const& imageView);
+    void updateTextureStreaming();
 
+    void loadTexture();
+    void decodeTexture(std::string const& filename);
     void createTextureImage();
+    void createTextureImageFromContainer();
     void createImage(std::uint32_t width,
                      std::uint32_t height,
                      std::uint32_t mipLevel,
@@ -165,14 +381,13 @@ private:
                      vk::ImageUsageFlags const& usage,
                      vk::MemoryPropertyFlags const& properties,
                      vk::Image& image,
-                     vk::DeviceMemory& imageMemory);
-    vk::CommandBuffer beginSingleTimeCommands();
-    void endSingleTimeCommands(vk::CommandBuffer const& commandBuffer);
+                     Allocation& imageMemory);
     void transitionImageLayout(vk::Image const& image,
                                vk::Format const& format,
                                vk::ImageLayout const& oldLayout,
                                vk::ImageLayout const& newLayout,
                                std::uint32_t mipLevels);
+    std::uint32_t beginTransferScope(char const* name);
     void copyBufferToImage(vk::Buffer const& buffer,
                            vk::Image const& image,
                            std::uint32_t width,
@@ -185,7 +400,6 @@ private:
                                   std::uint32_t mipLevels);
     void createTextureSampler();
 
-    void createDepthResources();
     vk::Format findSupportedFormat(std::vector<vk::Format> const& candidates,
                                    vk::ImageTiling const& tiling,
                                    vk::FormatFeatureFlags const& features);
@@ -193,15 +407,27 @@ private:
     bool hasStencilComponent(vk::Format const& format);
 
     void loadModel();
+    void createDrawList();
+    void createMeshletBuffer();
+    void cullClusters();
+    std::uint32_t selectLod(glm::vec3 const& centre) const;
+    void computeBoundingSphere();
 
     void generateMipmaps(vk::Image const& image,
                          vk::Format const& format,
                          std::int32_t texWidth,
                          std::int32_t texHeight,
                          std::uint32_t mipLevels);
+    void generateMipmapsCompute(vk::CommandBuffer const& commandBuffer,
+                                vk::Image const& image,
+                                vk::ImageLayout const& oldLayout,
+                                std::int32_t texWidth,
+                                std::int32_t texHeight,
+                                std::uint32_t mipLevels);
 
-    vk::SampleCountFlagBits getMaxUsableSampleCount();
-    void createColourResources();
+    vk::SampleCountFlagBits
+    getMaxUsableSampleCount(vk::PhysicalDevice const& device);
+    vk::SampleCountFlagBits chooseSampleCount();
 
     GLFWwindow* mWindow{nullptr};
 
@@ -209,65 +435,160 @@ private:
     vk::UniqueDebugUtilsMessengerEXT mDebugMessenger;
 
     vk::PhysicalDevice mPhysicalDevice;
+    std::string mDeviceName;
+
+    // How many GPUs the driver links the chosen one with. Only reported,
+    // the frame still runs on the one device.
+    std::uint32_t mDeviceGroupSize{1};
     vk::UniqueDevice mDevice;
+    MemoryAllocator mAllocator;
+    UploadContext mUploadContext;
+    PipelineCache mPipelineCache;
+    ShaderWatcher mShaderWatcher;
+    GpuProfiler mGpuProfiler;
+    CpuProfiler mCpuProfiler;
 
     vk::Queue mGraphicsQueue;
+    vk::Queue mTransferQueue;
 
     vk::UniqueSurfaceKHR mSurface;
     vk::Queue mPresentQueue;
 
     vk::UniqueSwapchainKHR mSwapchain;
     std::vector<vk::Image> mSwapchainImages;
+
+    // Stand-ins for the swap chain images when running headless.
+    std::vector<vk::UniqueImage> mOffscreenImages;
+    std::vector<Allocation> mOffscreenImageMemory;
     vk::Format mSwapchainImageFormat;
     vk::Extent2D mSwapchainExtent;
     std::vector<vk::UniqueImageView> mSwapchainImageViews;
-    vk::UniqueRenderPass mRenderPass;
-    vk::UniqueDescriptorSetLayout mDescriptorSetLayout;
-    vk::UniquePipelineLayout mPipelineLayout;
-    vk::UniquePipeline mGraphicsPipeline;
-    std::vector<vk::UniqueFramebuffer> mSwapchainFramebuffers;
 
-    vk::UniqueCommandPool mCommandPool;
-    vk::UniqueCommandPool mBufferPool;
-    std::vector<vk::UniqueCommandBuffer> mCommandBuffers;
-
-    std::vector<vk::UniqueSemaphore> mImageAvailableSemaphores;
-    std::vector<vk::UniqueSemaphore> mRenderFinishedSemaphores;
-
-    std::vector<vk::UniqueFence> mInFlightFences;
+    // The colour and depth attachments are transient images of the graph,
+    // the swap chain images are imported into it.
+    RenderGraph mRenderGraph;
+    RenderGraph::Handle mSwapchainResource{0};
+    RenderGraph::Handle mScenePass{0};
 
+    vk::UniqueDescriptorSetLayout mDescriptorSetLayout;
+    vk::UniquePipelineLayout mPipelineLayout;
+    vk::UniquePipeline mDepthPipeline;
+
+    // Every combination of the supported features is built together, so
+    // switching the mesh between them never compiles anything mid-frame.
+    std::map<ShaderFeatures, vk::UniquePipeline> mPipelineVariants;
+    ShaderFeatures mSupportedFeatures{featureTexture};
+    ShaderFeatures mMeshFeatures{0};
+    bool mHasSampleShading{false};
+    bool mDepthPrepass{false};
+
+    // GPU culling is only used when the device can draw many indirect
+    // commands with a non-zero first instance.
+    bool mGpuCulling{false};
+    bool mHasDrawIndirectCount{false};
+    vk::UniqueDescriptorSetLayout mCullSetLayout;
+    vk::UniquePipelineLayout mCullPipelineLayout;
+    vk::UniquePipeline mCullPipeline;
+
+    // The pipeline only exists where mip chains can be generated in a compute
+    // shader, and mComputeMipmaps is whether the texture's actually was.
+    bool mComputeMipmaps{false};
+    vk::UniqueDescriptorSetLayout mMipmapSetLayout;
+    vk::UniquePipelineLayout mMipmapPipelineLayout;
+    vk::UniquePipeline mMipmapPipeline;
+
+    std::vector<FrameCommands> mFrameCommands;
+    JobSystem mJobSystem;
+    std::size_t mRecordThreads{1};
+    std::size_t mRecordFrames{0};
+    double mRecordTime{0.0};
+    bool mRecordSweepDone{false};
+
+    // Frames in flight, uploads and swap chain images are all tracked by
+    // how far the graphics queue has got, see FrameScheduler. Whatever is
+    // replaced while frames are in flight waits in the deletion queue.
+    bool mHasTimelineSemaphore{false};
+    FrameScheduler mFrameScheduler;
+    DeletionQueue mDeletionQueue;
+
+    Settings mSettings;
+    double mStartupSeconds{0.0};
     std::size_t mCurrentFrame{0};
+    std::chrono::steady_clock::time_point mNextFrameTime;
     bool mFramebufferResized{false};
 
     vk::UniqueBuffer mVertexBuffer;
-    vk::UniqueDeviceMemory mVertexBufferMemory;
+    Allocation mVertexBufferMemory;
+
+    vk::UniqueBuffer mMeshletBuffer;
+    Allocation mMeshletBufferMemory;
+    vk::UniqueBuffer mLodBuffer;
+    Allocation mLodBufferMemory;
+
+    vk::UniqueBuffer mInstanceBuffer;
+    Allocation mInstanceBufferMemory;
+    std::uint32_t mInstanceCount{1};
+    std::size_t mInstanceFrames{0};
+    double mInstanceTime{0.0};
 
     vk::UniqueBuffer mIndexBuffer;
-    vk::UniqueDeviceMemory mIndexBufferMemory;
+    Allocation mIndexBufferMemory;
 
-    std::vector<vk::UniqueBuffer> mUniformBuffers;
-    std::vector<vk::UniqueDeviceMemory> mUniformBuffersMemory;
+    vk::UniqueBuffer mUniformBuffer;
+    Allocation mUniformBufferMemory;
+    vk::DeviceSize mUniformSliceSize{0};
+    UniformMatrices mUniforms;
+    glm::mat4 mModelMatrix{1.0f};
 
     vk::UniqueDescriptorPool mDescriptorPool;
-    std::vector<vk::UniqueDescriptorSet> mDescriptorSets;
-
+    vk::UniqueDescriptorSet mDescriptorSet;
+    vk::UniqueDescriptorSet mCullDescriptorSet;
+
+    vk::UniqueBuffer mDrawCommandBuffer;
+    Allocation mDrawCommandBufferMemory;
+    vk::DeviceSize mDrawCommandSliceSize{0};
+    std::uint32_t mDrawCommandCapacity{0};
+    vk::UniqueBuffer mDrawCountBuffer;
+    Allocation mDrawCountBufferMemory;
+    vk::DeviceSize mDrawCountSliceSize{0};
+
+    TextureData mTextureData;
     vk::UniqueImage mTextureImage;
-    vk::UniqueDeviceMemory mTextureImageMemory;
+    Allocation mTextureImageMemory;
+    vk::Format mTextureFormat{vk::Format::eR8G8B8A8Unorm};
 
     vk::UniqueImageView mTextureImageView;
     vk::UniqueSampler mTextureSampler;
 
-    vk::UniqueImage mDepthImage;
-    vk::UniqueDeviceMemory mDepthImageMemory;
-    vk::UniqueImageView mDepthImageView;
+    // Every texture goes into one array of sampled images. With descriptor
+    // indexing the array can be partially bound and written while in use,
+    // otherwise every slot starts out as the mesh texture.
+    bool mBindlessTextures{false};
+    std::uint32_t mTextureCapacity{1};
+    std::uint32_t mTextureCount{0};
+    std::uint32_t mMeshTextureIndex{0};
+
+    // With streaming the mesh texture is drawn from whichever of its two
+    // slots was written last, see TextureStreamer.
+    bool mTextureStreaming{false};
+    bool mHasMemoryBudget{false};
+    TextureStreamer mTextureStreamer;
+    std::array<std::uint32_t, 2> mMeshTextureSlots{};
 
     std::vector<Vertex> mVertices;
     std::vector<std::uint32_t> mIndices;
+    MeshCache mMeshCache;
+    MeshData mMesh;
+    std::vector<Meshlet> mMeshlets;
+    std::vector<MeshLod> mMeshLods;
+    float mLodScale{0.0f};
+    std::vector<DrawItem> mDrawItems;
+    std::vector<DrawItem> mVisibleDraws;
+    glm::vec4 mBoundingSphere{0.0f};
+    glm::vec3 mMeshMinimum{0.0f};
+    glm::vec3 mMeshMaximum{0.0f};
 
     std::uint32_t mMipLevels;
 
     vk::SampleCountFlagBits mMSAASamples{vk::SampleCountFlagBits::e1};
-    vk::UniqueImage mColourImage;
-    vk::UniqueDeviceMemory mColourImageMemory;
-    vk::UniqueImageView mColourImageView;
 };
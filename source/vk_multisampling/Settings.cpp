@@ -0,0 +1,202 @@
+#include "Settings.hpp"
+
+#include <array>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace globals
+{
+    static constexpr std::uint32_t maxFramesInFlight{4};
+
+    static constexpr std::array<std::pair<std::string_view, vk::PresentModeKHR>,
+                                4>
+        presentModes{{{"immediate", vk::PresentModeKHR::eImmediate},
+                      {"mailbox", vk::PresentModeKHR::eMailbox},
+                      {"fifo", vk::PresentModeKHR::eFifo},
+                      {"fifo-relaxed", vk::PresentModeKHR::eFifoRelaxed}}};
+
+    static constexpr std::array<std::pair<std::string_view, MipmapMode>, 3>
+        mipmapModes{{{"auto", MipmapMode::eAuto},
+                     {"blit", MipmapMode::eBlit},
+                     {"compute", MipmapMode::eCompute}}};
+} // namespace globals
+
+static vk::PresentModeKHR parsePresentMode(std::string_view value)
+{
+    for (auto const& [name, mode] : globals::presentModes)
+    {
+        if (name == value)
+        {
+            return mode;
+        }
+    }
+
+    throw std::runtime_error{"error: unknown present mode \"" +
+                             std::string{value} + "\"."};
+}
+
+static MipmapMode parseMipmapMode(std::string_view value)
+{
+    for (auto const& [name, mode] : globals::mipmapModes)
+    {
+        if (name == value)
+        {
+            return mode;
+        }
+    }
+
+    throw std::runtime_error{"error: unknown mipmap mode \"" +
+                             std::string{value} + "\"."};
+}
+
+static double parseNumber(std::string_view option, std::string_view value)
+{
+    try
+    {
+        std::size_t end{0};
+        std::string text{value};
+        double number = std::stod(text, &end);
+        if (end == text.size())
+        {
+            return number;
+        }
+    }
+    catch (std::exception const&)
+    {}
+
+    throw std::runtime_error{"error: invalid value for " +
+                             std::string{option} + "."};
+}
+
+Settings parseSettings(int argc, char** argv)
+{
+    Settings settings;
+    for (int i{1}; i < argc; ++i)
+    {
+        std::string_view argument{argv[i]};
+        auto split  = argument.find('=');
+        auto option = argument.substr(0, split);
+        auto value  = split == std::string_view::npos
+                         ? std::string_view{}
+                         : argument.substr(split + 1);
+
+        if (option == "--present-mode")
+        {
+            settings.presentMode            = parsePresentMode(value);
+            settings.isPresentModeRequested = true;
+        }
+        else if (option == "--frames-in-flight")
+        {
+            double frames = parseNumber(option, value);
+            if (frames < 1 || frames > globals::maxFramesInFlight ||
+                frames != static_cast<std::uint32_t>(frames))
+            {
+                throw std::runtime_error{
+                    "error: frames in flight must be between 1 and 4."};
+            }
+            settings.framesInFlight = static_cast<std::uint32_t>(frames);
+        }
+        else if (option == "--samples")
+        {
+            // Anything out of range can't be cast, so that is checked first.
+            double samples = parseNumber(option, value);
+            bool isInRange = samples >= 1 && samples <= 64;
+            auto count = isInRange ? static_cast<std::uint32_t>(samples) : 0;
+            if (!isInRange || samples != count || (count & (count - 1)) != 0)
+            {
+                throw std::runtime_error{
+                    "error: samples must be a power of two up to 64."};
+            }
+            settings.sampleCount = count;
+        }
+        else if (option == "--frame-limit")
+        {
+            settings.frameLimit = parseNumber(option, value);
+            if (settings.frameLimit < 0.0)
+            {
+                throw std::runtime_error{
+                    "error: frame limit cannot be negative."};
+            }
+        }
+        else if (option == "--cpu-stats")
+        {
+            if (value.empty())
+            {
+                throw std::runtime_error{
+                    "error: --cpu-stats needs a file name."};
+            }
+            settings.cpuStatsFile = std::string{value};
+        }
+        else if (option == "--mipmaps")
+        {
+            settings.mipmapMode = parseMipmapMode(value);
+        }
+        else if (option == "--no-texture")
+        {
+            settings.texture = false;
+        }
+        else if (option == "--no-depth-prepass")
+        {
+            settings.depthPrepass = false;
+        }
+        else if (option == "--no-culling")
+        {
+            settings.gpuCulling = false;
+        }
+        else if (option == "--instances")
+        {
+            double instances = parseNumber(option, value);
+            if (instances < 1 ||
+                instances > std::numeric_limits<std::uint32_t>::max() ||
+                instances != static_cast<std::uint32_t>(instances))
+            {
+                throw std::runtime_error{
+                    "error: instance count must be a positive integer."};
+            }
+            settings.instanceCount = static_cast<std::uint32_t>(instances);
+        }
+        else if (option == "--device")
+        {
+            if (value.empty())
+            {
+                throw std::runtime_error{
+                    "error: --device needs an index or a name."};
+            }
+            settings.device = std::string{value};
+        }
+        else if (option == "--headless")
+        {
+            settings.headless = true;
+        }
+        else if (option == "--frames")
+        {
+            double frames = parseNumber(option, value);
+            if (frames < 1 ||
+                frames > std::numeric_limits<std::uint32_t>::max() ||
+                frames != static_cast<std::uint32_t>(frames))
+            {
+                throw std::runtime_error{
+                    "error: frame count must be a positive integer."};
+            }
+            settings.benchmarkFrames = static_cast<std::uint32_t>(frames);
+        }
+        else if (option == "--report")
+        {
+            if (value.empty())
+            {
+                throw std::runtime_error{"error: --report needs a file name."};
+            }
+            settings.reportFile = std::string{value};
+        }
+        else
+        {
+            throw std::runtime_error{"error: unknown option \"" +
+                                     std::string{argument} + "\"."};
+        }
+    }
+
+    return settings;
+}
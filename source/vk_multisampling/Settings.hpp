@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <string>
+
+// How the texture's mip chain is made. Normally it comes baked into a
+// container from an earlier run, and only gets generated on the GPU (in a
+// compute shader where the format allows) when there is none. Asking for
+// either GPU path skips the containers, so the two can be benchmarked
+// against each other.
+enum class MipmapMode
+{
+    eAuto,
+    eBlit,
+    eCompute,
+};
+
+// Options picked at startup rather than compile time, so the same build can
+// be run for latency or for throughput.
+struct Settings
+{
+    // Used if the surface supports it, otherwise eFifo which always is. Only
+    // falling back from a mode that was asked for is worth a warning.
+    vk::PresentModeKHR presentMode{vk::PresentModeKHR::eMailbox};
+    bool isPresentModeRequested{false};
+    std::uint32_t framesInFlight{2};
+
+    // MSAA samples per pixel, capped to what the device can do. 0 picks a
+    // default that keeps the attachments within a memory budget.
+    std::uint32_t sampleCount{0};
+
+    // Frames per second to cap rendering at, 0 for no limit.
+    double frameLimit{0.0};
+
+    // Where to write the CPU time of every frame as CSV, if anywhere.
+    std::string cpuStatsFile;
+
+    MipmapMode mipmapMode{MipmapMode::eAuto};
+
+    // Parts of the renderer that can be turned off, so that the benchmark
+    // can compare it with simpler versions of itself.
+    bool texture{true};
+    bool depthPrepass{true};
+    bool gpuCulling{true};
+
+    // Copies of the model to draw, capped to what the instance buffer holds.
+    std::uint32_t instanceCount{1};
+
+    // The GPU to render with, by its index or part of its name. Empty picks
+    // the one that rates best.
+    std::string device;
+
+    // Render a fixed number of frames into offscreen images, with no window
+    // or swap chain, then report the timings as JSON. The report goes to
+    // standard output unless a file is given.
+    bool headless{false};
+    std::uint32_t benchmarkFrames{1000};
+    std::string reportFile;
+};
+
+// Reads the settings from the command line:
+//
+//   --present-mode=<immediate|mailbox|fifo|fifo-relaxed>
+//   --frames-in-flight=<1-4>
+//   --samples=<1|2|4|8|16|32|64>
+//   --frame-limit=<frames per second>
+//   --cpu-stats=<csv file>
+//   --mipmaps=<auto|blit|compute>
+//   --no-texture
+//   --no-depth-prepass
+//   --no-culling
+//   --instances=<instance count>
+//   --device=<index|name>
+//   --headless
+//   --frames=<frame count>
+//   --report=<json file>
+//
+// Throws on anything it doesn't recognise.
+Settings parseSettings(int argc, char** argv);
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Layout policies for the vertex buffer. Each one describes how positions and
+// the remaining attributes are stored on the GPU, how to build them from a
+// full precision vertex, and how the vertex shader turns the stored position
+// back into model space (position * positionScale + positionOffset). Only
+// the attributes the shaders read are kept: the position at location 0 and
+// the texture coordinates at location 1.
+
+// Full precision floats, 20 bytes.
+struct FloatVertexLayout
+{
+    using Position   = glm::vec3;
+    using Attributes = glm::vec2;
+
+    static constexpr vk::Format positionFormat{vk::Format::eR32G32B32Sfloat};
+    static constexpr vk::Format attributeFormat{vk::Format::eR32G32Sfloat};
+
+    static Position encodePosition(glm::vec3 const& position,
+                                   glm::vec3 const&,
+                                   glm::vec3 const&)
+    {
+        return position;
+    }
+
+    template<typename T>
+    static Attributes encodeAttributes(T const& vertex)
+    {
+        return vertex.texCoord;
+    }
+
+    static glm::vec4 getPositionScale(glm::vec3 const&, glm::vec3 const&)
+    {
+        return glm::vec4{1.0f};
+    }
+
+    static glm::vec4 getPositionOffset(glm::vec3 const&)
+    {
+        return glm::vec4{0.0f};
+    }
+};
+
+// Positions as 16-bit unsigned normalised values across the mesh bounds, and
+// texture coordinates as half floats, 12 bytes. The fourth position component
+// is padding since three component 16-bit formats are rarely supported for
+// vertex input.
+struct QuantisedVertexLayout
+{
+    struct Position
+    {
+        std::uint16_t components[4];
+    };
+    using Attributes = std::uint32_t;
+
+    static constexpr vk::Format positionFormat{vk::Format::eR16G16B16A16Unorm};
+    static constexpr vk::Format attributeFormat{vk::Format::eR16G16Sfloat};
+
+    static Position encodePosition(glm::vec3 const& position,
+                                   glm::vec3 const& minimum,
+                                   glm::vec3 const& maximum)
+    {
+        glm::vec3 normalised =
+            (position - minimum) / getExtent(minimum, maximum);
+        std::uint64_t packed = glm::packUnorm4x16(glm::vec4{normalised, 0.0f});
+
+        Position result;
+        std::memcpy(result.components, &packed, sizeof(result.components));
+        return result;
+    }
+
+    template<typename T>
+    static Attributes encodeAttributes(T const& vertex)
+    {
+        return glm::packHalf2x16(vertex.texCoord);
+    }
+
+    static glm::vec4 getPositionScale(glm::vec3 const& minimum,
+                                      glm::vec3 const& maximum)
+    {
+        return glm::vec4{getExtent(minimum, maximum), 0.0f};
+    }
+
+    static glm::vec4 getPositionOffset(glm::vec3 const& minimum)
+    {
+        return glm::vec4{minimum, 1.0f};
+    }
+
+private:
+    static glm::vec3 getExtent(glm::vec3 const& minimum,
+                               glm::vec3 const& maximum)
+    {
+        return glm::max(maximum - minimum, glm::vec3{1e-6f});
+    }
+};
+
+// Puts a layout policy together into vertex buffer contents and the matching
+// pipeline state. Interleaved, every vertex is stored whole in binding 0.
+// Split, the buffer holds every position followed by every set of
+// attributes, bound as bindings 0 and 1, so that depth only passes can bind
+// the position stream on its own and fetch nothing else.
+template<typename Layout, bool Split>
+struct VertexFormat
+{
+    using Position   = typename Layout::Position;
+    using Attributes = typename Layout::Attributes;
+
+    struct Interleaved
+    {
+        Position pos;
+        Attributes attributes;
+    };
+
+    static constexpr std::uint32_t bindingCount{Split ? 2u : 1u};
+
+    static std::array<vk::VertexInputBindingDescription, bindingCount>
+    getBindingDescriptions()
+    {
+        std::array<vk::VertexInputBindingDescription, bindingCount>
+            bindingDescriptions;
+        bindingDescriptions[0] = getPositionBindingDescription();
+        if constexpr (Split)
+        {
+            bindingDescriptions[1].binding   = 1;
+            bindingDescriptions[1].stride    = sizeof(Attributes);
+            bindingDescriptions[1].inputRate = vk::VertexInputRate::eVertex;
+        }
+
+        return bindingDescriptions;
+    }
+
+    static std::array<vk::VertexInputAttributeDescription, 2>
+    getAttributeDescriptions()
+    {
+        std::array<vk::VertexInputAttributeDescription, 2>
+            attributeDescriptions;
+        attributeDescriptions[0] = getPositionAttributeDescription();
+
+        attributeDescriptions[1].binding  = Split ? 1 : 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format   = Layout::attributeFormat;
+        attributeDescriptions[1].offset =
+            Split ? 0 : offsetof(Interleaved, attributes);
+
+        return attributeDescriptions;
+    }
+
+    // Just the position, for depth only pipelines.
+    static vk::VertexInputBindingDescription getPositionBindingDescription()
+    {
+        vk::VertexInputBindingDescription bindingDescription;
+        bindingDescription.binding   = 0;
+        bindingDescription.stride    = Split ? sizeof(Position)
+                                             : sizeof(Interleaved);
+        bindingDescription.inputRate = vk::VertexInputRate::eVertex;
+
+        return bindingDescription;
+    }
+
+    static vk::VertexInputAttributeDescription
+    getPositionAttributeDescription()
+    {
+        vk::VertexInputAttributeDescription attributeDescription;
+        attributeDescription.binding  = 0;
+        attributeDescription.location = 0;
+        attributeDescription.format   = Layout::positionFormat;
+        attributeDescription.offset   = offsetof(Interleaved, pos);
+
+        return attributeDescription;
+    }
+
+    // Where each binding starts within the buffer built by encode.
+    static std::array<vk::DeviceSize, bindingCount>
+    getBindingOffsets(std::size_t count)
+    {
+        std::array<vk::DeviceSize, bindingCount> offsets{};
+        if constexpr (Split)
+        {
+            offsets[1] = sizeof(Position) * count;
+        }
+
+        return offsets;
+    }
+
+    template<typename T>
+    static std::vector<std::uint8_t> encode(T const* vertices,
+                                            std::size_t count,
+                                            glm::vec3 const& minimum,
+                                            glm::vec3 const& maximum)
+    {
+        std::vector<std::uint8_t> result;
+        if constexpr (Split)
+        {
+            result.resize((sizeof(Position) + sizeof(Attributes)) * count);
+            auto positions  = reinterpret_cast<Position*>(result.data());
+            auto attributes = reinterpret_cast<Attributes*>(
+                result.data() + sizeof(Position) * count);
+            for (std::size_t i{0}; i < count; ++i)
+            {
+                positions[i] =
+                    Layout::encodePosition(vertices[i].pos, minimum, maximum);
+                attributes[i] = Layout::encodeAttributes(vertices[i]);
+            }
+        }
+        else
+        {
+            result.resize(sizeof(Interleaved) * count);
+            auto interleaved = reinterpret_cast<Interleaved*>(result.data());
+            for (std::size_t i{0}; i < count; ++i)
+            {
+                interleaved[i].pos =
+                    Layout::encodePosition(vertices[i].pos, minimum, maximum);
+                interleaved[i].attributes =
+                    Layout::encodeAttributes(vertices[i]);
+            }
+        }
+
+        return result;
+    }
+
+    static glm::vec4 getPositionScale(glm::vec3 const& minimum,
+                                      glm::vec3 const& maximum)
+    {
+        return Layout::getPositionScale(minimum, maximum);
+    }
+
+    static glm::vec4 getPositionOffset(glm::vec3 const& minimum)
+    {
+        return Layout::getPositionOffset(minimum);
+    }
+};
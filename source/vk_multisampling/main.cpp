@@ -3,11 +3,11 @@
 #include <fmt/printf.h>
 #include <stdexcept>
 
-int main()
+int main(int argc, char** argv)
 {
-    Application app;
     try
     {
+        Application app{parseSettings(argc, argv)};
         app.run();
     }
     catch (std::exception const& e)
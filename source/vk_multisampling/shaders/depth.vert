@@ -0,0 +1,30 @@
+#version 450 core
+#extension GL_ARB_separate_shader_objects: enable
+
+// Depth prepass. This has to compute exactly the same position as
+// triangle.vert for the eEqual test in the main pass to work, hence the
+// invariant qualifier in both.
+layout (location = 0) in vec3 position;
+layout (location = 2) in mat4 instanceModel;
+
+invariant gl_Position;
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 viewProjection;
+    vec4 frustumPlanes[6];
+    vec4 cameraPosition;
+    vec4 positionScale;
+    vec4 positionOffset;
+} ubo;
+
+layout(push_constant) uniform DrawPushConstants {
+    mat4 model;
+} draw;
+
+void main()
+{
+    vec3 modelPosition = position * ubo.positionScale.xyz +
+        ubo.positionOffset.xyz;
+    gl_Position = ubo.viewProjection * instanceModel * draw.model *
+        vec4(modelPosition, 1.0);
+}
@@ -1,14 +1,33 @@
 #version 450 core
 #extension GL_ARB_separate_shader_objects: enable
 
-layout (location = 0) in vec3 vertColour;
-layout (location = 1) in vec2 vertTexCoord;
+layout (location = 0) in vec2 vertTexCoord;
 
 layout (location = 0) out vec4 fragColour;
 
-layout (binding = 1) uniform sampler2D texSampler;
+// Sized at pipeline creation to whatever the device allows.
+layout (constant_id = 0) const uint textureCount = 1;
+
+// Set per pipeline variant, see ShaderFeature. Without the texture the mesh
+// is drawn in the white its vertex colours used to be.
+layout (constant_id = 1) const bool textured = true;
+
+layout (binding = 1) uniform sampler textureSampler;
+layout (binding = 2) uniform texture2D textures[textureCount];
+
+// The index is the same for the whole draw, so it needs no nonuniformEXT.
+layout (push_constant) uniform DrawPushConstants {
+    layout (offset = 64) uint textureIndex;
+} draw;
 
 void main()
 {
-    fragColour = texture(texSampler, vertTexCoord);
+    if (!textured)
+    {
+        fragColour = vec4(1.0);
+        return;
+    }
+
+    fragColour = texture(
+        sampler2D(textures[draw.textureIndex], textureSampler), vertTexCoord);
 }
@@ -1,24 +1,37 @@
 #version 450 core
 #extension GL_ARB_separate_shader_objects: enable
 
+// Whatever the vertex layout stores, position comes in as a vec3 that
+// positionScale and positionOffset map back into model space.
 layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 colour;
-layout (location = 2) in vec2 texCoord;
+layout (location = 1) in vec2 texCoord;
+layout (location = 2) in mat4 instanceModel;
 
-layout (location = 0) out vec3 vertColour;
-layout (location = 1) out vec2 vertTexCoord;
+layout (location = 0) out vec2 vertTexCoord;
+
+// Untextured variants have no use for the texture coordinates.
+layout (constant_id = 1) const bool textured = true;
+
+// Must match depth.vert bit for bit, see there.
+invariant gl_Position;
 
 layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
-    mat4 view;
-    mat4 proj;
+    mat4 viewProjection;
+    vec4 frustumPlanes[6];
+    vec4 cameraPosition;
+    vec4 positionScale;
+    vec4 positionOffset;
 } ubo;
 
+layout(push_constant) uniform DrawPushConstants {
+    mat4 model;
+} draw;
+
 void main()
 {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(position, 1.0);
-    vertColour = colour;
-    vertTexCoord = texCoord;
+    vec3 modelPosition = position * ubo.positionScale.xyz +
+        ubo.positionOffset.xyz;
+    gl_Position = ubo.viewProjection * instanceModel * draw.model *
+        vec4(modelPosition, 1.0);
+    vertTexCoord = textured ? texCoord : vec2(0.0);
 }
-
-
@@ -9,6 +9,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "VulkanHelpers.hpp"
+
 #include <algorithm>
 #include <chrono>
 #include <functional>
@@ -25,12 +27,7 @@ struct QueueFamilyIndices
     }
 };
 
-struct SwapChainSupportDetails
-{
-    vk::SurfaceCapabilitiesKHR capabilities;
-    std::vector<vk::SurfaceFormatKHR> formats;
-    std::vector<vk::PresentModeKHR> presentModes;
-};
+using SwapChainSupportDetails = core::SwapChainSupportDetails;
 
 struct Vertex
 {
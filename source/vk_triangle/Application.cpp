@@ -1,5 +1,6 @@
 #include "Application.hpp"
 #include "Paths.hpp"
+#include "VulkanHelpers.hpp"
 
 #include <algorithm>
 #include <array>
@@ -75,25 +76,6 @@ VKAPI_ATTR void VKAPI_CALL vkDestroyDebugUtilsMessengerEXT(
                                                        pAllocator);
 }
 
-static std::vector<char> readFile(std::string const& filename)
-{
-    std::ifstream file{filename, std::ios::ate | std::ios::binary};
-
-    if (!file.is_open())
-    {
-        std::string message =
-            fmt::format("error: unable to open file {}.", filename);
-        throw std::runtime_error{message};
-    }
-
-    std::size_t fileSize = static_cast<std::size_t>(file.tellg());
-    std::vector<char> buffer(fileSize);
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    file.close();
-    return buffer;
-}
-
 static void onFramebufferResize(GLFWwindow* window, [[maybe_unused]] int width,
                                 [[maybe_unused]] int height)
 {
@@ -827,8 +809,8 @@ void Application::createImageViews()
 void Application::createGraphicsPipeline()
 {
     std::string root{ShaderPath};
-    auto vertexShaderCode   = readFile(root + "triangle.vert.spv");
-    auto fragmentShaderCode = readFile(root + "triangle.frag.spv");
+    auto vertexShaderCode   = core::readFile(root + "triangle.vert.spv");
+    auto fragmentShaderCode = core::readFile(root + "triangle.frag.spv");
 
     vk::UniqueShaderModule vertModule = createShaderModule(vertexShaderCode);
     vk::UniqueShaderModule fragModule = createShaderModule(fragmentShaderCode);
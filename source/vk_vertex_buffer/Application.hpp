@@ -5,6 +5,8 @@
 
 #include <vulkan/vulkan.hpp>
 
+#include "VulkanHelpers.hpp"
+
 #include <algorithm>
 #include <functional>
 #include <glm/glm.hpp>
@@ -21,12 +23,7 @@ struct QueueFamilyIndices
     }
 };
 
-struct SwapChainSupportDetails
-{
-    vk::SurfaceCapabilitiesKHR capabilities;
-    std::vector<vk::SurfaceFormatKHR> formats;
-    std::vector<vk::PresentModeKHR> presentModes;
-};
+using SwapChainSupportDetails = core::SwapChainSupportDetails;
 
 struct Vertex
 {
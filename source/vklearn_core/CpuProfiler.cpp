@@ -0,0 +1,212 @@
+#include "CpuProfiler.hpp"
+
+#include <fmt/printf.h>
+
+#include <algorithm>
+#include <fstream>
+
+namespace globals
+{
+    static constexpr std::array<char const*, 6> stageNames{
+        "waitForFence",
+        "acquireImage",
+        "updateUniforms",
+        "recordCommands",
+        "submit",
+        "present"};
+} // namespace globals
+
+static_assert(globals::stageNames.size() ==
+                  static_cast<std::size_t>(CpuStage::count),
+              "every CPU stage needs a name");
+
+static double percentile(std::vector<double>& values, double fraction)
+{
+    // Nearest rank, which is exact enough for windows of hundreds of frames.
+    auto rank = static_cast<std::size_t>(fraction * (values.size() - 1) + 0.5);
+    std::nth_element(values.begin(), values.begin() + rank, values.end());
+    return values[rank];
+}
+
+CpuProfiler::Scope::Scope(CpuProfiler& profiler, CpuStage stage) :
+    mProfiler{profiler},
+    mStage{stage},
+    mStart{Clock::now()}
+{}
+
+CpuProfiler::Scope::~Scope()
+{
+    std::chrono::duration<double, std::milli> elapsed = Clock::now() - mStart;
+    mProfiler.addTime(mStage, elapsed.count());
+}
+
+void CpuProfiler::init(std::size_t windowSize, bool keepSamples)
+{
+    mWindowSize  = windowSize;
+    mKeepSamples = keepSamples;
+    mWindow.reserve(windowSize);
+}
+
+CpuProfiler::Scope CpuProfiler::scope(CpuStage stage)
+{
+    return Scope{*this, stage};
+}
+
+void CpuProfiler::addTime(CpuStage stage, double milliseconds)
+{
+    mCurrent[static_cast<std::size_t>(stage)] += milliseconds;
+}
+
+bool CpuProfiler::endFrame()
+{
+    // Frame time is measured between consecutive calls, so it includes
+    // everything the loop does and not just the instrumented stages.
+    auto now = Clock::now();
+    if (!mHasFrameStart)
+    {
+        mFrameStart    = now;
+        mHasFrameStart = true;
+        mCurrent       = {};
+        return false;
+    }
+
+    std::chrono::duration<double, std::milli> frameTime = now - mFrameStart;
+    mFrameStart = now;
+
+    FrameSample sample{frameTime.count(), mCurrent};
+    mCurrent = {};
+    mWindow.push_back(sample);
+    if (mKeepSamples)
+    {
+        mSamples.push_back(sample);
+    }
+
+    if (mWindow.size() < mWindowSize)
+    {
+        return false;
+    }
+
+    summarise();
+    mWindow.clear();
+    return true;
+}
+
+void CpuProfiler::printSummary() const
+{
+    if (mSummarisedFrames == 0)
+    {
+        return;
+    }
+
+    fmt::print("frame time over {} frames: p50 {:.3f} ms, p95 {:.3f} ms, "
+               "p99 {:.3f} ms\n",
+               mSummarisedFrames,
+               mFrameSummary.p50,
+               mFrameSummary.p95,
+               mFrameSummary.p99);
+    for (std::size_t i{0}; i < stageCount; ++i)
+    {
+        auto const& summary = mStageSummaries[i];
+        fmt::print("  {:<16} p50 {:7.3f} ms, p95 {:7.3f} ms, p99 {:7.3f} ms\n",
+                   globals::stageNames[i],
+                   summary.p50,
+                   summary.p95,
+                   summary.p99);
+    }
+
+    // One row per millisecond, with the last one collecting everything
+    // slower. Empty rows at either end are left out.
+    auto first = std::find_if(mHistogram.begin(),
+                              mHistogram.end(),
+                              [](std::size_t count) { return count != 0; });
+    auto last  = std::find_if(mHistogram.rbegin(),
+                             mHistogram.rend(),
+                             [](std::size_t count) { return count != 0; })
+                    .base();
+    auto largest = *std::max_element(mHistogram.begin(), mHistogram.end());
+    for (auto bucket = first; bucket < last; ++bucket)
+    {
+        auto index  = static_cast<std::size_t>(bucket - mHistogram.begin());
+        auto length = (*bucket * 50 + largest - 1) / largest;
+        fmt::print("  {:>3}{} ms | {:<50} {}\n",
+                   static_cast<std::size_t>(index * histogramBucket),
+                   index + 1 == histogramBuckets ? "+" : " ",
+                   std::string(length, '#'),
+                   *bucket);
+    }
+}
+
+bool CpuProfiler::writeCsv(std::string const& filename) const
+{
+    std::ofstream file{filename, std::ios::trunc};
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    file << "frame,frameTime";
+    for (auto name : globals::stageNames)
+    {
+        file << ',' << name;
+    }
+    file << '\n';
+
+    for (std::size_t i{0}; i < mSamples.size(); ++i)
+    {
+        file << fmt::format("{},{:.4f}", i, mSamples[i].frameTime);
+        for (auto time : mSamples[i].stages)
+        {
+            file << fmt::format(",{:.4f}", time);
+        }
+        file << '\n';
+    }
+
+    return file.good();
+}
+
+CpuProfiler::Summary CpuProfiler::getFrameSummary() const
+{
+    return mFrameSummary;
+}
+
+CpuProfiler::Summary CpuProfiler::getStageSummary(CpuStage stage) const
+{
+    return mStageSummaries[static_cast<std::size_t>(stage)];
+}
+
+char const* CpuProfiler::getStageName(CpuStage stage)
+{
+    return globals::stageNames[static_cast<std::size_t>(stage)];
+}
+
+void CpuProfiler::summarise()
+{
+    std::vector<double> values(mWindow.size());
+    auto summarise = [&]() {
+        Summary summary;
+        summary.p50 = percentile(values, 0.50);
+        summary.p95 = percentile(values, 0.95);
+        summary.p99 = percentile(values, 0.99);
+        return summary;
+    };
+
+    mHistogram = {};
+    for (std::size_t i{0}; i < mWindow.size(); ++i)
+    {
+        values[i]   = mWindow[i].frameTime;
+        auto bucket = static_cast<std::size_t>(values[i] / histogramBucket);
+        ++mHistogram[std::min(bucket, histogramBuckets - 1)];
+    }
+    mFrameSummary = summarise();
+
+    for (std::size_t stage{0}; stage < stageCount; ++stage)
+    {
+        for (std::size_t i{0}; i < mWindow.size(); ++i)
+        {
+            values[i] = mWindow[i].stages[stage];
+        }
+        mStageSummaries[stage] = summarise();
+    }
+
+    mSummarisedFrames = mWindow.size();
+}
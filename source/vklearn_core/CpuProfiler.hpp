@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The parts of a frame that run on the CPU, in the order they happen.
+enum class CpuStage : std::size_t
+{
+    waitForFence,
+    acquireImage,
+    updateUniforms,
+    recordCommands,
+    submit,
+    present,
+    count
+};
+
+// Collects how long every stage of every frame took. Statistics are taken
+// over windows of frames: each window is summarised as percentiles of the
+// frame and stage times plus a histogram of the frame times. The raw samples
+// can also be kept for writing out as CSV.
+class CpuProfiler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Summary
+    {
+        double p50;
+        double p95;
+        double p99;
+    };
+
+    // Adds the time between construction and destruction to a stage of the
+    // current frame.
+    class Scope
+    {
+    public:
+        Scope(CpuProfiler& profiler, CpuStage stage);
+        ~Scope();
+
+        Scope(Scope const&) = delete;
+        Scope& operator=(Scope const&) = delete;
+
+    private:
+        CpuProfiler& mProfiler;
+        CpuStage mStage;
+        Clock::time_point mStart;
+    };
+
+    void init(std::size_t windowSize, bool keepSamples);
+
+    Scope scope(CpuStage stage);
+    void addTime(CpuStage stage, double milliseconds);
+
+    // Closes the current frame. Returns true when that completes a window,
+    // which is when printSummary has something new to show.
+    bool endFrame();
+    void printSummary() const;
+    bool writeCsv(std::string const& filename) const;
+
+    // The statistics of the last complete window.
+    Summary getFrameSummary() const;
+    Summary getStageSummary(CpuStage stage) const;
+    static char const* getStageName(CpuStage stage);
+
+private:
+    static constexpr std::size_t stageCount{
+        static_cast<std::size_t>(CpuStage::count)};
+    static constexpr double histogramBucket{1.0};
+    static constexpr std::size_t histogramBuckets{34};
+
+    struct FrameSample
+    {
+        double frameTime;
+        std::array<double, stageCount> stages;
+    };
+
+    void summarise();
+
+    std::size_t mWindowSize{0};
+    bool mKeepSamples{false};
+
+    Clock::time_point mFrameStart;
+    bool mHasFrameStart{false};
+    std::array<double, stageCount> mCurrent{};
+
+    std::vector<FrameSample> mWindow;
+    std::vector<FrameSample> mSamples;
+
+    Summary mFrameSummary{};
+    std::array<Summary, stageCount> mStageSummaries{};
+    std::array<std::size_t, histogramBuckets> mHistogram{};
+    std::size_t mSummarisedFrames{0};
+};
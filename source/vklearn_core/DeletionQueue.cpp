@@ -0,0 +1,51 @@
+#include "DeletionQueue.hpp"
+
+void DeletionQueue::init(FrameScheduler& scheduler, MemoryAllocator& allocator)
+{
+    mScheduler = &scheduler;
+    mAllocator = &allocator;
+}
+
+void DeletionQueue::retire(Allocation const& allocation, std::uint64_t value)
+{
+    if (!allocation.memory)
+    {
+        return;
+    }
+
+    auto allocator = mAllocator;
+    push(value, [allocator, allocation]() mutable {
+        allocator->free(allocation);
+    });
+}
+
+void DeletionQueue::retire(Allocation const& allocation)
+{
+    retire(allocation, mScheduler->getSubmittedValue());
+}
+
+void DeletionQueue::collect()
+{
+    // A single query covers the whole queue, values only get checked
+    // against the scheduler's answer.
+    auto completed = mScheduler->getCompletedValue();
+    while (!mRetired.empty() && mRetired.front().value <= completed)
+    {
+        mRetired.front().destroy();
+        mRetired.pop_front();
+    }
+}
+
+void DeletionQueue::flush()
+{
+    for (auto& retired : mRetired)
+    {
+        retired.destroy();
+    }
+    mRetired.clear();
+}
+
+void DeletionQueue::push(std::uint64_t value, std::function<void()> destroy)
+{
+    mRetired.push_back({value, std::move(destroy)});
+}
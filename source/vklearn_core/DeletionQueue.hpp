@@ -0,0 +1,63 @@
+#pragma once
+
+#include "FrameScheduler.hpp"
+#include "MemoryAllocator.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+// Destroys objects once the GPU is done with them, rather than waiting for
+// the whole device to go idle first. Everything is retired with the
+// scheduler value of its last use, by default whatever has been submitted
+// so far, and destroyed by the first collect that finds the scheduler past
+// it. Anything retired out of order is simply destroyed a little later.
+class DeletionQueue
+{
+public:
+    void init(FrameScheduler& scheduler, MemoryAllocator& allocator);
+
+    // Anything held by a unique handle the device owns.
+    template<typename Handle>
+    void retire(Handle handle, std::uint64_t value)
+    {
+        if (!handle)
+        {
+            return;
+        }
+
+        auto owner  = handle.getOwner();
+        auto object = handle.release();
+        push(value, [owner, object]() { owner.destroy(object); });
+    }
+
+    template<typename Handle>
+    void retire(Handle handle)
+    {
+        retire(std::move(handle), mScheduler->getSubmittedValue());
+    }
+
+    void retire(Allocation const& allocation, std::uint64_t value);
+    void retire(Allocation const& allocation);
+
+    // Destroys everything the GPU is done with. Once per frame is enough.
+    void collect();
+
+    // Destroys everything that is left, so the device must be idle.
+    void flush();
+
+private:
+    struct Retired
+    {
+        std::uint64_t value;
+        std::function<void()> destroy;
+    };
+
+    void push(std::uint64_t value, std::function<void()> destroy);
+
+    FrameScheduler* mScheduler{nullptr};
+    MemoryAllocator* mAllocator{nullptr};
+    std::deque<Retired> mRetired;
+};
@@ -0,0 +1,295 @@
+#include "FrameScheduler.hpp"
+#include "DeletionQueue.hpp"
+
+#include <limits>
+#include <stdexcept>
+
+void FrameScheduler::init(vk::Device const& device,
+                          vk::Queue const& queue,
+                          bool hasTimeline,
+                          std::uint32_t framesInFlight)
+{
+    mDevice      = device;
+    mQueue       = queue;
+    mHasTimeline = hasTimeline;
+
+    if (mHasTimeline)
+    {
+        mGetCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+            mDevice.getProcAddr("vkGetSemaphoreCounterValueKHR"));
+        mWaitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(
+            mDevice.getProcAddr("vkWaitSemaphoresKHR"));
+        mHasTimeline = mGetCounterValue && mWaitSemaphores;
+    }
+
+    if (mHasTimeline)
+    {
+        vk::SemaphoreTypeCreateInfoKHR typeInfo;
+        typeInfo.semaphoreType = vk::SemaphoreTypeKHR::eTimeline;
+        typeInfo.initialValue  = 0;
+
+        vk::SemaphoreCreateInfo semaphoreInfo;
+        semaphoreInfo.pNext = &typeInfo;
+        mTimeline           = mDevice.createSemaphoreUnique(semaphoreInfo);
+    }
+
+    mFrameValues.assign(framesInFlight, 0);
+    mAcquireSemaphores.resize(framesInFlight);
+    for (auto& semaphore : mAcquireSemaphores)
+    {
+        semaphore = mDevice.createSemaphoreUnique({});
+    }
+}
+
+void FrameScheduler::setImageCount(std::uint32_t imageCount,
+                                   DeletionQueue& deletionQueue)
+{
+    // The new images have never been rendered to, so there is nothing to
+    // wait for before the first use of each.
+    mImageValues.assign(imageCount, 0);
+    for (auto& semaphore : mPresentSemaphores)
+    {
+        deletionQueue.retire(std::move(semaphore));
+    }
+    mPresentSemaphores.clear();
+    mPresentSemaphores.resize(imageCount);
+    for (auto& semaphore : mPresentSemaphores)
+    {
+        semaphore = mDevice.createSemaphoreUnique({});
+    }
+}
+
+std::uint32_t FrameScheduler::beginFrame()
+{
+    wait(mFrameValues[mFrame]);
+    return mFrame;
+}
+
+std::uint32_t FrameScheduler::getFrame() const
+{
+    return mFrame;
+}
+
+vk::Semaphore FrameScheduler::getAcquireSemaphore() const
+{
+    return *mAcquireSemaphores[mFrame];
+}
+
+void FrameScheduler::useImage(std::uint32_t imageIndex)
+{
+    wait(mImageValues[imageIndex]);
+}
+
+vk::Semaphore
+FrameScheduler::getPresentSemaphore(std::uint32_t imageIndex) const
+{
+    return *mPresentSemaphores[imageIndex];
+}
+
+std::uint64_t
+FrameScheduler::submitFrame(vk::CommandBuffer const& commandBuffer,
+                            std::uint32_t imageIndex,
+                            bool present)
+{
+    // Without presenting there is no one to wait on the semaphores, nor
+    // anything for them to wait on.
+    std::vector<SemaphoreWait> waits;
+    vk::Semaphore signal;
+    if (present)
+    {
+        waits.push_back({*mAcquireSemaphores[mFrame],
+                         0,
+                         vk::PipelineStageFlagBits::eColorAttachmentOutput});
+        signal = *mPresentSemaphores[imageIndex];
+    }
+
+    auto value               = submitCommands(commandBuffer, waits, signal);
+    mFrameValues[mFrame]     = value;
+    mImageValues[imageIndex] = value;
+    mFrame = (mFrame + 1) % static_cast<std::uint32_t>(mFrameValues.size());
+    return value;
+}
+
+std::uint64_t FrameScheduler::submit(vk::CommandBuffer const& commandBuffer,
+                                     std::vector<SemaphoreWait> const& waits)
+{
+    return submitCommands(commandBuffer, waits, {});
+}
+
+std::uint64_t FrameScheduler::getNextValue() const
+{
+    return mSubmittedValue + 1;
+}
+
+std::uint64_t FrameScheduler::getSubmittedValue() const
+{
+    return mSubmittedValue;
+}
+
+std::uint64_t FrameScheduler::getCompletedValue()
+{
+    if (mHasTimeline)
+    {
+        std::uint64_t value{0};
+        if (mGetCounterValue(static_cast<VkDevice>(mDevice),
+                             static_cast<VkSemaphore>(*mTimeline),
+                             &value) != VK_SUCCESS)
+        {
+            throw std::runtime_error{
+                "error: unable to read the timeline semaphore."};
+        }
+
+        mCompletedValue = value;
+        return mCompletedValue;
+    }
+
+    while (!mPendingFences.empty() &&
+           mDevice.getFenceStatus(*mPendingFences.front().fence) ==
+               vk::Result::eSuccess)
+    {
+        retireFence();
+    }
+
+    return mCompletedValue;
+}
+
+bool FrameScheduler::isComplete(std::uint64_t value)
+{
+    return value <= mCompletedValue || value <= getCompletedValue();
+}
+
+void FrameScheduler::wait(std::uint64_t value)
+{
+    if (isComplete(value))
+    {
+        return;
+    }
+
+    if (value > mSubmittedValue)
+    {
+        throw std::runtime_error{
+            "error: waiting for a value that was never submitted."};
+    }
+
+    if (!mHasTimeline)
+    {
+        while (mCompletedValue < value)
+        {
+            mDevice.waitForFences({*mPendingFences.front().fence},
+                                  VK_TRUE,
+                                  std::numeric_limits<std::uint64_t>::max());
+            retireFence();
+        }
+
+        return;
+    }
+
+    VkSemaphore semaphore = *mTimeline;
+
+    VkSemaphoreWaitInfoKHR waitInfo{};
+    waitInfo.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores    = &semaphore;
+    waitInfo.pValues        = &value;
+    if (mWaitSemaphores(static_cast<VkDevice>(mDevice),
+                        &waitInfo,
+                        std::numeric_limits<std::uint64_t>::max()) !=
+        VK_SUCCESS)
+    {
+        throw std::runtime_error{
+            "error: unable to wait on the timeline semaphore."};
+    }
+
+    mCompletedValue = value;
+}
+
+bool FrameScheduler::hasTimeline() const
+{
+    return mHasTimeline;
+}
+
+std::uint64_t
+FrameScheduler::submitCommands(vk::CommandBuffer const& commandBuffer,
+                               std::vector<SemaphoreWait> const& waits,
+                               vk::Semaphore const& signal)
+{
+    std::vector<vk::Semaphore> waitSemaphores;
+    std::vector<vk::PipelineStageFlags> waitStages;
+    std::vector<std::uint64_t> waitValues;
+    for (auto const& wait : waits)
+    {
+        waitSemaphores.push_back(wait.semaphore);
+        waitStages.push_back(wait.stage);
+        waitValues.push_back(wait.value);
+    }
+
+    // Binary semaphores ignore their value, but every signal needs one as
+    // soon as there is a timeline in the batch.
+    auto value = mSubmittedValue + 1;
+    std::vector<vk::Semaphore> signalSemaphores;
+    std::vector<std::uint64_t> signalValues;
+    if (signal)
+    {
+        signalSemaphores.push_back(signal);
+        signalValues.push_back(0);
+    }
+
+    if (mHasTimeline)
+    {
+        signalSemaphores.push_back(*mTimeline);
+        signalValues.push_back(value);
+    }
+
+    vk::SubmitInfo submitInfo;
+    submitInfo.waitSemaphoreCount =
+        static_cast<std::uint32_t>(waitSemaphores.size());
+    submitInfo.pWaitSemaphores    = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask  = waitStages.data();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers    = &commandBuffer;
+    submitInfo.signalSemaphoreCount =
+        static_cast<std::uint32_t>(signalSemaphores.size());
+    submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+    vk::TimelineSemaphoreSubmitInfoKHR timelineInfo;
+    timelineInfo.waitSemaphoreValueCount =
+        static_cast<std::uint32_t>(waitValues.size());
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount =
+        static_cast<std::uint32_t>(signalValues.size());
+    timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+    if (mHasTimeline)
+    {
+        submitInfo.pNext = &timelineInfo;
+        mQueue.submit({submitInfo}, {});
+        mSubmittedValue = value;
+        return value;
+    }
+
+    PendingFence pending;
+    pending.value = value;
+    if (mFreeFences.empty())
+    {
+        pending.fence = mDevice.createFenceUnique({});
+    }
+    else
+    {
+        pending.fence = std::move(mFreeFences.back());
+        mFreeFences.pop_back();
+    }
+
+    mQueue.submit({submitInfo}, *pending.fence);
+    mPendingFences.push_back(std::move(pending));
+    mSubmittedValue = value;
+    return value;
+}
+
+void FrameScheduler::retireFence()
+{
+    auto& pending   = mPendingFences.front();
+    mCompletedValue = pending.value;
+    mDevice.resetFences({*pending.fence});
+    mFreeFences.push_back(std::move(pending.fence));
+    mPendingFences.pop_front();
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+class DeletionQueue;
+
+// Something a submission waits on before the given stage. The value is only
+// read for timeline semaphores.
+struct SemaphoreWait
+{
+    vk::Semaphore semaphore;
+    std::uint64_t value{0};
+    vk::PipelineStageFlags stage;
+};
+
+// Tracks how far the GPU has got through the graphics queue as a single,
+// ever increasing value. Every submission made through the scheduler
+// signals the next one, so whatever remembers the value of its last use can
+// be tested or waited on exactly, instead of waiting for a whole frame.
+//
+// With VK_KHR_timeline_semaphore the value is the counter of a timeline
+// semaphore. Without it every submission gets a fence from a small pool and
+// the value is however many of them have signalled, in order.
+//
+// Frames in flight and swap chain images are tracked the same way. A frame
+// slot can be recorded into again once its last submission has finished,
+// and an image once the last frame that rendered to it has. The swap chain
+// itself can't use timelines, so acquire and present still go through
+// binary semaphores, one per frame slot and one per image respectively.
+class FrameScheduler
+{
+public:
+    void init(vk::Device const& device,
+              vk::Queue const& queue,
+              bool hasTimeline,
+              std::uint32_t framesInFlight);
+
+    // Must be called whenever the swap chain is created. The new images
+    // start out free, while the old present semaphores are retired to the
+    // deletion queue.
+    void setImageCount(std::uint32_t imageCount, DeletionQueue& deletionQueue);
+
+    // Blocks until the frame slot about to be recorded is free and returns
+    // it. The slot only moves on once a frame has been submitted into it.
+    std::uint32_t beginFrame();
+    std::uint32_t getFrame() const;
+    vk::Semaphore getAcquireSemaphore() const;
+
+    // Blocks until the last frame that rendered to the image has finished.
+    void useImage(std::uint32_t imageIndex);
+    vk::Semaphore getPresentSemaphore(std::uint32_t imageIndex) const;
+
+    // Submits a frame that renders to the image. When the frame is presented
+    // it waits for the acquire and signals the image's present semaphore.
+    std::uint64_t submitFrame(vk::CommandBuffer const& commandBuffer,
+                              std::uint32_t imageIndex,
+                              bool present);
+
+    // Everything else that goes on the queue. Returns the value that is
+    // reached once the command buffer has finished.
+    std::uint64_t submit(vk::CommandBuffer const& commandBuffer,
+                         std::vector<SemaphoreWait> const& waits = {});
+
+    // The value the next submission will signal, which is what anything
+    // recorded now should be marked as last used at. Anything only used by
+    // work that has already been submitted is done at the submitted value.
+    std::uint64_t getNextValue() const;
+    std::uint64_t getSubmittedValue() const;
+    std::uint64_t getCompletedValue();
+    bool isComplete(std::uint64_t value);
+    void wait(std::uint64_t value);
+
+    bool hasTimeline() const;
+
+private:
+    struct PendingFence
+    {
+        std::uint64_t value;
+        vk::UniqueFence fence;
+    };
+
+    std::uint64_t submitCommands(vk::CommandBuffer const& commandBuffer,
+                                 std::vector<SemaphoreWait> const& waits,
+                                 vk::Semaphore const& signal);
+    void retireFence();
+
+    vk::Device mDevice;
+    vk::Queue mQueue;
+
+    bool mHasTimeline{false};
+    vk::UniqueSemaphore mTimeline;
+    PFN_vkGetSemaphoreCounterValueKHR mGetCounterValue{nullptr};
+    PFN_vkWaitSemaphoresKHR mWaitSemaphores{nullptr};
+
+    // Only used without timelines, oldest submission first.
+    std::deque<PendingFence> mPendingFences;
+    std::vector<vk::UniqueFence> mFreeFences;
+
+    std::uint64_t mSubmittedValue{0};
+    std::uint64_t mCompletedValue{0};
+
+    std::uint32_t mFrame{0};
+    std::vector<std::uint64_t> mFrameValues;
+    std::vector<vk::UniqueSemaphore> mAcquireSemaphores;
+
+    std::vector<std::uint64_t> mImageValues;
+    std::vector<vk::UniqueSemaphore> mPresentSemaphores;
+};
@@ -0,0 +1,222 @@
+#include "GpuProfiler.hpp"
+
+#include <fmt/printf.h>
+
+#include <algorithm>
+#include <fstream>
+
+void GpuProfiler::init(vk::PhysicalDevice const& physicalDevice,
+                       vk::Device const& device,
+                       std::uint32_t queueFamily,
+                       std::uint32_t frameSlots)
+{
+    auto properties = physicalDevice.getProperties();
+    auto families   = physicalDevice.getQueueFamilyProperties();
+    auto validBits  = families[queueFamily].timestampValidBits;
+    if (validBits == 0 || properties.limits.timestampPeriod == 0.0f)
+    {
+        fmt::print("warning: timestamps are not supported, GPU profiling is "
+                   "disabled.\n");
+        return;
+    }
+
+    // Bits above timestampValidBits are undefined, so they are masked off and
+    // differences are taken modulo the valid range to survive wrap around.
+    mDevice          = device;
+    mTimestampPeriod = properties.limits.timestampPeriod;
+    mTimestampMask   = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    mFrameSlots      = frameSlots;
+    mSlots.resize(frameSlots + 1);
+
+    vk::QueryPoolCreateInfo poolInfo;
+    poolInfo.queryType  = vk::QueryType::eTimestamp;
+    poolInfo.queryCount = static_cast<std::uint32_t>(mSlots.size()) *
+                          maxScopes * 2;
+    mQueryPool = device.createQueryPoolUnique(poolInfo);
+}
+
+bool GpuProfiler::isEnabled() const
+{
+    return static_cast<bool>(mQueryPool);
+}
+
+std::uint32_t GpuProfiler::getUploadSlot() const
+{
+    return mFrameSlots;
+}
+
+void GpuProfiler::beginFrame(vk::CommandBuffer const& commandBuffer,
+                             std::uint32_t slot)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+
+    collect(slot);
+    mSlots[slot].scopeCount = 0;
+    mSlots[slot].frame      = mFrameCount++;
+    commandBuffer.resetQueryPool(*mQueryPool, slot * maxScopes * 2,
+                                 maxScopes * 2);
+}
+
+std::uint32_t GpuProfiler::beginScope(vk::CommandBuffer const& commandBuffer,
+                                      std::uint32_t slot,
+                                      char const* name)
+{
+    if (!isEnabled() || mSlots[slot].scopeCount == maxScopes)
+    {
+        return noScope;
+    }
+
+    auto scope                = mSlots[slot].scopeCount++;
+    mSlots[slot].names[scope] = name;
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe,
+                                 *mQueryPool,
+                                 (slot * maxScopes + scope) * 2);
+    return scope;
+}
+
+void GpuProfiler::endScope(vk::CommandBuffer const& commandBuffer,
+                           std::uint32_t slot,
+                           std::uint32_t scope)
+{
+    if (scope == noScope)
+    {
+        return;
+    }
+
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,
+                                 *mQueryPool,
+                                 (slot * maxScopes + scope) * 2 + 1);
+}
+
+void GpuProfiler::collect(std::uint32_t slot)
+{
+    if (!isEnabled() || mSlots[slot].scopeCount == 0)
+    {
+        return;
+    }
+
+    auto& current = mSlots[slot];
+    // Everything in the slot has executed by now, so this returns straight
+    // away. A scope opened but never closed leaves its pair unavailable,
+    // which makes the whole read fail, so nothing is recorded in that case.
+    std::array<std::uint64_t, maxScopes * 2> timestamps;
+    auto result = mDevice.getQueryPoolResults(
+        *mQueryPool,
+        slot * maxScopes * 2,
+        current.scopeCount * 2,
+        sizeof(std::uint64_t) * current.scopeCount * 2,
+        timestamps.data(),
+        sizeof(std::uint64_t),
+        vk::QueryResultFlagBits::e64);
+    std::uint32_t scopeCount = current.scopeCount;
+    current.scopeCount       = 0;
+    if (result != vk::Result::eSuccess)
+    {
+        return;
+    }
+
+    if (!mHasTraceOrigin)
+    {
+        mTraceOrigin    = timestamps[0] & mTimestampMask;
+        mHasTraceOrigin = true;
+    }
+
+    for (std::uint32_t i{0}; i < scopeCount; ++i)
+    {
+        auto begin = timestamps[i * 2] & mTimestampMask;
+        auto end   = timestamps[i * 2 + 1] & mTimestampMask;
+        double ticks      = static_cast<double>((end - begin) & mTimestampMask);
+        double startTicks =
+            static_cast<double>((begin - mTraceOrigin) & mTimestampMask);
+
+        // timestampPeriod is in nanoseconds per tick.
+        double milliseconds = ticks * mTimestampPeriod * 1e-6;
+        addSample(current.names[i], milliseconds);
+
+        if (mTraceEvents.size() < maxTraceEvents)
+        {
+            mTraceEvents.push_back({current.names[i],
+                                    current.frame,
+                                    startTicks * mTimestampPeriod * 1e-3,
+                                    ticks * mTimestampPeriod * 1e-3});
+        }
+    }
+}
+
+void GpuProfiler::printSummary() const
+{
+    if (mStats.empty())
+    {
+        return;
+    }
+
+    fmt::print("GPU timings (average of the last {} samples):\n",
+               averageWindow);
+    for (auto const& [name, average] : getAverages())
+    {
+        fmt::print("  {:<24} {:8.3f} ms\n", name, average);
+    }
+}
+
+std::vector<std::pair<std::string, double>> GpuProfiler::getAverages() const
+{
+    std::vector<std::pair<std::string, double>> averages;
+    for (auto const& stats : mStats)
+    {
+        auto count = std::min(stats.sampleCount, averageWindow);
+        averages.emplace_back(stats.name, stats.sum / count);
+    }
+
+    return averages;
+}
+
+bool GpuProfiler::writeTrace(std::string const& filename) const
+{
+    std::ofstream file{filename, std::ios::trunc};
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    // Chrome's trace event format, in microseconds. Load it through
+    // chrome://tracing or Perfetto.
+    file << "{\"traceEvents\":[";
+    for (std::size_t i{0}; i < mTraceEvents.size(); ++i)
+    {
+        auto const& event = mTraceEvents[i];
+        file << fmt::format("{}{{\"name\":\"{}\",\"cat\":\"gpu\",\"ph\":\"X\","
+                            "\"pid\":0,\"tid\":0,\"ts\":{:.3f},"
+                            "\"dur\":{:.3f},\"args\":{{\"frame\":{}}}}}",
+                            i == 0 ? "" : ",\n",
+                            event.name,
+                            event.start,
+                            event.duration,
+                            event.frame);
+    }
+    file << "],\"displayTimeUnit\":\"ms\"}\n";
+
+    return file.good();
+}
+
+void GpuProfiler::addSample(char const* name, double milliseconds)
+{
+    auto stats = std::find_if(mStats.begin(),
+                              mStats.end(),
+                              [name](ScopeStats const& entry) {
+                                  return entry.name == name;
+                              });
+    if (stats == mStats.end())
+    {
+        mStats.push_back({name});
+        stats = mStats.end() - 1;
+    }
+
+    // A fixed window keeps the average responsive to changes in the scene.
+    auto& sample = stats->samples[stats->sampleCount % averageWindow];
+    stats->sum += milliseconds - sample;
+    sample = milliseconds;
+    ++stats->sampleCount;
+}
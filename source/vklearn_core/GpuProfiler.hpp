@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Times ranges of GPU work with timestamp queries. The query pool is split
+// into slots, one per frame in flight plus one for the uploads done during
+// start up. A slot is only read back once its fence has been waited on,
+// which is frames in flight frames after it was recorded, so reading never
+// stalls. Scopes must be recorded from a single thread.
+class GpuProfiler
+{
+public:
+    static constexpr std::uint32_t noScope{~0u};
+
+    void init(vk::PhysicalDevice const& physicalDevice,
+              vk::Device const& device,
+              std::uint32_t queueFamily,
+              std::uint32_t frameSlots);
+
+    bool isEnabled() const;
+    std::uint32_t getUploadSlot() const;
+
+    // Reads whatever the slot recorded last time round and resets its
+    // queries. Must be recorded outside of a render pass, before any scope
+    // in the slot, and only once the slot's previous work has finished.
+    void beginFrame(vk::CommandBuffer const& commandBuffer, std::uint32_t slot);
+
+    std::uint32_t beginScope(vk::CommandBuffer const& commandBuffer,
+                             std::uint32_t slot,
+                             char const* name);
+    void endScope(vk::CommandBuffer const& commandBuffer,
+                  std::uint32_t slot,
+                  std::uint32_t scope);
+
+    // Reads the slot back without resetting it, for work that is known to
+    // have finished such as the uploads.
+    void collect(std::uint32_t slot);
+
+    void printSummary() const;
+    bool writeTrace(std::string const& filename) const;
+
+    // Rolling average in milliseconds of every scope seen so far.
+    std::vector<std::pair<std::string, double>> getAverages() const;
+
+private:
+    static constexpr std::uint32_t maxScopes{16};
+    static constexpr std::size_t averageWindow{64};
+    static constexpr std::size_t maxTraceEvents{1 << 16};
+
+    struct Slot
+    {
+        std::array<char const*, maxScopes> names;
+        std::uint32_t scopeCount{0};
+        std::uint64_t frame{0};
+    };
+
+    struct ScopeStats
+    {
+        std::string name;
+        std::array<double, averageWindow> samples{};
+        std::size_t sampleCount{0};
+        double sum{0.0};
+    };
+
+    struct TraceEvent
+    {
+        char const* name;
+        std::uint64_t frame;
+        double start;
+        double duration;
+    };
+
+    void addSample(char const* name, double milliseconds);
+
+    vk::Device mDevice;
+    vk::UniqueQueryPool mQueryPool;
+    double mTimestampPeriod{1.0};
+    std::uint64_t mTimestampMask{~0ull};
+    std::uint32_t mFrameSlots{0};
+
+    std::vector<Slot> mSlots;
+    std::uint64_t mFrameCount{0};
+
+    std::vector<ScopeStats> mStats;
+    std::vector<TraceEvent> mTraceEvents;
+    std::uint64_t mTraceOrigin{0};
+    bool mHasTraceOrigin{false};
+};
@@ -0,0 +1,116 @@
+#include "JobSystem.hpp"
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock{mMutex};
+        mStop = true;
+    }
+    mWake.notify_all();
+
+    for (auto& worker : mWorkers)
+    {
+        worker.join();
+    }
+}
+
+void JobSystem::init(std::size_t threadCount)
+{
+    for (std::size_t i{1}; i < threadCount; ++i)
+    {
+        mWorkers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+std::size_t JobSystem::getThreadCount() const
+{
+    return mWorkers.size() + 1;
+}
+
+void JobSystem::dispatch(std::size_t count, Job const& job)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{mMutex};
+        mJob      = &job;
+        mJobCount = count;
+        mPending  = count - 1;
+        mError    = nullptr;
+        ++mGeneration;
+    }
+    mWake.notify_all();
+
+    try
+    {
+        job(0);
+    }
+    catch (...)
+    {
+        setError(std::current_exception());
+    }
+
+    std::unique_lock<std::mutex> lock{mMutex};
+    mDone.wait(lock, [this]() { return mPending == 0; });
+    mJob = nullptr;
+
+    if (mError)
+    {
+        std::rethrow_exception(mError);
+    }
+}
+
+void JobSystem::workerLoop(std::size_t index)
+{
+    std::uint64_t generation{0};
+    for (;;)
+    {
+        Job const* job{nullptr};
+        {
+            std::unique_lock<std::mutex> lock{mMutex};
+            mWake.wait(lock, [this, generation]() {
+                return mStop || mGeneration != generation;
+            });
+
+            if (mStop)
+            {
+                return;
+            }
+
+            // Threads past the job count sit this dispatch out.
+            generation = mGeneration;
+            if (index >= mJobCount)
+            {
+                continue;
+            }
+            job = mJob;
+        }
+
+        try
+        {
+            (*job)(index);
+        }
+        catch (...)
+        {
+            setError(std::current_exception());
+        }
+
+        std::lock_guard<std::mutex> lock{mMutex};
+        if (--mPending == 0)
+        {
+            mDone.notify_one();
+        }
+    }
+}
+
+void JobSystem::setError(std::exception_ptr error)
+{
+    std::lock_guard<std::mutex> lock{mMutex};
+    if (!mError)
+    {
+        mError = error;
+    }
+}
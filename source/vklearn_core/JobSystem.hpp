@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that run one job each per dispatch. Job i
+// always runs on thread i (the calling thread being thread 0), so callers can
+// keep per-thread resources such as command pools indexed by it.
+class JobSystem
+{
+public:
+    using Job = std::function<void(std::size_t)>;
+
+    JobSystem() = default;
+    JobSystem(JobSystem const&) = delete;
+    JobSystem& operator=(JobSystem const&) = delete;
+    ~JobSystem();
+
+    // threadCount includes the calling thread.
+    void init(std::size_t threadCount);
+    std::size_t getThreadCount() const;
+
+    // Runs job(0) ... job(count - 1) in parallel and returns once all of them
+    // have finished. count must not exceed getThreadCount(). The first
+    // exception thrown by a job is rethrown here.
+    void dispatch(std::size_t count, Job const& job);
+
+private:
+    void workerLoop(std::size_t index);
+    void setError(std::exception_ptr error);
+
+    std::vector<std::thread> mWorkers;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::condition_variable mDone;
+
+    Job const* mJob{nullptr};
+    std::size_t mJobCount{0};
+    std::size_t mPending{0};
+    std::uint64_t mGeneration{0};
+    std::exception_ptr mError;
+    bool mStop{false};
+};
@@ -0,0 +1,132 @@
+#include "MappedFile.hpp"
+
+#if defined(_WIN32) || defined(_WIN64)
+#    define WIN32_LEAN_AND_MEAN
+#    define NOMINMAX
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(std::string const& filename)
+{
+    close();
+
+#if defined(_WIN32) || defined(_WIN64)
+    HANDLE file = CreateFileA(filename.c_str(),
+                              GENERIC_READ,
+                              FILE_SHARE_READ,
+                              nullptr,
+                              OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    mFile = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        close();
+        return false;
+    }
+
+    mMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mMapping)
+    {
+        close();
+        return false;
+    }
+
+    mData = MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+    mSize = static_cast<std::size_t>(size.QuadPart);
+#else
+    mFile = ::open(filename.c_str(), O_RDONLY);
+    if (mFile < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(mFile, &info) != 0 || info.st_size == 0)
+    {
+        close();
+        return false;
+    }
+
+    void* data = mmap(nullptr,
+                      static_cast<std::size_t>(info.st_size),
+                      PROT_READ,
+                      MAP_PRIVATE,
+                      mFile,
+                      0);
+    mData = (data == MAP_FAILED) ? nullptr : data;
+    mSize = static_cast<std::size_t>(info.st_size);
+#endif
+
+    if (!mData)
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::close()
+{
+#if defined(_WIN32) || defined(_WIN64)
+    if (mData)
+    {
+        UnmapViewOfFile(mData);
+    }
+    if (mMapping)
+    {
+        CloseHandle(mMapping);
+    }
+    if (mFile)
+    {
+        CloseHandle(mFile);
+    }
+    mMapping = nullptr;
+    mFile    = nullptr;
+#else
+    if (mData)
+    {
+        munmap(mData, mSize);
+    }
+    if (mFile >= 0)
+    {
+        ::close(mFile);
+    }
+    mFile = -1;
+#endif
+
+    mData = nullptr;
+    mSize = 0;
+}
+
+bool MappedFile::isOpen() const
+{
+    return mData != nullptr;
+}
+
+void const* MappedFile::getData() const
+{
+    return mData;
+}
+
+std::size_t MappedFile::getSize() const
+{
+    return mSize;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    bool open(std::string const& filename);
+    void close();
+
+    bool isOpen() const;
+    void const* getData() const;
+    std::size_t getSize() const;
+
+private:
+#if defined(_WIN32) || defined(_WIN64)
+    void* mFile{nullptr};
+    void* mMapping{nullptr};
+#else
+    int mFile{-1};
+#endif
+
+    void* mData{nullptr};
+    std::size_t mSize{0};
+};
@@ -0,0 +1,312 @@
+#include "MemoryAllocator.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace globals
+{
+    static constexpr vk::DeviceSize defaultBlockSize{64 * 1024 * 1024};
+
+    // Empty default sized blocks each pool holds on to, so that memory which
+    // is freed and allocated again every so often isn't handed back each
+    // time. Larger blocks are always released once they are empty.
+    static constexpr std::size_t retainedEmptyBlocks{1};
+} // namespace globals
+
+static vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+void MemoryAllocator::init(vk::PhysicalDevice const& physicalDevice,
+                           vk::Device const& device)
+{
+    mDevice           = device;
+    mMemoryProperties = physicalDevice.getMemoryProperties();
+    mPools.resize(mMemoryProperties.memoryTypeCount * 2);
+}
+
+std::uint32_t
+MemoryAllocator::findMemoryType(std::uint32_t typeFilter,
+                                vk::MemoryPropertyFlags const& properties)
+{
+    auto key = std::make_pair(typeFilter,
+                              static_cast<VkMemoryPropertyFlags>(properties));
+    if (auto it = mMemoryTypeCache.find(key); it != mMemoryTypeCache.end())
+    {
+        return it->second;
+    }
+
+    for (std::uint32_t i{0}; i < mMemoryProperties.memoryTypeCount; ++i)
+    {
+        if (typeFilter & (1 << i) &&
+            (mMemoryProperties.memoryTypes[i].propertyFlags & properties) ==
+                properties)
+        {
+            mMemoryTypeCache[key] = i;
+            return i;
+        }
+    }
+
+    throw std::runtime_error{"error: failed to find suitable memory type."};
+}
+
+bool MemoryAllocator::hasMemoryType(
+    std::uint32_t typeFilter,
+    vk::MemoryPropertyFlags const& properties) const
+{
+    for (std::uint32_t i{0}; i < mMemoryProperties.memoryTypeCount; ++i)
+    {
+        if (typeFilter & (1 << i) &&
+            (mMemoryProperties.memoryTypes[i].propertyFlags & properties) ==
+                properties)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+Allocation
+MemoryAllocator::allocate(vk::MemoryRequirements const& requirements,
+                          vk::MemoryPropertyFlags const& properties,
+                          bool isLinear)
+{
+    auto memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+    std::uint32_t pool = memoryType * 2 + (isLinear ? 0 : 1);
+    auto& blocks       = mPools[pool];
+
+    Allocation allocation;
+    allocation.pool = pool;
+    allocation.size = requirements.size;
+
+    bool found{false};
+    for (std::size_t i{0}; i < blocks.size(); ++i)
+    {
+        if (suballocate(blocks[i],
+                        requirements.size,
+                        requirements.alignment,
+                        allocation.offset))
+        {
+            allocation.block = i;
+            found            = true;
+            break;
+        }
+    }
+
+    if (!found)
+    {
+        // Anything larger than a default block gets a block of its own, which
+        // is released again as soon as it's freed.
+        auto blockSize = std::max(
+            globals::defaultBlockSize,
+            alignUp(requirements.size, requirements.alignment));
+        allocation.block = createBlock(memoryType, pool, blockSize);
+        suballocate(blocks[allocation.block],
+                    requirements.size,
+                    requirements.alignment,
+                    allocation.offset);
+    }
+
+    auto& block       = blocks[allocation.block];
+    allocation.memory = *block.memory;
+    allocation.mapped =
+        (block.mapped)
+            ? static_cast<char*>(block.mapped) + allocation.offset
+            : nullptr;
+    return allocation;
+}
+
+void MemoryAllocator::free(Allocation& allocation)
+{
+    if (!allocation.memory)
+    {
+        return;
+    }
+
+    auto& ranges = mPools[allocation.pool][allocation.block].freeRanges;
+    Range range{allocation.offset, allocation.size};
+
+    // Keep the free list sorted by offset so that neighbouring ranges can be
+    // merged back together.
+    auto it = std::lower_bound(
+        ranges.begin(), ranges.end(), range, [](auto const& a, auto const& b) {
+            return a.offset < b.offset;
+        });
+    it = ranges.insert(it, range);
+
+    auto next = it + 1;
+    if (next != ranges.end() && it->offset + it->size == next->offset)
+    {
+        it->size += next->size;
+        ranges.erase(next);
+    }
+
+    if (it != ranges.begin())
+    {
+        auto prev = it - 1;
+        if (prev->offset + prev->size == it->offset)
+        {
+            prev->size += it->size;
+            ranges.erase(it);
+        }
+    }
+
+    releaseUnusedBlock(allocation.pool, allocation.block);
+    allocation = Allocation{};
+}
+
+std::size_t MemoryAllocator::getBlockCount() const
+{
+    std::size_t count{0};
+    for (auto const& blocks : mPools)
+    {
+        count += static_cast<std::size_t>(
+            std::count_if(blocks.begin(), blocks.end(), [](auto const& block) {
+                return static_cast<bool>(block.memory);
+            }));
+    }
+
+    return count;
+}
+
+vk::DeviceSize MemoryAllocator::getAllocatedSize() const
+{
+    vk::DeviceSize size{0};
+    for (auto const& blocks : mPools)
+    {
+        for (auto const& block : blocks)
+        {
+            size += block.size;
+        }
+    }
+
+    return size;
+}
+
+vk::DeviceSize MemoryAllocator::getDeviceLocalUsage() const
+{
+    vk::DeviceSize usage{0};
+    for (std::uint32_t pool{0}; pool < mPools.size(); ++pool)
+    {
+        auto flags = mMemoryProperties.memoryTypes[pool / 2].propertyFlags;
+        if (!(flags & vk::MemoryPropertyFlagBits::eDeviceLocal))
+        {
+            continue;
+        }
+
+        for (auto const& block : mPools[pool])
+        {
+            usage += block.size;
+            for (auto const& range : block.freeRanges)
+            {
+                usage -= range.size;
+            }
+        }
+    }
+
+    return usage;
+}
+
+bool MemoryAllocator::suballocate(Block& block,
+                                  vk::DeviceSize size,
+                                  vk::DeviceSize alignment,
+                                  vk::DeviceSize& offset)
+{
+    for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it)
+    {
+        auto alignedOffset = alignUp(it->offset, alignment);
+        auto padding       = alignedOffset - it->offset;
+        if (padding + size > it->size)
+        {
+            continue;
+        }
+
+        Range head{it->offset, padding};
+        Range tail{alignedOffset + size, it->size - padding - size};
+
+        it = block.freeRanges.erase(it);
+        if (tail.size > 0)
+        {
+            it = block.freeRanges.insert(it, tail);
+        }
+        if (head.size > 0)
+        {
+            block.freeRanges.insert(it, head);
+        }
+
+        offset = alignedOffset;
+        return true;
+    }
+
+    return false;
+}
+
+bool MemoryAllocator::isUnused(Block const& block)
+{
+    return block.memory && block.freeRanges.size() == 1 &&
+           block.freeRanges.front().size == block.size;
+}
+
+std::size_t MemoryAllocator::createBlock(std::uint32_t memoryType,
+                                         std::uint32_t pool,
+                                         vk::DeviceSize size)
+{
+    vk::MemoryAllocateInfo allocInfo;
+    allocInfo.allocationSize  = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    Block block;
+    block.memory = mDevice.allocateMemoryUnique(allocInfo);
+    block.size   = size;
+    block.freeRanges.push_back({0, size});
+
+    // Host visible blocks are mapped once for their entire lifetime. Mapping
+    // the same memory twice is not allowed, so callers write through the
+    // mapped pointer of their allocation instead of calling mapMemory.
+    auto flags = mMemoryProperties.memoryTypes[memoryType].propertyFlags;
+    if (flags & vk::MemoryPropertyFlagBits::eHostVisible)
+    {
+        block.mapped = mDevice.mapMemory(*block.memory, 0, VK_WHOLE_SIZE);
+    }
+
+    auto& blocks = mPools[pool];
+    auto slot    = std::find_if(
+        blocks.begin(), blocks.end(), [](auto const& candidate) {
+            return !candidate.memory;
+        });
+    if (slot != blocks.end())
+    {
+        *slot = std::move(block);
+        return static_cast<std::size_t>(slot - blocks.begin());
+    }
+
+    blocks.push_back(std::move(block));
+    return blocks.size() - 1;
+}
+
+void MemoryAllocator::releaseUnusedBlock(std::uint32_t pool, std::size_t index)
+{
+    auto& blocks = mPools[pool];
+    auto& block  = blocks[index];
+    if (!isUnused(block))
+    {
+        return;
+    }
+
+    // The count includes this block.
+    auto emptyBlocks = static_cast<std::size_t>(
+        std::count_if(blocks.begin(), blocks.end(), [](auto const& candidate) {
+            return isUnused(candidate) &&
+                   candidate.size == globals::defaultBlockSize;
+        }));
+    if (block.size == globals::defaultBlockSize &&
+        emptyBlocks <= globals::retainedEmptyBlocks)
+    {
+        return;
+    }
+
+    // Freeing the memory also unmaps it.
+    block = Block{};
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+struct Allocation
+{
+    vk::DeviceMemory memory;
+    vk::DeviceSize offset{0};
+    vk::DeviceSize size{0};
+    void* mapped{nullptr};
+
+    std::uint32_t pool{0};
+    std::size_t block{0};
+};
+
+class MemoryAllocator
+{
+public:
+    void init(vk::PhysicalDevice const& physicalDevice,
+              vk::Device const& device);
+
+    std::uint32_t findMemoryType(std::uint32_t typeFilter,
+                                 vk::MemoryPropertyFlags const& properties);
+
+    // Like findMemoryType, but for properties that are only a preference.
+    bool hasMemoryType(std::uint32_t typeFilter,
+                       vk::MemoryPropertyFlags const& properties) const;
+
+    Allocation allocate(vk::MemoryRequirements const& requirements,
+                        vk::MemoryPropertyFlags const& properties,
+                        bool isLinear);
+    void free(Allocation& allocation);
+
+    std::size_t getBlockCount() const;
+    vk::DeviceSize getAllocatedSize() const;
+
+    // What is actually handed out of device local memory, rather than the
+    // size of the blocks it comes out of.
+    vk::DeviceSize getDeviceLocalUsage() const;
+
+private:
+    struct Range
+    {
+        vk::DeviceSize offset;
+        vk::DeviceSize size;
+    };
+
+    // Released blocks keep their slot with no memory, so that the block
+    // index of every other allocation stays valid. The slot is reused by the
+    // next block created in the same pool.
+    struct Block
+    {
+        vk::UniqueDeviceMemory memory;
+        vk::DeviceSize size{0};
+        void* mapped{nullptr};
+        std::vector<Range> freeRanges;
+    };
+
+    static bool isUnused(Block const& block);
+
+    bool suballocate(Block& block,
+                     vk::DeviceSize size,
+                     vk::DeviceSize alignment,
+                     vk::DeviceSize& offset);
+    std::size_t createBlock(std::uint32_t memoryType,
+                            std::uint32_t pool,
+                            vk::DeviceSize size);
+    void releaseUnusedBlock(std::uint32_t pool, std::size_t index);
+
+    vk::Device mDevice;
+    vk::PhysicalDeviceMemoryProperties mMemoryProperties;
+
+    std::map<std::pair<std::uint32_t, VkMemoryPropertyFlags>, std::uint32_t>
+        mMemoryTypeCache;
+
+    // Linear (buffers, linear images) and optimal (tiled images) resources
+    // live in separate pools for each memory type. This way we never have to
+    // worry about bufferImageGranularity between neighbouring allocations.
+    std::vector<std::vector<Block>> mPools;
+};
@@ -0,0 +1,151 @@
+#include "MeshCache.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+namespace globals
+{
+    static constexpr std::uint32_t meshCacheMagic{0x48534d56}; // "VMSH"
+    static constexpr std::uint32_t meshCacheVersion{3};
+} // namespace globals
+
+MeshCacheKey getMeshCacheKey(std::string const& sourceFilename)
+{
+    namespace fs = std::filesystem;
+
+    std::error_code error;
+    MeshCacheKey key;
+    key.sourceSize = fs::file_size(sourceFilename, error);
+    if (error)
+    {
+        return {};
+    }
+
+    key.sourceTime =
+        fs::last_write_time(sourceFilename, error).time_since_epoch().count();
+    return key;
+}
+
+bool writeMeshCache(std::string const& filename,
+                    MeshCacheKey const& key,
+                    void const* vertices,
+                    std::uint32_t vertexStride,
+                    std::size_t vertexCount,
+                    std::uint32_t const* indices,
+                    std::size_t indexCount,
+                    Meshlet const* meshlets,
+                    std::size_t meshletCount,
+                    MeshLod const* lods,
+                    std::size_t lodCount)
+{
+    std::ofstream file{filename, std::ios::binary | std::ios::trunc};
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    MeshCacheHeader header{};
+    header.magic        = globals::meshCacheMagic;
+    header.version      = globals::meshCacheVersion;
+    header.vertexStride = vertexStride;
+    header.key          = key;
+    header.vertexCount  = vertexCount;
+    header.indexCount   = indexCount;
+    header.meshletCount = meshletCount;
+    header.lodCount     = lodCount;
+
+    file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    file.write(static_cast<char const*>(vertices),
+               static_cast<std::streamsize>(vertexStride * vertexCount));
+    file.write(
+        reinterpret_cast<char const*>(indices),
+        static_cast<std::streamsize>(sizeof(std::uint32_t) * indexCount));
+    file.write(reinterpret_cast<char const*>(meshlets),
+               static_cast<std::streamsize>(sizeof(Meshlet) * meshletCount));
+    file.write(reinterpret_cast<char const*>(lods),
+               static_cast<std::streamsize>(sizeof(MeshLod) * lodCount));
+
+    return file.good();
+}
+
+bool MeshCache::open(std::string const& filename,
+                     MeshCacheKey const& key,
+                     std::uint32_t vertexStride)
+{
+    mHeader = nullptr;
+    if (key.sourceSize == 0 || !mFile.open(filename))
+    {
+        return false;
+    }
+
+    if (mFile.getSize() < sizeof(MeshCacheHeader))
+    {
+        mFile.close();
+        return false;
+    }
+
+    auto header = static_cast<MeshCacheHeader const*>(mFile.getData());
+    std::size_t expectedSize = sizeof(MeshCacheHeader) +
+                               header->vertexStride * header->vertexCount +
+                               sizeof(std::uint32_t) * header->indexCount +
+                               sizeof(Meshlet) * header->meshletCount +
+                               sizeof(MeshLod) * header->lodCount;
+
+    if (header->magic != globals::meshCacheMagic ||
+        header->version != globals::meshCacheVersion ||
+        header->vertexStride != vertexStride ||
+        header->key.sourceSize != key.sourceSize ||
+        header->key.sourceTime != key.sourceTime ||
+        mFile.getSize() != expectedSize)
+    {
+        mFile.close();
+        return false;
+    }
+
+    mHeader = header;
+    return true;
+}
+
+void const* MeshCache::getVertices() const
+{
+    return static_cast<char const*>(mFile.getData()) + sizeof(MeshCacheHeader);
+}
+
+std::size_t MeshCache::getVertexCount() const
+{
+    return static_cast<std::size_t>(mHeader->vertexCount);
+}
+
+std::uint32_t const* MeshCache::getIndices() const
+{
+    return reinterpret_cast<std::uint32_t const*>(
+        static_cast<char const*>(getVertices()) +
+        mHeader->vertexStride * mHeader->vertexCount);
+}
+
+std::size_t MeshCache::getIndexCount() const
+{
+    return static_cast<std::size_t>(mHeader->indexCount);
+}
+
+Meshlet const* MeshCache::getMeshlets() const
+{
+    return reinterpret_cast<Meshlet const*>(getIndices() +
+                                            mHeader->indexCount);
+}
+
+std::size_t MeshCache::getMeshletCount() const
+{
+    return static_cast<std::size_t>(mHeader->meshletCount);
+}
+
+MeshLod const* MeshCache::getLods() const
+{
+    return reinterpret_cast<MeshLod const*>(getMeshlets() +
+                                            mHeader->meshletCount);
+}
+
+std::size_t MeshCache::getLodCount() const
+{
+    return static_cast<std::size_t>(mHeader->lodCount);
+}
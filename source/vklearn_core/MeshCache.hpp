@@ -0,0 +1,67 @@
+#pragma once
+
+#include "MappedFile.hpp"
+#include "MeshOptimiser.hpp"
+
+#include <cstdint>
+#include <string>
+
+// Identifies the source asset a cache was built from. If either changes the
+// cache is considered stale and gets rebuilt.
+struct MeshCacheKey
+{
+    std::uint64_t sourceSize{0};
+    std::int64_t sourceTime{0};
+};
+
+struct MeshCacheHeader
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t vertexStride;
+    std::uint32_t padding;
+    MeshCacheKey key;
+    std::uint64_t vertexCount;
+    std::uint64_t indexCount;
+    std::uint64_t meshletCount;
+    std::uint64_t lodCount;
+};
+
+MeshCacheKey getMeshCacheKey(std::string const& sourceFilename);
+
+bool writeMeshCache(std::string const& filename,
+                    MeshCacheKey const& key,
+                    void const* vertices,
+                    std::uint32_t vertexStride,
+                    std::size_t vertexCount,
+                    std::uint32_t const* indices,
+                    std::size_t indexCount,
+                    Meshlet const* meshlets,
+                    std::size_t meshletCount,
+                    MeshLod const* lods,
+                    std::size_t lodCount);
+
+// Memory maps a cache written by writeMeshCache. The vertex and index arrays
+// are laid out exactly as they are uploaded, so they can be copied straight
+// into a staging buffer. The meshlets follow the indices, and the levels of
+// detail that index into both follow the meshlets.
+class MeshCache
+{
+public:
+    bool open(std::string const& filename,
+              MeshCacheKey const& key,
+              std::uint32_t vertexStride);
+
+    void const* getVertices() const;
+    std::size_t getVertexCount() const;
+    std::uint32_t const* getIndices() const;
+    std::size_t getIndexCount() const;
+    Meshlet const* getMeshlets() const;
+    std::size_t getMeshletCount() const;
+    MeshLod const* getLods() const;
+    std::size_t getLodCount() const;
+
+private:
+    MappedFile mFile;
+    MeshCacheHeader const* mHeader{nullptr};
+};
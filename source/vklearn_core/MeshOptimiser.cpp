@@ -0,0 +1,517 @@
+#include "MeshOptimiser.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <unordered_map>
+
+namespace globals
+{
+    static constexpr std::size_t vertexCacheSize{32};
+    static constexpr float lastTriangleScore{0.75f};
+    static constexpr float cacheDecayPower{1.5f};
+    static constexpr float valenceBoostScale{2.0f};
+    static constexpr float valenceBoostPower{0.5f};
+
+    // Cones wider than this (measured as the smallest dot product between the
+    // axis and a normal) reject too little to be worth testing.
+    static constexpr float minConeSpread{0.1f};
+
+    // Grid sizes tried when simplifying, in cells along the longest side.
+    static constexpr std::uint32_t maxGridSize{1024};
+} // namespace globals
+
+static float scoreVertex(std::int32_t cachePosition,
+                         std::uint32_t liveTriangles)
+{
+    if (liveTriangles == 0)
+    {
+        return -1.0f;
+    }
+
+    float score{0.0f};
+    if (cachePosition >= 0)
+    {
+        // The three vertices of the last triangle get a fixed score so that
+        // we don't favour strips (which reuse only two vertices) over fans.
+        if (cachePosition < 3)
+        {
+            score = globals::lastTriangleScore;
+        }
+        else
+        {
+            float scale = 1.0f / (globals::vertexCacheSize - 3);
+            score       = 1.0f - (cachePosition - 3) * scale;
+            score       = std::pow(score, globals::cacheDecayPower);
+        }
+    }
+
+    // Boost vertices with few triangles left so that they get finished off
+    // instead of leaving isolated triangles for later.
+    score += globals::valenceBoostScale *
+             std::pow(static_cast<float>(liveTriangles),
+                      -globals::valenceBoostPower);
+    return score;
+}
+
+void optimiseVertexCache(std::vector<std::uint32_t>& indices,
+                         std::size_t vertexCount)
+{
+    std::size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // Build the vertex to triangle adjacency as a single flat array. Each
+    // vertex owns the range [offsets[v], offsets[v] + liveTriangles[v]) and
+    // emitted triangles are swapped out past the end of the range.
+    std::vector<std::uint32_t> liveTriangles(vertexCount, 0);
+    for (auto index : indices)
+    {
+        ++liveTriangles[index];
+    }
+
+    std::vector<std::uint32_t> offsets(vertexCount + 1, 0);
+    for (std::size_t v{0}; v < vertexCount; ++v)
+    {
+        offsets[v + 1] = offsets[v] + liveTriangles[v];
+    }
+
+    std::vector<std::uint32_t> adjacency(indices.size());
+    {
+        std::vector<std::uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (std::size_t i{0}; i < indices.size(); ++i)
+        {
+            adjacency[cursor[indices[i]]++] = static_cast<std::uint32_t>(i / 3);
+        }
+    }
+
+    std::vector<std::int32_t> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (std::size_t v{0}; v < vertexCount; ++v)
+    {
+        vertexScores[v] = scoreVertex(-1, liveTriangles[v]);
+    }
+
+    auto scoreTriangle = [&](std::size_t t) {
+        return vertexScores[indices[t * 3 + 0]] +
+               vertexScores[indices[t * 3 + 1]] +
+               vertexScores[indices[t * 3 + 2]];
+    };
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> isEmitted(triangleCount, false);
+    std::size_t bestTriangle{0};
+    for (std::size_t t{0}; t < triangleCount; ++t)
+    {
+        triangleScores[t] = scoreTriangle(t);
+        if (triangleScores[t] > triangleScores[bestTriangle])
+        {
+            bestTriangle = t;
+        }
+    }
+
+    std::vector<std::uint32_t> output;
+    output.reserve(indices.size());
+
+    std::vector<std::uint32_t> cache;
+    std::vector<std::uint32_t> nextCache;
+    cache.reserve(globals::vertexCacheSize + 3);
+    nextCache.reserve(globals::vertexCacheSize + 3);
+
+    std::size_t scanCursor{0};
+    while (output.size() < indices.size())
+    {
+        auto const* triangle = &indices[bestTriangle * 3];
+        isEmitted[bestTriangle] = true;
+
+        nextCache.clear();
+        for (std::size_t k{0}; k < 3; ++k)
+        {
+            auto v = triangle[k];
+            output.push_back(v);
+            nextCache.push_back(v);
+
+            auto begin = adjacency.begin() + offsets[v];
+            auto end   = begin + liveTriangles[v];
+            auto it    = std::find(begin, end, bestTriangle);
+            std::iter_swap(it, end - 1);
+            --liveTriangles[v];
+        }
+
+        for (auto v : cache)
+        {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+            {
+                nextCache.push_back(v);
+            }
+        }
+
+        // Everything pushed past the end of the cache gets evicted, but its
+        // score still changes so it is updated along with the rest.
+        for (std::size_t i{0}; i < nextCache.size(); ++i)
+        {
+            auto v            = nextCache[i];
+            cachePositions[v] = (i < globals::vertexCacheSize)
+                                    ? static_cast<std::int32_t>(i)
+                                    : -1;
+            vertexScores[v] =
+                scoreVertex(cachePositions[v], liveTriangles[v]);
+        }
+
+        float bestScore{-1.0f};
+        for (auto v : nextCache)
+        {
+            for (std::uint32_t i{0}; i < liveTriangles[v]; ++i)
+            {
+                auto t = adjacency[offsets[v] + i];
+                triangleScores[t] = scoreTriangle(t);
+                if (triangleScores[t] > bestScore)
+                {
+                    bestScore    = triangleScores[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        if (nextCache.size() > globals::vertexCacheSize)
+        {
+            nextCache.resize(globals::vertexCacheSize);
+        }
+        std::swap(cache, nextCache);
+
+        // Nothing left that touches the cache, so pick up wherever the linear
+        // scan left off. This keeps the whole pass linear in the mesh size.
+        if (bestScore < 0.0f)
+        {
+            while (scanCursor < triangleCount && isEmitted[scanCursor])
+            {
+                ++scanCursor;
+            }
+            bestTriangle = scanCursor;
+        }
+    }
+
+    indices = std::move(output);
+}
+
+float computeACMR(std::vector<std::uint32_t> const& indices,
+                  std::size_t vertexCount,
+                  std::size_t cacheSize)
+{
+    if (indices.empty())
+    {
+        return 0.0f;
+    }
+
+    // A FIFO cache can be simulated with a timestamp per vertex: a vertex is
+    // still cached if fewer than cacheSize misses happened since it was added.
+    std::vector<std::size_t> timestamps(vertexCount, 0);
+    std::size_t misses{0};
+    for (auto index : indices)
+    {
+        if (timestamps[index] == 0 || misses - timestamps[index] >= cacheSize)
+        {
+            ++misses;
+            timestamps[index] = misses;
+        }
+    }
+
+    return static_cast<float>(misses) / (indices.size() / 3);
+}
+
+using Vec3 = std::array<float, 3>;
+
+static Vec3 subtract(Vec3 const& a, Vec3 const& b)
+{
+    return {a[0] - b[0], a[1] - b[1], a[2] - b[2]};
+}
+
+static float dot(Vec3 const& a, Vec3 const& b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static Vec3 normalise(Vec3 const& v)
+{
+    float length = std::sqrt(dot(v, v));
+    if (length == 0.0f)
+    {
+        return {0.0f, 0.0f, 0.0f};
+    }
+
+    return {v[0] / length, v[1] / length, v[2] / length};
+}
+
+static Meshlet computeMeshletBounds(std::vector<std::uint32_t> const& indices,
+                                    std::uint32_t firstIndex,
+                                    std::uint32_t indexCount,
+                                    char const* positions,
+                                    std::size_t positionStride)
+{
+    auto position = [positions, positionStride](std::uint32_t index) {
+        Vec3 result;
+        std::copy_n(reinterpret_cast<float const*>(positions +
+                                                    index * positionStride),
+                    3,
+                    result.data());
+        return result;
+    };
+
+    Vec3 minimum{std::numeric_limits<float>::max(),
+                 std::numeric_limits<float>::max(),
+                 std::numeric_limits<float>::max()};
+    Vec3 maximum{std::numeric_limits<float>::lowest(),
+                 std::numeric_limits<float>::lowest(),
+                 std::numeric_limits<float>::lowest()};
+    Vec3 normalSum{0.0f, 0.0f, 0.0f};
+    std::vector<Vec3> normals;
+    normals.reserve(indexCount / 3);
+
+    for (std::uint32_t i{firstIndex}; i < firstIndex + indexCount; i += 3)
+    {
+        auto a = position(indices[i]);
+        auto b = position(indices[i + 1]);
+        auto c = position(indices[i + 2]);
+        for (std::size_t k{0}; k < 3; ++k)
+        {
+            minimum[k] = std::min({minimum[k], a[k], b[k], c[k]});
+            maximum[k] = std::max({maximum[k], a[k], b[k], c[k]});
+        }
+
+        auto ab     = subtract(b, a);
+        auto ac     = subtract(c, a);
+        auto normal = normalise({ab[1] * ac[2] - ab[2] * ac[1],
+                                 ab[2] * ac[0] - ab[0] * ac[2],
+                                 ab[0] * ac[1] - ab[1] * ac[0]});
+        normals.push_back(normal);
+        for (std::size_t k{0}; k < 3; ++k)
+        {
+            normalSum[k] += normal[k];
+        }
+    }
+
+    Meshlet meshlet{};
+    meshlet.firstIndex = firstIndex;
+    meshlet.indexCount = indexCount;
+
+    Vec3 centre;
+    for (std::size_t k{0}; k < 3; ++k)
+    {
+        centre[k]         = (minimum[k] + maximum[k]) * 0.5f;
+        meshlet.centre[k] = centre[k];
+    }
+
+    for (std::uint32_t i{firstIndex}; i < firstIndex + indexCount; ++i)
+    {
+        auto offset = subtract(position(indices[i]), centre);
+        meshlet.radius =
+            std::max(meshlet.radius, std::sqrt(dot(offset, offset)));
+    }
+
+    auto axis = normalise(normalSum);
+    float minimumDot{1.0f};
+    for (auto const& normal : normals)
+    {
+        minimumDot = std::min(minimumDot, dot(axis, normal));
+    }
+
+    std::copy(axis.begin(), axis.end(), meshlet.coneAxis);
+
+    // The cutoff is the sine of the cone's half angle. A cutoff of 1 can never
+    // pass the back-face test, which is what we want for degenerate cones.
+    meshlet.coneCutoff = (minimumDot <= globals::minConeSpread)
+                             ? 1.0f
+                             : std::sqrt(1.0f - minimumDot * minimumDot);
+    return meshlet;
+}
+
+std::vector<Meshlet> buildMeshlets(std::vector<std::uint32_t> const& indices,
+                                   void const* positions,
+                                   std::size_t positionStride,
+                                   std::size_t vertexCount,
+                                   std::size_t maxVertices,
+                                   std::size_t maxTriangles)
+{
+    constexpr auto unused = std::numeric_limits<std::uint32_t>::max();
+
+    // Tracks which meshlet last used each vertex, so counting the unique
+    // vertices of the current one needs no clearing between meshlets.
+    std::vector<std::uint32_t> owner(vertexCount, unused);
+    std::vector<Meshlet> meshlets;
+
+    auto bytes = static_cast<char const*>(positions);
+    std::uint32_t firstIndex{0};
+    std::size_t vertices{0};
+    for (std::uint32_t i{0}; i + 2 < indices.size(); i += 3)
+    {
+        auto id                 = static_cast<std::uint32_t>(meshlets.size());
+        std::size_t newVertices = (owner[indices[i]] != id) +
+                                  (owner[indices[i + 1]] != id) +
+                                  (owner[indices[i + 2]] != id);
+        std::size_t triangles = (i - firstIndex) / 3;
+
+        if (vertices + newVertices > maxVertices || triangles >= maxTriangles)
+        {
+            meshlets.push_back(computeMeshletBounds(
+                indices, firstIndex, i - firstIndex, bytes, positionStride));
+            firstIndex = i;
+            vertices   = 0;
+            ++id;
+        }
+
+        for (std::uint32_t k{0}; k < 3; ++k)
+        {
+            if (owner[indices[i + k]] != id)
+            {
+                owner[indices[i + k]] = id;
+                ++vertices;
+            }
+        }
+    }
+
+    auto indexCount = static_cast<std::uint32_t>(indices.size());
+    if (firstIndex < indexCount)
+    {
+        meshlets.push_back(computeMeshletBounds(indices,
+                                                firstIndex,
+                                                indexCount - firstIndex,
+                                                bytes,
+                                                positionStride));
+    }
+
+    return meshlets;
+}
+
+static std::vector<std::uint32_t>
+clusterVertices(std::vector<std::uint32_t> const& indices,
+                std::vector<Vec3> const& points,
+                Vec3 const& minimum,
+                float cellSize)
+{
+    // Cells are keyed by their packed coordinates. The vertex nearest to the
+    // average of a cell stands in for all of the cell's vertices.
+    auto cellOf = [&minimum, cellSize](Vec3 const& point) {
+        std::uint64_t key{0};
+        for (std::size_t k{0}; k < 3; ++k)
+        {
+            auto cell = static_cast<std::uint64_t>(
+                (point[k] - minimum[k]) / cellSize);
+            key = (key << 21) | std::min(cell, std::uint64_t{(1 << 21) - 1});
+        }
+        return key;
+    };
+
+    struct Cell
+    {
+        Vec3 sum{0.0f, 0.0f, 0.0f};
+        std::uint32_t count{0};
+        std::uint32_t vertex{0};
+        float distance{std::numeric_limits<float>::max()};
+    };
+
+    std::vector<std::uint64_t> keys(points.size());
+    std::unordered_map<std::uint64_t, Cell> cells;
+    for (std::size_t i{0}; i < points.size(); ++i)
+    {
+        keys[i]    = cellOf(points[i]);
+        auto& cell = cells[keys[i]];
+        for (std::size_t k{0}; k < 3; ++k)
+        {
+            cell.sum[k] += points[i][k];
+        }
+        ++cell.count;
+    }
+
+    for (std::size_t i{0}; i < points.size(); ++i)
+    {
+        auto& cell = cells[keys[i]];
+        Vec3 centre{cell.sum[0] / cell.count,
+                    cell.sum[1] / cell.count,
+                    cell.sum[2] / cell.count};
+        auto offset   = subtract(points[i], centre);
+        auto distance = dot(offset, offset);
+        if (distance < cell.distance)
+        {
+            cell.distance = distance;
+            cell.vertex   = static_cast<std::uint32_t>(i);
+        }
+    }
+
+    std::vector<std::uint32_t> result;
+    result.reserve(indices.size());
+    for (std::size_t i{0}; i + 2 < indices.size(); i += 3)
+    {
+        auto a = cells[keys[indices[i]]].vertex;
+        auto b = cells[keys[indices[i + 1]]].vertex;
+        auto c = cells[keys[indices[i + 2]]].vertex;
+        if (a != b && b != c && a != c)
+        {
+            result.insert(result.end(), {a, b, c});
+        }
+    }
+
+    return result;
+}
+
+std::vector<std::uint32_t>
+simplifyMesh(std::vector<std::uint32_t> const& indices,
+             void const* positions,
+             std::size_t positionStride,
+             std::size_t vertexCount,
+             std::size_t targetIndexCount)
+{
+    if (indices.size() <= targetIndexCount)
+    {
+        return indices;
+    }
+
+    auto bytes = static_cast<char const*>(positions);
+    std::vector<Vec3> points(vertexCount);
+    Vec3 minimum{std::numeric_limits<float>::max(),
+                 std::numeric_limits<float>::max(),
+                 std::numeric_limits<float>::max()};
+    Vec3 maximum{std::numeric_limits<float>::lowest(),
+                 std::numeric_limits<float>::lowest(),
+                 std::numeric_limits<float>::lowest()};
+    for (std::size_t i{0}; i < vertexCount; ++i)
+    {
+        std::copy_n(reinterpret_cast<float const*>(bytes + i * positionStride),
+                    3,
+                    points[i].data());
+        for (std::size_t k{0}; k < 3; ++k)
+        {
+            minimum[k] = std::min(minimum[k], points[i][k]);
+            maximum[k] = std::max(maximum[k], points[i][k]);
+        }
+    }
+
+    auto extent = std::max({maximum[0] - minimum[0],
+                            maximum[1] - minimum[1],
+                            maximum[2] - minimum[2],
+                            std::numeric_limits<float>::min()});
+
+    // Finer grids keep more triangles, so binary search for the finest one
+    // that is still under the target. A single cell keeps nothing.
+    std::vector<std::uint32_t> best;
+    std::uint32_t coarse{1};
+    std::uint32_t fine{globals::maxGridSize};
+    while (coarse + 1 < fine)
+    {
+        auto gridSize = (coarse + fine) / 2;
+        auto result   = clusterVertices(
+            indices, points, minimum, extent / static_cast<float>(gridSize));
+        if (result.size() <= targetIndexCount)
+        {
+            coarse = gridSize;
+            best   = std::move(result);
+        }
+        else
+        {
+            fine = gridSize;
+        }
+    }
+
+    return best;
+}
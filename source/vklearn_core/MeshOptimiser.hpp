@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// Reorders the triangles in the index list so that consecutive triangles
+// share as many vertices as possible, which keeps the post-transform cache
+// warm. This is Tom Forsyth's linear-speed vertex cache optimisation.
+void optimiseVertexCache(std::vector<std::uint32_t>& indices,
+                         std::size_t vertexCount);
+
+// Average number of vertex shader invocations per triangle for a FIFO cache
+// of the given size. 0.5 is the best possible, 3 is no reuse at all.
+float computeACMR(std::vector<std::uint32_t> const& indices,
+                  std::size_t vertexCount,
+                  std::size_t cacheSize = 32);
+
+// A cluster of consecutive triangles in the index list. The bounds are in
+// model space, and the cone contains the normals of every triangle so that the
+// whole cluster can be rejected when it faces away from the camera. The layout
+// matches std430 so the array can be read directly by a shader.
+struct Meshlet
+{
+    float centre[3];
+    float radius;
+    float coneAxis[3];
+    float coneCutoff;
+    std::uint32_t firstIndex;
+    std::uint32_t indexCount;
+    std::uint32_t padding[2];
+};
+
+// One level of detail of a mesh. Every level indexes the same vertices, and
+// its triangles and meshlets are contiguous ranges of the shared index and
+// meshlet arrays. The layout matches std430 so the array can be read directly
+// by a shader.
+struct MeshLod
+{
+    std::uint32_t firstIndex;
+    std::uint32_t indexCount;
+    std::uint32_t firstMeshlet;
+    std::uint32_t meshletCount;
+};
+
+// Simplifies the mesh by snapping its vertices to a uniform grid, keeping one
+// vertex per cell and dropping the triangles that collapse. The grid is made
+// as fine as it can be while the result has at most targetIndexCount
+// indices. The indices refer to the original vertices, so every level of
+// detail can share the vertex buffer. Positions are read as for
+// buildMeshlets.
+std::vector<std::uint32_t>
+simplifyMesh(std::vector<std::uint32_t> const& indices,
+             void const* positions,
+             std::size_t positionStride,
+             std::size_t vertexCount,
+             std::size_t targetIndexCount);
+
+// Splits the index list into meshlets of at most maxVertices unique vertices
+// and maxTriangles triangles. Triangles are taken in order, so this should
+// run after optimiseVertexCache to get compact clusters. Positions are read
+// as three floats every positionStride bytes.
+std::vector<Meshlet> buildMeshlets(std::vector<std::uint32_t> const& indices,
+                                   void const* positions,
+                                   std::size_t positionStride,
+                                   std::size_t vertexCount,
+                                   std::size_t maxVertices  = 64,
+                                   std::size_t maxTriangles = 124);
+
+// Reorders the vertices so they appear in the same order as they are first
+// referenced by the index list, which makes vertex fetches mostly linear.
+// This should run after optimiseVertexCache.
+template<typename T>
+void optimiseVertexFetch(std::vector<T>& vertices,
+                         std::vector<std::uint32_t>& indices)
+{
+    constexpr auto unused = std::numeric_limits<std::uint32_t>::max();
+    std::vector<std::uint32_t> remap(vertices.size(), unused);
+    std::vector<T> reordered;
+    reordered.reserve(vertices.size());
+
+    for (auto& index : indices)
+    {
+        if (remap[index] == unused)
+        {
+            remap[index] = static_cast<std::uint32_t>(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+
+        index = remap[index];
+    }
+
+    vertices = std::move(reordered);
+}
@@ -0,0 +1,94 @@
+#include "PipelineCache.hpp"
+
+#include <fmt/printf.h>
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+// Layout of VK_PIPELINE_CACHE_HEADER_VERSION_ONE, which every driver has to
+// write at the start of the cache data.
+struct PipelineCacheHeader
+{
+    std::uint32_t headerSize;
+    std::uint32_t headerVersion;
+    std::uint32_t vendorID;
+    std::uint32_t deviceID;
+    std::uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+};
+
+static std::vector<char> readCacheFile(std::string const& filename)
+{
+    std::ifstream file{filename, std::ios::ate | std::ios::binary};
+    if (!file.is_open())
+    {
+        return {};
+    }
+
+    std::vector<char> data(static_cast<std::size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(data.data(), data.size());
+    return data;
+}
+
+static bool isCacheCompatible(std::vector<char> const& data,
+                              vk::PhysicalDeviceProperties const& properties)
+{
+    if (data.size() < sizeof(PipelineCacheHeader))
+    {
+        return false;
+    }
+
+    PipelineCacheHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    return header.headerSize >= sizeof(PipelineCacheHeader) &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == properties.vendorID &&
+           header.deviceID == properties.deviceID &&
+           std::memcmp(header.pipelineCacheUUID,
+                       properties.pipelineCacheUUID,
+                       VK_UUID_SIZE) == 0;
+}
+
+void PipelineCache::init(vk::PhysicalDevice const& physicalDevice,
+                         vk::Device const& device,
+                         std::string const& filename)
+{
+    mDevice   = device;
+    mFilename = filename;
+
+    auto data = readCacheFile(filename);
+    if (!data.empty() &&
+        !isCacheCompatible(data, physicalDevice.getProperties()))
+    {
+        fmt::print("warning: discarding stale pipeline cache {}.\n", filename);
+        data.clear();
+    }
+
+    vk::PipelineCacheCreateInfo createInfo;
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData    = data.data();
+
+    mCache = mDevice.createPipelineCacheUnique(createInfo);
+}
+
+vk::PipelineCache PipelineCache::get() const
+{
+    return *mCache;
+}
+
+bool PipelineCache::save() const
+{
+    auto data = mDevice.getPipelineCacheData(*mCache);
+
+    std::ofstream file{mFilename, std::ios::binary | std::ios::trunc};
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    file.write(reinterpret_cast<char const*>(data.data()),
+               static_cast<std::streamsize>(data.size()));
+    return file.good();
+}
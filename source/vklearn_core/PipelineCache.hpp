@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <string>
+
+// Wraps a vk::PipelineCache that is seeded from disk. The stored blob is only
+// handed to the driver if its header matches the current device, since a
+// cache from another driver or GPU is useless at best.
+class PipelineCache
+{
+public:
+    void init(vk::PhysicalDevice const& physicalDevice,
+              vk::Device const& device,
+              std::string const& filename);
+
+    vk::PipelineCache get() const;
+    bool save() const;
+
+private:
+    vk::Device mDevice;
+    std::string mFilename;
+    vk::UniquePipelineCache mCache;
+};
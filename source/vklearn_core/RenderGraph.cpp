@@ -0,0 +1,917 @@
+#include "RenderGraph.hpp"
+#include "VulkanHelpers.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+// What a usage is synchronised as. Only the writes have to be made
+// available to whatever comes next, reads just have to have finished.
+struct UsageInfo
+{
+    vk::PipelineStageFlags stages;
+    vk::AccessFlags access;
+    vk::AccessFlags writes;
+    vk::ImageLayout layout;
+};
+
+static UsageInfo getUsageInfo(ResourceUsage usage)
+{
+    using Stage  = vk::PipelineStageFlagBits;
+    using Access = vk::AccessFlagBits;
+    using Layout = vk::ImageLayout;
+
+    switch (usage)
+    {
+    case ResourceUsage::eTransferWrite:
+        return {Stage::eTransfer,
+                Access::eTransferWrite,
+                Access::eTransferWrite,
+                Layout::eTransferDstOptimal};
+
+    case ResourceUsage::eTransferRead:
+        return {Stage::eTransfer,
+                Access::eTransferRead,
+                {},
+                Layout::eTransferSrcOptimal};
+
+    case ResourceUsage::eComputeRead:
+        return {Stage::eComputeShader,
+                Access::eShaderRead,
+                {},
+                Layout::eGeneral};
+
+    case ResourceUsage::eComputeWrite:
+        return {Stage::eComputeShader,
+                Access::eShaderRead | Access::eShaderWrite,
+                Access::eShaderWrite,
+                Layout::eGeneral};
+
+    case ResourceUsage::eIndirectRead:
+        return {Stage::eDrawIndirect,
+                Access::eIndirectCommandRead,
+                {},
+                Layout::eUndefined};
+
+    case ResourceUsage::eSampled:
+        return {Stage::eFragmentShader,
+                Access::eShaderRead,
+                {},
+                Layout::eShaderReadOnlyOptimal};
+
+    case ResourceUsage::eColourAttachment:
+        return {Stage::eColorAttachmentOutput,
+                Access::eColorAttachmentRead | Access::eColorAttachmentWrite,
+                Access::eColorAttachmentWrite,
+                Layout::eColorAttachmentOptimal};
+
+    case ResourceUsage::eDepthAttachment:
+        return {Stage::eEarlyFragmentTests | Stage::eLateFragmentTests,
+                Access::eDepthStencilAttachmentRead |
+                    Access::eDepthStencilAttachmentWrite,
+                Access::eDepthStencilAttachmentWrite,
+                Layout::eDepthStencilAttachmentOptimal};
+
+    case ResourceUsage::eResolveAttachment:
+        return {Stage::eColorAttachmentOutput,
+                Access::eColorAttachmentWrite,
+                Access::eColorAttachmentWrite,
+                Layout::eColorAttachmentOptimal};
+
+    // Presenting is waited on by the acquire semaphore, which in turn is
+    // waited on at the colour output stage, so that is what to chain onto.
+    case ResourceUsage::ePresent:
+        return {Stage::eColorAttachmentOutput,
+                {},
+                {},
+                Layout::ePresentSrcKHR};
+
+    default:
+        throw std::runtime_error{"error: unknown resource usage."};
+    }
+}
+
+static bool isAttachment(ResourceUsage usage)
+{
+    return usage == ResourceUsage::eColourAttachment ||
+           usage == ResourceUsage::eDepthAttachment ||
+           usage == ResourceUsage::eResolveAttachment;
+}
+
+static bool isDepthFormat(vk::Format format)
+{
+    return format == vk::Format::eD16Unorm ||
+           format == vk::Format::eX8D24UnormPack32 ||
+           format == vk::Format::eD32Sfloat ||
+           core::hasStencilComponent(format) ||
+           format == vk::Format::eD16UnormS8Uint;
+}
+
+static vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+RenderGraph::Handle RenderGraph::importImage(vk::Format format,
+                                             vk::SampleCountFlagBits samples)
+{
+    Resource resource;
+    resource.isImage = true;
+    resource.format  = format;
+    resource.samples = samples;
+    mResources.push_back(std::move(resource));
+    return static_cast<Handle>(mResources.size() - 1);
+}
+
+RenderGraph::Handle RenderGraph::importBuffer(bool isFrameLocal)
+{
+    Resource resource;
+    resource.isFrameLocal = isFrameLocal;
+    mResources.push_back(std::move(resource));
+    return static_cast<Handle>(mResources.size() - 1);
+}
+
+RenderGraph::Handle RenderGraph::createImage(vk::Format format,
+                                             vk::SampleCountFlagBits samples)
+{
+    Resource resource;
+    resource.isImage     = true;
+    resource.isTransient = true;
+    resource.format      = format;
+    resource.samples     = samples;
+    mResources.push_back(std::move(resource));
+    return static_cast<Handle>(mResources.size() - 1);
+}
+
+void RenderGraph::setImages(Handle image,
+                            std::vector<vk::Image> const& images,
+                            std::vector<vk::ImageView> const& views)
+{
+    auto& resource = mResources[image];
+    if (!resource.isImage || resource.isTransient)
+    {
+        throw std::runtime_error{"error: only imported images can be set."};
+    }
+
+    resource.images = images;
+    resource.views  = views;
+}
+
+void RenderGraph::setClearValue(Handle image, vk::ClearValue const& value)
+{
+    mResources[image].clearValue = value;
+}
+
+void RenderGraph::setFinalUsage(Handle image, ResourceUsage usage)
+{
+    mResources[image].finalUsage = usage;
+}
+
+RenderGraph::Handle
+RenderGraph::addPass(char const* name,
+                     bool isGraphics,
+                     std::function<void(PassContext const&)> record)
+{
+    Pass pass;
+    pass.name       = name;
+    pass.isGraphics = isGraphics;
+    pass.record     = std::move(record);
+    mPasses.push_back(std::move(pass));
+    return static_cast<Handle>(mPasses.size() - 1);
+}
+
+void RenderGraph::use(Handle pass, Handle resource, ResourceUsage usage)
+{
+    auto& uses = mResources[resource].uses;
+    if (!uses.empty() && uses.back().pass >= pass)
+    {
+        throw std::runtime_error{
+            "error: resources must be used in pass order, once per pass."};
+    }
+
+    uses.push_back({pass, usage});
+}
+
+void RenderGraph::setSubpassContents(Handle pass,
+                                     vk::SubpassContents contents)
+{
+    mPasses[pass].contents = contents;
+}
+
+void RenderGraph::compile(vk::Device const& device,
+                          MemoryAllocator& allocator,
+                          DeletionQueue& deletionQueue,
+                          vk::Extent2D const& extent)
+{
+    // Frames in flight may still be using the old objects.
+    retire(deletionQueue);
+    mExtent = extent;
+
+    // Only render passes have somewhere to fold the final transition into.
+    for (auto const& resource : mResources)
+    {
+        if (resource.finalUsage && !resource.uses.empty() &&
+            !isAttachment(resource.uses.back().usage))
+        {
+            throw std::runtime_error{
+                "error: final usages are only supported after attachments."};
+        }
+    }
+
+    allocateTransients(device, allocator, extent);
+    for (Handle i{0}; i < mPasses.size(); ++i)
+    {
+        auto& pass = mPasses[i];
+        buildBarriers(pass, i);
+        if (pass.isGraphics)
+        {
+            buildRenderPass(device, pass, i);
+            buildFramebuffers(device, pass, extent);
+        }
+    }
+}
+
+void RenderGraph::clear(DeletionQueue& deletionQueue)
+{
+    retire(deletionQueue);
+    mResources.clear();
+    mPasses.clear();
+}
+
+void RenderGraph::execute(PassContext context,
+                          GpuProfiler& profiler,
+                          std::uint32_t slot) const
+{
+    auto commandBuffer = context.commandBuffer;
+    for (auto const& pass : mPasses)
+    {
+        auto scope = profiler.beginScope(commandBuffer, slot, pass.name);
+
+        if (pass.hasMemoryBarrier || !pass.transitions.empty())
+        {
+            std::vector<vk::MemoryBarrier> memoryBarriers;
+            if (pass.hasMemoryBarrier)
+            {
+                vk::MemoryBarrier barrier;
+                barrier.srcAccessMask = pass.srcAccess;
+                barrier.dstAccessMask = pass.dstAccess;
+                memoryBarriers.push_back(barrier);
+            }
+
+            std::vector<vk::ImageMemoryBarrier> imageBarriers;
+            for (auto const& transition : pass.transitions)
+            {
+                auto const& resource = mResources[transition.resource];
+
+                vk::ImageMemoryBarrier barrier;
+                barrier.oldLayout           = transition.oldLayout;
+                barrier.newLayout           = transition.newLayout;
+                barrier.srcAccessMask       = transition.srcAccess;
+                barrier.dstAccessMask       = transition.dstAccess;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.image =
+                    (resource.isTransient)
+                        ? *resource.image
+                        : resource.images[(resource.images.size() == 1)
+                                              ? 0
+                                              : context.imageIndex];
+
+                barrier.subresourceRange.aspectMask =
+                    vk::ImageAspectFlagBits::eColor;
+                if (isDepthFormat(resource.format))
+                {
+                    barrier.subresourceRange.aspectMask =
+                        vk::ImageAspectFlagBits::eDepth;
+                    if (core::hasStencilComponent(resource.format))
+                    {
+                        barrier.subresourceRange.aspectMask |=
+                            vk::ImageAspectFlagBits::eStencil;
+                    }
+                }
+                barrier.subresourceRange.baseMipLevel   = 0;
+                barrier.subresourceRange.levelCount     = 1;
+                barrier.subresourceRange.baseArrayLayer = 0;
+                barrier.subresourceRange.layerCount     = 1;
+                imageBarriers.push_back(barrier);
+            }
+
+            commandBuffer.pipelineBarrier(pass.srcStages,
+                                          pass.dstStages,
+                                          {},
+                                          memoryBarriers,
+                                          {},
+                                          imageBarriers);
+        }
+
+        auto passContext = context;
+        if (pass.isGraphics)
+        {
+            auto framebuffer =
+                *pass.framebuffers[(pass.framebuffers.size() == 1)
+                                       ? 0
+                                       : context.imageIndex];
+
+            vk::RenderPassBeginInfo renderPassInfo;
+            renderPassInfo.renderPass  = *pass.renderPass;
+            renderPassInfo.framebuffer = framebuffer;
+            renderPassInfo.renderArea  = vk::Rect2D{{0, 0}, mExtent};
+            renderPassInfo.clearValueCount =
+                static_cast<std::uint32_t>(pass.clearValues.size());
+            renderPassInfo.pClearValues = pass.clearValues.data();
+
+            passContext.renderPass  = *pass.renderPass;
+            passContext.framebuffer = framebuffer;
+            passContext.contents    = pass.contents;
+            commandBuffer.beginRenderPass(&renderPassInfo, pass.contents);
+            pass.record(passContext);
+            commandBuffer.endRenderPass();
+        }
+        else
+        {
+            pass.record(passContext);
+        }
+
+        profiler.endScope(commandBuffer, slot, scope);
+    }
+}
+
+vk::RenderPass RenderGraph::getRenderPass(Handle pass) const
+{
+    return *mPasses[pass].renderPass;
+}
+
+std::size_t RenderGraph::getBarrierCount() const
+{
+    return static_cast<std::size_t>(
+        std::count_if(mPasses.begin(), mPasses.end(), [](Pass const& pass) {
+            return pass.hasMemoryBarrier || !pass.transitions.empty();
+        }));
+}
+
+vk::DeviceSize RenderGraph::getTransientSize() const
+{
+    return mTransientSize;
+}
+
+vk::DeviceSize RenderGraph::getAliasedSize() const
+{
+    return mAliasedSize;
+}
+
+std::vector<ResourceUsage> RenderGraph::getPrevious(Handle resource,
+                                                    Handle pass) const
+{
+    auto const& res  = mResources[resource];
+    auto const& uses = res.uses;
+    auto it = std::find_if(uses.begin(), uses.end(), [pass](Use const& use) {
+        return use.pass == pass;
+    });
+    if (it != uses.begin())
+    {
+        return {std::prev(it)->usage};
+    }
+
+    // The first use in a frame comes after the last one of the frame before,
+    // or after whatever last used the same memory for transients.
+    if (res.isFrameLocal)
+    {
+        return {};
+    }
+
+    if (res.finalUsage)
+    {
+        return {*res.finalUsage};
+    }
+
+    if (!res.isTransient)
+    {
+        return {uses.back().usage};
+    }
+
+    std::vector<ResourceUsage> previous;
+    for (Handle other{0}; other < mResources.size(); ++other)
+    {
+        if (isAliased(resource, other))
+        {
+            previous.push_back(mResources[other].uses.back().usage);
+        }
+    }
+    return previous;
+}
+
+std::optional<ResourceUsage> RenderGraph::getNext(Handle resource,
+                                                  Handle pass) const
+{
+    auto const& uses = mResources[resource].uses;
+    auto it = std::find_if(uses.begin(), uses.end(), [pass](Use const& use) {
+        return use.pass > pass;
+    });
+    if (it == uses.end())
+    {
+        return {};
+    }
+
+    return it->usage;
+}
+
+bool RenderGraph::isFirstUse(Handle resource, Handle pass) const
+{
+    auto const& uses = mResources[resource].uses;
+    return !uses.empty() && uses.front().pass == pass;
+}
+
+bool RenderGraph::isAliased(Handle resource, Handle other) const
+{
+    auto const& a = mResources[resource];
+    auto const& b = mResources[other];
+    if (a.uses.empty() || b.uses.empty())
+    {
+        return false;
+    }
+
+    if (resource == other)
+    {
+        return true;
+    }
+
+    return a.isTransient && b.isTransient && a.allocation == b.allocation &&
+           a.offset < b.offset + b.requirements.size &&
+           b.offset < a.offset + a.requirements.size;
+}
+
+void RenderGraph::retire(DeletionQueue& deletionQueue)
+{
+    for (auto& pass : mPasses)
+    {
+        deletionQueue.retire(std::move(pass.renderPass));
+        for (auto& framebuffer : pass.framebuffers)
+        {
+            deletionQueue.retire(std::move(framebuffer));
+        }
+        pass.framebuffers.clear();
+    }
+
+    for (auto& resource : mResources)
+    {
+        deletionQueue.retire(std::move(resource.view));
+        deletionQueue.retire(std::move(resource.image));
+    }
+
+    for (auto const& allocation : mAllocations)
+    {
+        deletionQueue.retire(allocation);
+    }
+    mAllocations.clear();
+
+    mTransientSize = 0;
+    mAliasedSize   = 0;
+}
+
+void RenderGraph::allocateTransients(vk::Device const& device,
+                                     MemoryAllocator& allocator,
+                                     vk::Extent2D const& extent)
+{
+    std::vector<Handle> transients;
+    std::uint32_t memoryTypeBits{~0u};
+    bool isLazy{true};
+    for (Handle i{0}; i < mResources.size(); ++i)
+    {
+        auto& resource = mResources[i];
+        if (!resource.isTransient || resource.uses.empty())
+        {
+            continue;
+        }
+
+        // Attachments only used by the one render pass never need to reach
+        // memory at all. Used by more than one, they are stored in between.
+        vk::ImageUsageFlags usage;
+        bool isAttachmentOnly{resource.uses.size() == 1};
+        for (auto const& use : resource.uses)
+        {
+            switch (use.usage)
+            {
+            case ResourceUsage::eTransferWrite:
+                usage |= vk::ImageUsageFlagBits::eTransferDst;
+                break;
+            case ResourceUsage::eTransferRead:
+                usage |= vk::ImageUsageFlagBits::eTransferSrc;
+                break;
+            case ResourceUsage::eComputeRead:
+            case ResourceUsage::eComputeWrite:
+                usage |= vk::ImageUsageFlagBits::eStorage;
+                break;
+            case ResourceUsage::eSampled:
+                usage |= vk::ImageUsageFlagBits::eSampled;
+                break;
+            case ResourceUsage::eColourAttachment:
+            case ResourceUsage::eResolveAttachment:
+                usage |= vk::ImageUsageFlagBits::eColorAttachment;
+                break;
+            case ResourceUsage::eDepthAttachment:
+                usage |= vk::ImageUsageFlagBits::eDepthStencilAttachment;
+                break;
+            default:
+                throw std::runtime_error{
+                    "error: unsupported usage for a transient image."};
+            }
+
+            isAttachmentOnly = isAttachmentOnly &&
+                               use.usage != ResourceUsage::eResolveAttachment &&
+                               isAttachment(use.usage);
+        }
+
+        if (isAttachmentOnly)
+        {
+            usage |= vk::ImageUsageFlagBits::eTransientAttachment;
+        }
+        isLazy = isLazy && isAttachmentOnly;
+
+        auto imageInfo = core::getImageCreateInfo(extent.width,
+                                                  extent.height,
+                                                  1,
+                                                  resource.samples,
+                                                  resource.format,
+                                                  vk::ImageTiling::eOptimal,
+                                                  usage);
+        resource.image = device.createImageUnique(imageInfo);
+        resource.requirements =
+            device.getImageMemoryRequirements(*resource.image);
+
+        memoryTypeBits &= resource.requirements.memoryTypeBits;
+        mTransientSize += resource.requirements.size;
+        transients.push_back(i);
+    }
+
+    auto getProperties = [&](std::uint32_t typeBits) {
+        vk::MemoryPropertyFlags properties =
+            vk::MemoryPropertyFlagBits::eDeviceLocal;
+        auto lazy = properties | vk::MemoryPropertyFlagBits::eLazilyAllocated;
+        if (isLazy && allocator.hasMemoryType(typeBits, lazy))
+        {
+            return lazy;
+        }
+        return properties;
+    };
+
+    if (memoryTypeBits == 0)
+    {
+        // Nothing to share memory with, every image gets its own.
+        for (auto i : transients)
+        {
+            auto& resource      = mResources[i];
+            resource.allocation = mAllocations.size();
+            resource.offset     = 0;
+            mAllocations.push_back(allocator.allocate(
+                resource.requirements,
+                getProperties(resource.requirements.memoryTypeBits),
+                false));
+        }
+        mAliasedSize = mTransientSize;
+    }
+    else if (!transients.empty())
+    {
+        // Largest first, each at the lowest offset that doesn't overlap
+        // anything already placed that is used by any of the same passes.
+        std::sort(transients.begin(),
+                  transients.end(),
+                  [this](Handle a, Handle b) {
+                      return mResources[a].requirements.size >
+                             mResources[b].requirements.size;
+                  });
+
+        vk::MemoryRequirements requirements;
+        requirements.size           = 0;
+        requirements.alignment      = 1;
+        requirements.memoryTypeBits = memoryTypeBits;
+        for (std::size_t i{0}; i < transients.size(); ++i)
+        {
+            auto& resource = mResources[transients[i]];
+            auto first     = resource.uses.front().pass;
+            auto last      = resource.uses.back().pass;
+            auto size      = resource.requirements.size;
+
+            vk::DeviceSize offset{0};
+            for (bool isMoved{true}; isMoved;)
+            {
+                isMoved = false;
+                for (std::size_t j{0}; j < i; ++j)
+                {
+                    auto const& placed = mResources[transients[j]];
+                    auto end = placed.offset + placed.requirements.size;
+                    if (first <= placed.uses.back().pass &&
+                        placed.uses.front().pass <= last &&
+                        offset < end && placed.offset < offset + size)
+                    {
+                        offset  = alignUp(end, resource.requirements.alignment);
+                        isMoved = true;
+                    }
+                }
+            }
+
+            resource.allocation = 0;
+            resource.offset     = offset;
+            requirements.size   = std::max(requirements.size, offset + size);
+            requirements.alignment = std::max(requirements.alignment,
+                                              resource.requirements.alignment);
+        }
+
+        mAllocations.push_back(allocator.allocate(
+            requirements, getProperties(memoryTypeBits), false));
+        mAliasedSize = requirements.size;
+    }
+
+    for (auto i : transients)
+    {
+        auto& resource          = mResources[i];
+        auto const& allocation  = mAllocations[resource.allocation];
+        device.bindImageMemory(*resource.image,
+                               allocation.memory,
+                               allocation.offset + resource.offset);
+
+        auto aspect = isDepthFormat(resource.format)
+                          ? vk::ImageAspectFlagBits::eDepth
+                          : vk::ImageAspectFlagBits::eColor;
+        resource.view = vk::UniqueImageView(
+            core::createImageView(
+                device, *resource.image, resource.format, aspect, 1),
+            device);
+    }
+}
+
+void RenderGraph::buildBarriers(Pass& pass, Handle passHandle)
+{
+    pass.hasMemoryBarrier = false;
+    pass.srcStages        = {};
+    pass.dstStages        = {};
+    pass.srcAccess        = {};
+    pass.dstAccess        = {};
+    pass.transitions.clear();
+
+    for (Handle i{0}; i < mResources.size(); ++i)
+    {
+        auto const& resource = mResources[i];
+        auto use             = std::find_if(
+            resource.uses.begin(),
+            resource.uses.end(),
+            [passHandle](Use const& candidate) {
+                return candidate.pass == passHandle;
+            });
+
+        // Attachments are synchronised by the render pass itself.
+        if (use == resource.uses.end() ||
+            (pass.isGraphics && isAttachment(use->usage)))
+        {
+            continue;
+        }
+
+        auto info     = getUsageInfo(use->usage);
+        auto previous = getPrevious(i, passHandle);
+
+        // Images don't keep their contents from one frame to the next.
+        auto oldLayout = vk::ImageLayout::eUndefined;
+        if (!isFirstUse(i, passHandle))
+        {
+            oldLayout = getUsageInfo(previous.front()).layout;
+        }
+
+        bool hasTransition = resource.isImage && oldLayout != info.layout;
+        bool isHazard      = hasTransition || info.writes;
+        vk::PipelineStageFlags srcStages;
+        vk::AccessFlags srcAccess;
+        for (auto usage : previous)
+        {
+            auto previousInfo = getUsageInfo(usage);
+            srcStages |= previousInfo.stages;
+            srcAccess |= previousInfo.writes;
+            isHazard = isHazard || previousInfo.writes;
+        }
+
+        // Reads after reads need nothing, and neither does anything that
+        // has nothing before it, short of a layout transition.
+        if (!isHazard || (previous.empty() && !hasTransition))
+        {
+            continue;
+        }
+
+        if (!srcStages)
+        {
+            srcStages = vk::PipelineStageFlagBits::eTopOfPipe;
+        }
+
+        pass.srcStages |= srcStages;
+        pass.dstStages |= info.stages;
+        if (resource.isImage)
+        {
+            pass.transitions.push_back(
+                {i, oldLayout, info.layout, srcAccess, info.access});
+        }
+        else
+        {
+            pass.hasMemoryBarrier = true;
+            pass.srcAccess |= srcAccess;
+            pass.dstAccess |= info.access;
+        }
+    }
+}
+
+void RenderGraph::buildRenderPass(vk::Device const& device,
+                                  Pass& pass,
+                                  Handle passHandle)
+{
+    pass.attachments.clear();
+    pass.clearValues.clear();
+
+    std::vector<vk::AttachmentDescription> descriptions;
+    std::vector<vk::AttachmentReference> colourRefs;
+    std::vector<vk::AttachmentReference> resolveRefs;
+    std::optional<vk::AttachmentReference> depthRef;
+
+    vk::SubpassDependency incoming;
+    incoming.srcSubpass = VK_SUBPASS_EXTERNAL;
+    incoming.dstSubpass = 0;
+
+    vk::SubpassDependency outgoing;
+    outgoing.srcSubpass = 0;
+    outgoing.dstSubpass = VK_SUBPASS_EXTERNAL;
+
+    for (Handle i{0}; i < mResources.size(); ++i)
+    {
+        auto const& resource = mResources[i];
+        auto use             = std::find_if(
+            resource.uses.begin(),
+            resource.uses.end(),
+            [passHandle](Use const& candidate) {
+                return candidate.pass == passHandle;
+            });
+        if (use == resource.uses.end() || !isAttachment(use->usage))
+        {
+            continue;
+        }
+
+        auto info     = getUsageInfo(use->usage);
+        auto previous = getPrevious(i, passHandle);
+        auto next     = getNext(i, passHandle);
+        bool isFirst  = isFirstUse(i, passHandle);
+
+        // Resolves overwrite every pixel, so they never need to load.
+        vk::AttachmentDescription description;
+        description.format  = resource.format;
+        description.samples = resource.samples;
+        description.loadOp  = vk::AttachmentLoadOp::eLoad;
+        if (isFirst || use->usage == ResourceUsage::eResolveAttachment)
+        {
+            description.loadOp = (resource.clearValue && isFirst)
+                                     ? vk::AttachmentLoadOp::eClear
+                                     : vk::AttachmentLoadOp::eDontCare;
+        }
+        description.storeOp = (next || resource.finalUsage)
+                                  ? vk::AttachmentStoreOp::eStore
+                                  : vk::AttachmentStoreOp::eDontCare;
+        description.stencilLoadOp  = vk::AttachmentLoadOp::eDontCare;
+        description.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+        description.initialLayout =
+            (isFirst) ? vk::ImageLayout::eUndefined
+                      : getUsageInfo(previous.front()).layout;
+        description.finalLayout = info.layout;
+
+        for (auto usage : previous)
+        {
+            auto previousInfo = getUsageInfo(usage);
+            incoming.srcStageMask |= previousInfo.stages;
+            incoming.srcAccessMask |= previousInfo.writes;
+        }
+        if (!previous.empty())
+        {
+            incoming.dstStageMask |= info.stages;
+            incoming.dstAccessMask |= info.access;
+        }
+
+        // Presenting needs no dependency of its own, the implicit one at
+        // the end of the render pass already covers it.
+        if (!next && resource.finalUsage)
+        {
+            auto finalInfo          = getUsageInfo(*resource.finalUsage);
+            description.finalLayout = finalInfo.layout;
+            if (*resource.finalUsage != ResourceUsage::ePresent)
+            {
+                outgoing.srcStageMask |= info.stages;
+                outgoing.srcAccessMask |= info.writes;
+                outgoing.dstStageMask |= finalInfo.stages;
+                outgoing.dstAccessMask |= finalInfo.access;
+            }
+        }
+
+        vk::AttachmentReference reference;
+        reference.attachment = static_cast<std::uint32_t>(descriptions.size());
+        reference.layout     = info.layout;
+        switch (use->usage)
+        {
+        case ResourceUsage::eColourAttachment:
+            colourRefs.push_back(reference);
+            break;
+        case ResourceUsage::eResolveAttachment:
+            resolveRefs.push_back(reference);
+            break;
+        default:
+            depthRef = reference;
+            break;
+        }
+
+        descriptions.push_back(description);
+        pass.attachments.push_back(i);
+        pass.clearValues.push_back(resource.clearValue.value_or(
+            vk::ClearValue{}));
+    }
+
+    // Attachments are in the order their resources were declared, which is
+    // also how resolves pair up with colour attachments.
+    if (resolveRefs.size() > colourRefs.size())
+    {
+        throw std::runtime_error{
+            "error: more resolve attachments than colour attachments."};
+    }
+
+    vk::SubpassDescription subPass;
+    subPass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+    subPass.colorAttachmentCount =
+        static_cast<std::uint32_t>(colourRefs.size());
+    subPass.pColorAttachments = colourRefs.data();
+    if (!resolveRefs.empty())
+    {
+        resolveRefs.resize(colourRefs.size(),
+                           {VK_ATTACHMENT_UNUSED, vk::ImageLayout::eUndefined});
+        subPass.pResolveAttachments = resolveRefs.data();
+    }
+    if (depthRef)
+    {
+        subPass.pDepthStencilAttachment = &*depthRef;
+    }
+
+    std::vector<vk::SubpassDependency> dependencies;
+    if (incoming.srcStageMask)
+    {
+        dependencies.push_back(incoming);
+    }
+    if (outgoing.srcStageMask)
+    {
+        dependencies.push_back(outgoing);
+    }
+
+    vk::RenderPassCreateInfo createInfo;
+    createInfo.attachmentCount =
+        static_cast<std::uint32_t>(descriptions.size());
+    createInfo.pAttachments = descriptions.data();
+    createInfo.subpassCount = 1;
+    createInfo.pSubpasses   = &subPass;
+    createInfo.dependencyCount =
+        static_cast<std::uint32_t>(dependencies.size());
+    createInfo.pDependencies = dependencies.data();
+
+    pass.renderPass = device.createRenderPassUnique(createInfo);
+}
+
+void RenderGraph::buildFramebuffers(vk::Device const& device,
+                                    Pass& pass,
+                                    vk::Extent2D const& extent)
+{
+    // One framebuffer per view of whichever imported images are attached.
+    std::size_t count{1};
+    for (auto i : pass.attachments)
+    {
+        auto const& resource = mResources[i];
+        if (resource.isTransient)
+        {
+            continue;
+        }
+
+        if (resource.views.empty())
+        {
+            throw std::runtime_error{"error: imported image has no views."};
+        }
+        count = std::max(count, resource.views.size());
+    }
+
+    for (std::size_t i{0}; i < count; ++i)
+    {
+        std::vector<vk::ImageView> views;
+        for (auto attachment : pass.attachments)
+        {
+            auto const& resource = mResources[attachment];
+            views.push_back((resource.isTransient)
+                                ? *resource.view
+                                : resource.views[i % resource.views.size()]);
+        }
+
+        vk::FramebufferCreateInfo createInfo;
+        createInfo.renderPass = *pass.renderPass;
+        createInfo.attachmentCount =
+            static_cast<std::uint32_t>(views.size());
+        createInfo.pAttachments = views.data();
+        createInfo.width        = extent.width;
+        createInfo.height       = extent.height;
+        createInfo.layers       = 1;
+
+        pass.framebuffers.push_back(device.createFramebufferUnique(createInfo));
+    }
+}
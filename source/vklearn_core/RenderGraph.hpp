@@ -0,0 +1,193 @@
+#pragma once
+
+#include "DeletionQueue.hpp"
+#include "GpuProfiler.hpp"
+#include "MemoryAllocator.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+// How a pass uses a resource. Each one stands for the stages, access and,
+// for images, the layout that the graph synchronises with.
+enum class ResourceUsage
+{
+    eTransferWrite,
+    eTransferRead,
+    eComputeRead,
+    eComputeWrite,
+    eIndirectRead,
+    eSampled,
+    eColourAttachment,
+    eDepthAttachment,
+    eResolveAttachment,
+    ePresent,
+};
+
+// Everything a pass records with. The render pass, framebuffer and contents
+// are only set for graphics passes, where they are what secondaries inherit.
+struct PassContext
+{
+    vk::CommandBuffer commandBuffer;
+    std::size_t frame{0};
+    std::uint32_t imageIndex{0};
+    vk::RenderPass renderPass;
+    vk::Framebuffer framebuffer;
+    vk::SubpassContents contents{vk::SubpassContents::eInline};
+};
+
+// A frame described as passes and the resources each of them uses, in the
+// order they run. Compiling it derives everything the passes would
+// otherwise have had to get right by hand:
+//
+// * A pipeline barrier before each pass with only the dependencies it has,
+//   on whatever used each of its resources last. Buffers only need memory
+//   barriers, so those are merged into one.
+// * A render pass per graphics pass, with load and store ops from whether
+//   an attachment is used before or after it, layout transitions folded
+//   into the attachment layouts and the dependencies into the subpass.
+// * Memory for the transient images. Those whose passes don't overlap share
+//   memory, and their first use waits for whatever used it before.
+//
+// The same frame runs over and over, so a resource's first use in a frame
+// depends on its last use in the one before. Frame local resources have a
+// copy per frame in flight and so have nothing to wait for, and imported
+// images start from their final usage, such as being presented.
+class RenderGraph
+{
+public:
+    using Handle = std::uint32_t;
+
+    // Imported images get one image and view per swap chain image.
+    Handle importImage(vk::Format format, vk::SampleCountFlagBits samples);
+    Handle importBuffer(bool isFrameLocal);
+    Handle createImage(vk::Format format, vk::SampleCountFlagBits samples);
+
+    void setImages(Handle image,
+                   std::vector<vk::Image> const& images,
+                   std::vector<vk::ImageView> const& views);
+    void setClearValue(Handle image, vk::ClearValue const& value);
+    void setFinalUsage(Handle image, ResourceUsage usage);
+
+    // The name is also the profiler scope, so it has to outlive the graph.
+    Handle addPass(char const* name,
+                   bool isGraphics,
+                   std::function<void(PassContext const&)> record);
+    void use(Handle pass, Handle resource, ResourceUsage usage);
+
+    // Graphics passes record inline unless told otherwise. This can change
+    // from frame to frame.
+    void setSubpassContents(Handle pass, vk::SubpassContents contents);
+
+    // Builds the render passes, transient images and framebuffers for the
+    // given extent. Compiling again retires the old ones.
+    void compile(vk::Device const& device,
+                 MemoryAllocator& allocator,
+                 DeletionQueue& deletionQueue,
+                 vk::Extent2D const& extent);
+
+    // Retires everything and forgets all passes and resources, so the graph
+    // can be set up again.
+    void clear(DeletionQueue& deletionQueue);
+
+    void execute(PassContext context,
+                 GpuProfiler& profiler,
+                 std::uint32_t slot) const;
+
+    vk::RenderPass getRenderPass(Handle pass) const;
+
+    std::size_t getBarrierCount() const;
+    vk::DeviceSize getTransientSize() const;
+    vk::DeviceSize getAliasedSize() const;
+
+private:
+    struct Use
+    {
+        Handle pass;
+        ResourceUsage usage;
+    };
+
+    struct Resource
+    {
+        bool isImage{false};
+        bool isTransient{false};
+        bool isFrameLocal{false};
+        vk::Format format{vk::Format::eUndefined};
+        vk::SampleCountFlagBits samples{vk::SampleCountFlagBits::e1};
+        std::optional<vk::ClearValue> clearValue;
+        std::optional<ResourceUsage> finalUsage;
+
+        // In pass order, at most one per pass.
+        std::vector<Use> uses;
+
+        std::vector<vk::Image> images;
+        std::vector<vk::ImageView> views;
+
+        // Transient images only.
+        vk::UniqueImage image;
+        vk::UniqueImageView view;
+        vk::MemoryRequirements requirements;
+        std::size_t allocation{0};
+        vk::DeviceSize offset{0};
+    };
+
+    struct ImageTransition
+    {
+        Handle resource;
+        vk::ImageLayout oldLayout;
+        vk::ImageLayout newLayout;
+        vk::AccessFlags srcAccess;
+        vk::AccessFlags dstAccess;
+    };
+
+    struct Pass
+    {
+        char const* name;
+        bool isGraphics{false};
+        std::function<void(PassContext const&)> record;
+        vk::SubpassContents contents{vk::SubpassContents::eInline};
+
+        // Buffers are all covered by one memory barrier.
+        bool hasMemoryBarrier{false};
+        vk::PipelineStageFlags srcStages;
+        vk::PipelineStageFlags dstStages;
+        vk::AccessFlags srcAccess;
+        vk::AccessFlags dstAccess;
+        std::vector<ImageTransition> transitions;
+
+        std::vector<Handle> attachments;
+        std::vector<vk::ClearValue> clearValues;
+        vk::UniqueRenderPass renderPass;
+        std::vector<vk::UniqueFramebuffer> framebuffers;
+    };
+
+    // What the resource was last used as before the given pass, across the
+    // frame boundary if need be.
+    std::vector<ResourceUsage> getPrevious(Handle resource, Handle pass) const;
+    std::optional<ResourceUsage> getNext(Handle resource, Handle pass) const;
+    bool isFirstUse(Handle resource, Handle pass) const;
+    bool isAliased(Handle resource, Handle other) const;
+
+    void allocateTransients(vk::Device const& device,
+                            MemoryAllocator& allocator,
+                            vk::Extent2D const& extent);
+    void retire(DeletionQueue& deletionQueue);
+    void buildBarriers(Pass& pass, Handle passHandle);
+    void buildRenderPass(vk::Device const& device,
+                         Pass& pass,
+                         Handle passHandle);
+    void buildFramebuffers(vk::Device const& device,
+                           Pass& pass,
+                           vk::Extent2D const& extent);
+
+    std::vector<Resource> mResources;
+    std::vector<Pass> mPasses;
+    std::vector<Allocation> mAllocations;
+    vk::Extent2D mExtent;
+
+    vk::DeviceSize mTransientSize{0};
+    vk::DeviceSize mAliasedSize{0};
+};
@@ -0,0 +1,71 @@
+#include "ShaderWatcher.hpp"
+
+#include <fmt/printf.h>
+
+#include <cstdlib>
+
+void ShaderWatcher::init(std::string const& compileFlags,
+                         std::chrono::milliseconds pollInterval)
+{
+    mCompileFlags = compileFlags;
+    mPollInterval = pollInterval;
+    mNextPoll     = std::chrono::steady_clock::now() + pollInterval;
+}
+
+void ShaderWatcher::watch(std::string const& source)
+{
+    std::error_code error;
+    auto lastWrite = std::filesystem::last_write_time(source, error);
+    if (error)
+    {
+        fmt::print("warning: unable to watch shader {}.\n", source);
+        return;
+    }
+
+    mFiles.push_back({source, lastWrite});
+}
+
+std::vector<std::string> ShaderWatcher::poll()
+{
+    std::vector<std::string> compiled;
+
+    auto now = std::chrono::steady_clock::now();
+    if (now < mNextPoll)
+    {
+        return compiled;
+    }
+    mNextPoll = now + mPollInterval;
+
+    for (auto& file : mFiles)
+    {
+        // Editors that save by replacing the file can leave it missing for a
+        // moment, so errors just mean trying again next time.
+        std::error_code error;
+        auto lastWrite = std::filesystem::last_write_time(file.source, error);
+        if (error || lastWrite == file.lastWrite)
+        {
+            continue;
+        }
+
+        file.lastWrite = lastWrite;
+        if (compile(file.source))
+        {
+            compiled.push_back(file.source);
+        }
+    }
+
+    return compiled;
+}
+
+bool ShaderWatcher::compile(std::string const& source) const
+{
+    auto command = fmt::format(
+        "glslc \"{}\" {} -o \"{}.spv\"", source, mCompileFlags, source);
+    if (std::system(command.c_str()) != 0)
+    {
+        fmt::print("warning: unable to compile shader {}.\n", source);
+        return false;
+    }
+
+    return true;
+}
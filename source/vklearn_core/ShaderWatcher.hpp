@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Watches shader sources and recompiles them with glslc when they change, so
+// edits show up without a restart. The SPIR-V goes next to the source with
+// .spv appended, which is where the build puts it as well. Timestamps are
+// only checked every poll interval, since that means a call per file.
+class ShaderWatcher
+{
+public:
+    void init(std::string const& compileFlags,
+              std::chrono::milliseconds pollInterval);
+    void watch(std::string const& source);
+
+    // Compiles every source written to since the last check and returns the
+    // ones that compiled. glslc reports the errors of the rest, and their
+    // SPIR-V is left as it was until the next change.
+    std::vector<std::string> poll();
+
+private:
+    struct WatchedFile
+    {
+        std::string source;
+        std::filesystem::file_time_type lastWrite;
+    };
+
+    bool compile(std::string const& source) const;
+
+    std::string mCompileFlags;
+    std::chrono::milliseconds mPollInterval{0};
+    std::chrono::steady_clock::time_point mNextPoll;
+    std::vector<WatchedFile> mFiles;
+};
@@ -0,0 +1,237 @@
+#include "TextureContainer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+
+namespace globals
+{
+    static constexpr std::array<std::uint8_t, 12> ktx2Identifier{
+        0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+} // namespace globals
+
+struct Ktx2Header
+{
+    std::array<std::uint8_t, 12> identifier;
+    std::uint32_t vkFormat;
+    std::uint32_t typeSize;
+    std::uint32_t pixelWidth;
+    std::uint32_t pixelHeight;
+    std::uint32_t pixelDepth;
+    std::uint32_t layerCount;
+    std::uint32_t faceCount;
+    std::uint32_t levelCount;
+    std::uint32_t supercompressionScheme;
+
+    std::uint32_t dfdByteOffset;
+    std::uint32_t dfdByteLength;
+    std::uint32_t kvdByteOffset;
+    std::uint32_t kvdByteLength;
+    std::uint64_t sgdByteOffset;
+    std::uint64_t sgdByteLength;
+};
+
+struct Ktx2Level
+{
+    std::uint64_t byteOffset;
+    std::uint64_t byteLength;
+    std::uint64_t uncompressedByteLength;
+};
+
+static_assert(sizeof(Ktx2Header) == 80, "unexpected padding in KTX2 header");
+
+bool TextureContainer::open(std::string const& filename)
+{
+    mLevels.clear();
+    if (!mFile.open(filename) || mFile.getSize() < sizeof(Ktx2Header))
+    {
+        mFile.close();
+        return false;
+    }
+
+    auto data   = static_cast<std::uint8_t const*>(mFile.getData());
+    auto header = reinterpret_cast<Ktx2Header const*>(data);
+    std::uint32_t levelCount = std::max(header->levelCount, 1u);
+
+    if (header->identifier != globals::ktx2Identifier ||
+        header->supercompressionScheme != 0 || header->pixelDepth > 1 ||
+        header->layerCount > 1 || header->faceCount != 1 ||
+        mFile.getSize() <
+            sizeof(Ktx2Header) + levelCount * sizeof(Ktx2Level))
+    {
+        mFile.close();
+        return false;
+    }
+
+    auto levels = reinterpret_cast<Ktx2Level const*>(data + sizeof(Ktx2Header));
+    for (std::uint32_t i{0}; i < levelCount; ++i)
+    {
+        if (levels[i].byteOffset + levels[i].byteLength > mFile.getSize())
+        {
+            mFile.close();
+            mLevels.clear();
+            return false;
+        }
+
+        TextureLevel level;
+        level.width  = std::max(header->pixelWidth >> i, 1u);
+        level.height = std::max(header->pixelHeight >> i, 1u);
+        level.offset = levels[i].byteOffset;
+        level.size   = levels[i].byteLength;
+        mLevels.push_back(level);
+    }
+
+    mFormat = static_cast<vk::Format>(header->vkFormat);
+    mWidth  = header->pixelWidth;
+    mHeight = header->pixelHeight;
+    return true;
+}
+
+vk::Format TextureContainer::getFormat() const
+{
+    return mFormat;
+}
+
+std::uint32_t TextureContainer::getWidth() const
+{
+    return mWidth;
+}
+
+std::uint32_t TextureContainer::getHeight() const
+{
+    return mHeight;
+}
+
+std::vector<TextureLevel> const& TextureContainer::getLevels() const
+{
+    return mLevels;
+}
+
+void const* TextureContainer::getData() const
+{
+    return mFile.getData();
+}
+
+std::size_t TextureContainer::getSize() const
+{
+    return mFile.getSize();
+}
+
+std::vector<std::vector<std::uint8_t>>
+generateMipChain(std::uint8_t const* pixels,
+                 std::uint32_t width,
+                 std::uint32_t height)
+{
+    std::vector<std::vector<std::uint8_t>> levels;
+    levels.emplace_back(pixels, pixels + width * height * 4);
+
+    while (width > 1 || height > 1)
+    {
+        auto const& src         = levels.back();
+        std::uint32_t dstWidth  = std::max(width / 2, 1u);
+        std::uint32_t dstHeight = std::max(height / 2, 1u);
+        std::vector<std::uint8_t> dst(dstWidth * dstHeight * 4);
+
+        for (std::uint32_t y{0}; y < dstHeight; ++y)
+        {
+            std::uint32_t y0 = std::min(y * 2, height - 1);
+            std::uint32_t y1 = std::min(y * 2 + 1, height - 1);
+            for (std::uint32_t x{0}; x < dstWidth; ++x)
+            {
+                std::uint32_t x0 = std::min(x * 2, width - 1);
+                std::uint32_t x1 = std::min(x * 2 + 1, width - 1);
+                for (std::uint32_t c{0}; c < 4; ++c)
+                {
+                    std::uint32_t sum = src[(y0 * width + x0) * 4 + c] +
+                                        src[(y0 * width + x1) * 4 + c] +
+                                        src[(y1 * width + x0) * 4 + c] +
+                                        src[(y1 * width + x1) * 4 + c];
+                    dst[(y * dstWidth + x) * 4 + c] =
+                        static_cast<std::uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+
+        levels.push_back(std::move(dst));
+        width  = dstWidth;
+        height = dstHeight;
+    }
+
+    return levels;
+}
+
+bool writeTextureContainer(
+    std::string const& filename,
+    std::uint32_t width,
+    std::uint32_t height,
+    std::vector<std::vector<std::uint8_t>> const& levels)
+{
+    // The data format descriptor is mandatory. This is the basic block for
+    // four 8-bit unsigned normalised channels, i.e. VK_FORMAT_R8G8B8A8_UNORM.
+    std::array<std::uint32_t, 23> dfd{};
+    dfd[0] = static_cast<std::uint32_t>(dfd.size() * sizeof(std::uint32_t));
+    dfd[1] = 0;              // vendorId = 0, descriptorType = 0
+    dfd[2] = 2 | (88 << 16); // versionNumber = 2, descriptorBlockSize = 88
+    dfd[3] = 1 | (1 << 8) | (1 << 16); // RGBSDA, BT709, linear transfer
+    dfd[4] = 0;                        // texelBlockDimension = 1x1x1x1
+    dfd[5] = 4;                        // bytesPlane0 = 4
+    dfd[6] = 0;
+    std::array<std::uint32_t, 4> channels{0, 1, 2, 15};
+    for (std::size_t i{0}; i < channels.size(); ++i)
+    {
+        auto sample = dfd.data() + 7 + i * 4;
+        sample[0]   = static_cast<std::uint32_t>(i * 8) | (7 << 16) |
+                    (channels[i] << 24);
+        sample[1] = 0;
+        sample[2] = 0;
+        sample[3] = 255;
+    }
+
+    Ktx2Header header{};
+    header.identifier             = globals::ktx2Identifier;
+    header.vkFormat               = VK_FORMAT_R8G8B8A8_UNORM;
+    header.typeSize               = 1;
+    header.pixelWidth             = width;
+    header.pixelHeight            = height;
+    header.pixelDepth             = 0;
+    header.layerCount             = 0;
+    header.faceCount              = 1;
+    header.levelCount             = static_cast<std::uint32_t>(levels.size());
+    header.supercompressionScheme = 0;
+
+    std::uint64_t offset =
+        sizeof(Ktx2Header) + levels.size() * sizeof(Ktx2Level);
+    header.dfdByteOffset = static_cast<std::uint32_t>(offset);
+    header.dfdByteLength = dfd[0];
+    offset += dfd[0];
+
+    // KTX2 stores the smallest level first so that streaming readers can
+    // show something as early as possible. Every level is 4-byte aligned
+    // already since the texels are 4 bytes.
+    std::vector<Ktx2Level> levelIndex(levels.size());
+    for (std::size_t i = levels.size(); i-- > 0;)
+    {
+        levelIndex[i].byteOffset             = offset;
+        levelIndex[i].byteLength             = levels[i].size();
+        levelIndex[i].uncompressedByteLength = levels[i].size();
+        offset += levels[i].size();
+    }
+
+    std::ofstream file{filename, std::ios::binary | std::ios::trunc};
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    file.write(reinterpret_cast<char const*>(levelIndex.data()),
+               levelIndex.size() * sizeof(Ktx2Level));
+    file.write(reinterpret_cast<char const*>(dfd.data()), dfd[0]);
+    for (std::size_t i = levels.size(); i-- > 0;)
+    {
+        file.write(reinterpret_cast<char const*>(levels[i].data()),
+                   levels[i].size());
+    }
+
+    return file.good();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "MappedFile.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct TextureLevel
+{
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint64_t offset;
+    std::uint64_t size;
+};
+
+// Memory maps a KTX2 file holding a single 2D image with all of its mip levels
+// already baked in. The format is whatever the file was authored with, so
+// block compressed data (BC7, ASTC) is uploaded as is. Supercompressed files
+// are not supported.
+class TextureContainer
+{
+public:
+    bool open(std::string const& filename);
+
+    vk::Format getFormat() const;
+    std::uint32_t getWidth() const;
+    std::uint32_t getHeight() const;
+    std::vector<TextureLevel> const& getLevels() const;
+
+    // Level offsets are relative to the start of this, which is the whole
+    // file. Uploading it in one go means a single copy covers every level.
+    void const* getData() const;
+    std::size_t getSize() const;
+
+private:
+    MappedFile mFile;
+    vk::Format mFormat{vk::Format::eUndefined};
+    std::uint32_t mWidth{0};
+    std::uint32_t mHeight{0};
+    std::vector<TextureLevel> mLevels;
+};
+
+// Builds a full mip chain (down to 1x1) for RGBA8 pixels with a box filter.
+// The first entry is a copy of the source image.
+std::vector<std::vector<std::uint8_t>>
+generateMipChain(std::uint8_t const* pixels,
+                 std::uint32_t width,
+                 std::uint32_t height);
+
+// Writes an R8G8B8A8 KTX2 file from a mip chain built by generateMipChain.
+bool writeTextureContainer(
+    std::string const& filename,
+    std::uint32_t width,
+    std::uint32_t height,
+    std::vector<std::vector<std::uint8_t>> const& levels);
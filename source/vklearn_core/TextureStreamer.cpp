@@ -0,0 +1,395 @@
+#include "TextureStreamer.hpp"
+#include "VulkanHelpers.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace globals
+{
+    // Without VK_EXT_memory_budget there is no telling how much of the heap
+    // the rest of the system is using, so textures get a fixed share of it.
+    static constexpr double fallbackHeapShare{0.5};
+
+    // The reported budget lags behind allocations, so some of it is left
+    // for whatever gets allocated before it catches up.
+    static constexpr double budgetHeadroom{0.9};
+} // namespace globals
+
+void TextureStreamer::init(vk::PhysicalDevice const& physicalDevice,
+                           vk::Device const& device,
+                           MemoryAllocator& allocator,
+                           UploadContext& uploadContext,
+                           FrameScheduler& scheduler,
+                           DeletionQueue& deletionQueue,
+                           bool hasMemoryBudget,
+                           vk::DeviceSize frameUploadBudget)
+{
+    mPhysicalDevice    = physicalDevice;
+    mDevice            = device;
+    mAllocator         = &allocator;
+    mUploadContext     = &uploadContext;
+    mScheduler         = &scheduler;
+    mDeletionQueue     = &deletionQueue;
+    mHasMemoryBudget   = hasMemoryBudget;
+    mFrameUploadBudget = frameUploadBudget;
+
+    // Optimal images end up in device local memory, which on discrete cards
+    // is the largest heap that has any.
+    auto properties = physicalDevice.getMemoryProperties();
+    for (std::uint32_t i{0}; i < properties.memoryHeapCount; ++i)
+    {
+        auto const& heap = properties.memoryHeaps[i];
+        if ((heap.flags & vk::MemoryHeapFlagBits::eDeviceLocal) &&
+            heap.size > mHeapSize)
+        {
+            mHeap     = i;
+            mHeapSize = heap.size;
+        }
+    }
+
+    mBudget = queryBudget();
+}
+
+std::size_t TextureStreamer::addTexture(TextureContainer const& container,
+                                        std::uint32_t tailSize)
+{
+    auto const& levels = container.getLevels();
+
+    Texture texture;
+    texture.container  = &container;
+    texture.levelCount = static_cast<std::uint32_t>(levels.size());
+    texture.tailLevel  = texture.levelCount - 1;
+    for (std::uint32_t i{0}; i < texture.levelCount; ++i)
+    {
+        if (std::max(levels[i].width, levels[i].height) <= tailSize)
+        {
+            texture.tailLevel = i;
+            break;
+        }
+    }
+    texture.desiredLevel = texture.tailLevel;
+
+    // The tail goes in with the rest of the start up uploads, regardless of
+    // the per-frame budget, so there is always something to sample.
+    beginBuild(texture, texture.tailLevel);
+    recordBuild(texture, std::numeric_limits<vk::DeviceSize>::max());
+    texture.current    = std::move(texture.pending);
+    texture.isBuilding = false;
+
+    mTextures.push_back(std::move(texture));
+    return mTextures.size() - 1;
+}
+
+void TextureStreamer::setDesiredLevel(std::size_t texture, std::uint32_t level)
+{
+    mTextures[texture].desiredLevel =
+        std::min(level, mTextures[texture].tailLevel);
+}
+
+bool TextureStreamer::update()
+{
+    // Staging anything while the last batch is in flight would wait for it.
+    if (!mUploadContext->poll())
+    {
+        return false;
+    }
+
+    // Builds that were fully recorded before have now finished uploading.
+    // Swapping again while a frame could still sample the view before last
+    // would leave the caller without a free descriptor, so those wait a
+    // little longer. Everything submitted so far saw the current view.
+    bool changed{false};
+    for (auto& texture : mTextures)
+    {
+        if (!texture.isBuilding || texture.levelsLeft != 0 ||
+            !mScheduler->isComplete(texture.swapValue))
+        {
+            continue;
+        }
+
+        retire(texture.current);
+        texture.current    = std::move(texture.pending);
+        texture.swapValue  = mScheduler->getSubmittedValue();
+        texture.isBuilding = false;
+        changed            = true;
+    }
+
+    auto spareLevels = [](Texture const& texture) {
+        return static_cast<std::int32_t>(texture.desiredLevel) -
+               static_cast<std::int32_t>(texture.current.baseLevel);
+    };
+
+    mBudget = queryBudget();
+    if (mResidentSize > mBudget)
+    {
+        // Take a level off whichever texture has the most detail to spare.
+        // Only one goes per frame, as the budget takes a while to reflect it.
+        Texture* victim{nullptr};
+        for (auto& texture : mTextures)
+        {
+            if (texture.isBuilding ||
+                texture.current.baseLevel >= texture.tailLevel)
+            {
+                continue;
+            }
+
+            if (!victim || spareLevels(texture) > spareLevels(*victim))
+            {
+                victim = &texture;
+            }
+        }
+
+        if (victim)
+        {
+            beginBuild(*victim, victim->current.baseLevel + 1);
+        }
+    }
+    else
+    {
+        // Start on the textures that are furthest from what they need. The
+        // new image lives next to the old one for a while, so both have to
+        // fit.
+        std::vector<Texture*> candidates;
+        for (auto& texture : mTextures)
+        {
+            if (!texture.isBuilding &&
+                texture.desiredLevel < texture.current.baseLevel)
+            {
+                candidates.push_back(&texture);
+            }
+        }
+
+        std::sort(candidates.begin(),
+                  candidates.end(),
+                  [&spareLevels](auto const* a, auto const* b) {
+                      return spareLevels(*a) < spareLevels(*b);
+                  });
+
+        for (auto* texture : candidates)
+        {
+            auto baseLevel = texture->current.baseLevel - 1;
+            if (mResidentSize + getChainSize(*texture, baseLevel) <= mBudget)
+            {
+                beginBuild(*texture, baseLevel);
+            }
+        }
+    }
+
+    vk::DeviceSize uploaded{0};
+    for (auto& texture : mTextures)
+    {
+        if (uploaded >= mFrameUploadBudget)
+        {
+            break;
+        }
+
+        if (texture.isBuilding && texture.levelsLeft != 0)
+        {
+            uploaded += recordBuild(texture, mFrameUploadBudget - uploaded);
+        }
+    }
+
+    if (uploaded != 0)
+    {
+        mUploadContext->submit();
+        mStreamedSize += uploaded;
+    }
+
+    return changed;
+}
+
+vk::ImageView TextureStreamer::getImageView(std::size_t texture) const
+{
+    return *mTextures[texture].current.view;
+}
+
+std::uint32_t TextureStreamer::getResidentLevel(std::size_t texture) const
+{
+    return mTextures[texture].current.baseLevel;
+}
+
+std::uint32_t TextureStreamer::getLevelCount(std::size_t texture) const
+{
+    return mTextures[texture].levelCount;
+}
+
+vk::DeviceSize TextureStreamer::getResidentSize() const
+{
+    return mResidentSize;
+}
+
+vk::DeviceSize TextureStreamer::getBudget() const
+{
+    return mBudget;
+}
+
+vk::DeviceSize TextureStreamer::getStreamedSize() const
+{
+    return mStreamedSize;
+}
+
+void TextureStreamer::beginBuild(Texture& texture, std::uint32_t baseLevel)
+{
+    auto const& level = texture.container->getLevels()[baseLevel];
+    auto format       = texture.container->getFormat();
+    auto levelCount   = texture.levelCount - baseLevel;
+    auto& pending     = texture.pending;
+
+    auto imageInfo = core::getImageCreateInfo(
+        level.width,
+        level.height,
+        levelCount,
+        vk::SampleCountFlagBits::e1,
+        format,
+        vk::ImageTiling::eOptimal,
+        vk::ImageUsageFlagBits::eTransferDst |
+            vk::ImageUsageFlagBits::eSampled);
+    pending.image  = mDevice.createImageUnique(imageInfo);
+    pending.memory = mAllocator->allocate(
+        mDevice.getImageMemoryRequirements(*pending.image),
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        false);
+    mDevice.bindImageMemory(
+        *pending.image, pending.memory.memory, pending.memory.offset);
+
+    pending.view = vk::UniqueImageView(
+        core::createImageView(mDevice,
+                              *pending.image,
+                              format,
+                              vk::ImageAspectFlagBits::eColor,
+                              levelCount),
+        mDevice);
+    pending.baseLevel = baseLevel;
+
+    mResidentSize += pending.memory.size;
+    texture.isBuilding = true;
+    texture.levelsLeft = levelCount;
+}
+
+vk::DeviceSize TextureStreamer::recordBuild(Texture& texture,
+                                            vk::DeviceSize budget)
+{
+    auto const& container = *texture.container;
+    auto const& levels    = container.getLevels();
+    auto format           = container.getFormat();
+    auto& pending         = texture.pending;
+    auto levelCount       = texture.levelCount - pending.baseLevel;
+    auto commandBuffer    = mUploadContext->getCommandBuffer();
+
+    if (texture.levelsLeft == levelCount)
+    {
+        auto transition =
+            core::getLayoutTransition(*pending.image,
+                                      format,
+                                      vk::ImageLayout::eUndefined,
+                                      vk::ImageLayout::eTransferDstOptimal,
+                                      levelCount);
+        commandBuffer.pipelineBarrier(transition.sourceStage,
+                                      transition.destinationStage,
+                                      {},
+                                      {},
+                                      {},
+                                      {transition.barrier});
+    }
+
+    // Levels are never split, so one larger than the budget goes on its own
+    // and a frame overshoots by at most a level.
+    auto data = static_cast<std::uint8_t const*>(container.getData());
+    vk::DeviceSize uploaded{0};
+    while (texture.levelsLeft != 0 && (uploaded == 0 || uploaded < budget))
+    {
+        auto mipLevel     = pending.baseLevel + texture.levelsLeft - 1;
+        auto const& level = levels[mipLevel];
+        auto stagingBuffer =
+            mUploadContext->stage(data + level.offset, level.size);
+
+        vk::BufferImageCopy region;
+        region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+        region.imageSubresource.mipLevel   = mipLevel - pending.baseLevel;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount     = 1;
+        region.imageExtent = vk::Extent3D{level.width, level.height, 1};
+        commandBuffer.copyBufferToImage(stagingBuffer,
+                                        *pending.image,
+                                        vk::ImageLayout::eTransferDstOptimal,
+                                        {region});
+
+        uploaded += level.size;
+        --texture.levelsLeft;
+    }
+
+    if (texture.levelsLeft != 0)
+    {
+        return uploaded;
+    }
+
+    mUploadContext->transferImageOwnership(
+        *pending.image,
+        vk::ImageLayout::eTransferDstOptimal,
+        levelCount,
+        vk::AccessFlagBits::eTransferWrite,
+        vk::PipelineStageFlagBits::eTransfer);
+
+    auto transition =
+        core::getLayoutTransition(*pending.image,
+                                  format,
+                                  vk::ImageLayout::eTransferDstOptimal,
+                                  vk::ImageLayout::eShaderReadOnlyOptimal,
+                                  levelCount);
+    mUploadContext->getGraphicsCommandBuffer().pipelineBarrier(
+        transition.sourceStage,
+        transition.destinationStage,
+        {},
+        {},
+        {},
+        {transition.barrier});
+
+    return uploaded;
+}
+
+void TextureStreamer::retire(Residency& residency)
+{
+    // The memory only comes back once the deletion queue gets to it, but the
+    // budget query counts it against everyone else until then.
+    mResidentSize -= residency.memory.size;
+    mDeletionQueue->retire(std::move(residency.view));
+    mDeletionQueue->retire(std::move(residency.image));
+    mDeletionQueue->retire(residency.memory);
+    residency.memory = {};
+}
+
+vk::DeviceSize TextureStreamer::getChainSize(Texture const& texture,
+                                             std::uint32_t baseLevel) const
+{
+    auto const& levels = texture.container->getLevels();
+    return std::accumulate(levels.begin() + baseLevel,
+                           levels.end(),
+                           vk::DeviceSize{0},
+                           [](vk::DeviceSize size, auto const& level) {
+                               return size + level.size;
+                           });
+}
+
+vk::DeviceSize TextureStreamer::queryBudget() const
+{
+    if (!mHasMemoryBudget)
+    {
+        return static_cast<vk::DeviceSize>(mHeapSize *
+                                           globals::fallbackHeapShare);
+    }
+
+    auto chain = mPhysicalDevice.getMemoryProperties2<
+        vk::PhysicalDeviceMemoryProperties2,
+        vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+    auto const& memoryBudget =
+        chain.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+
+    // The usage already counts the resident textures, so only what everything
+    // else is using comes off the budget.
+    auto budget = static_cast<vk::DeviceSize>(memoryBudget.heapBudget[mHeap] *
+                                              globals::budgetHeadroom);
+    auto usage  = memoryBudget.heapUsage[mHeap];
+    auto others = (usage > mResidentSize) ? usage - mResidentSize : 0;
+    return (budget > others) ? budget - others : 0;
+}
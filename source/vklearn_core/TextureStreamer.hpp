@@ -0,0 +1,116 @@
+#pragma once
+
+#include "DeletionQueue.hpp"
+#include "FrameScheduler.hpp"
+#include "MemoryAllocator.hpp"
+#include "TextureContainer.hpp"
+#include "UploadContext.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Keeps the mip levels of container textures resident according to how large
+// they are on screen. Every texture starts out with its mip tail, the levels
+// no larger than the tail size, and finer levels are then streamed in through
+// the upload context within a per-frame byte budget. When the device memory
+// budget (from VK_EXT_memory_budget, or a share of the heap without it) runs
+// short, the textures with the most detail to spare drop their finest level.
+//
+// Changing what is resident builds a new image at the new size straight from
+// the container, so the old image stays valid for the frames still sampling
+// it. A texture's view only changes from update, and the previous one goes
+// to the deletion queue with the value of the last frame that could sample
+// it. The view doesn't change again until the scheduler is past that value.
+// Alternating between two descriptors per texture is therefore enough to
+// never write one that is in use.
+class TextureStreamer
+{
+public:
+    void init(vk::PhysicalDevice const& physicalDevice,
+              vk::Device const& device,
+              MemoryAllocator& allocator,
+              UploadContext& uploadContext,
+              FrameScheduler& scheduler,
+              DeletionQueue& deletionQueue,
+              bool hasMemoryBudget,
+              vk::DeviceSize frameUploadBudget);
+
+    // The container has to outlive the streamer. The mip tail is recorded
+    // into the upload context but not submitted, so the texture can be used
+    // once whoever submits the batch has waited for it.
+    std::size_t addTexture(TextureContainer const& container,
+                           std::uint32_t tailSize);
+
+    // The finest level worth having given the texture's size on screen.
+    void setDesiredLevel(std::size_t texture, std::uint32_t level);
+
+    // Must be called once per frame, before the frame that should see the
+    // new views is recorded. Returns whether any view changed.
+    bool update();
+
+    vk::ImageView getImageView(std::size_t texture) const;
+    std::uint32_t getResidentLevel(std::size_t texture) const;
+    std::uint32_t getLevelCount(std::size_t texture) const;
+
+    vk::DeviceSize getResidentSize() const;
+    vk::DeviceSize getBudget() const;
+    vk::DeviceSize getStreamedSize() const;
+
+private:
+    struct Residency
+    {
+        vk::UniqueImage image;
+        Allocation memory;
+        vk::UniqueImageView view;
+        std::uint32_t baseLevel{0};
+    };
+
+    struct Texture
+    {
+        TextureContainer const* container{nullptr};
+        std::uint32_t levelCount{0};
+        std::uint32_t tailLevel{0};
+        std::uint32_t desiredLevel{0};
+
+        Residency current;
+
+        // The last frame that could sample the view replaced by the last
+        // swap, see above.
+        std::uint64_t swapValue{0};
+
+        // Being built a few levels at a time, coarsest first. A build is only
+        // swapped in once every level has been uploaded.
+        Residency pending;
+        bool isBuilding{false};
+        std::uint32_t levelsLeft{0};
+    };
+
+    void beginBuild(Texture& texture, std::uint32_t baseLevel);
+    vk::DeviceSize recordBuild(Texture& texture, vk::DeviceSize budget);
+    void retire(Residency& residency);
+
+    vk::DeviceSize getChainSize(Texture const& texture,
+                                std::uint32_t baseLevel) const;
+    vk::DeviceSize queryBudget() const;
+
+    vk::PhysicalDevice mPhysicalDevice;
+    vk::Device mDevice;
+    MemoryAllocator* mAllocator{nullptr};
+    UploadContext* mUploadContext{nullptr};
+    FrameScheduler* mScheduler{nullptr};
+    DeletionQueue* mDeletionQueue{nullptr};
+
+    bool mHasMemoryBudget{false};
+    std::uint32_t mHeap{0};
+    vk::DeviceSize mHeapSize{0};
+
+    vk::DeviceSize mFrameUploadBudget{0};
+
+    vk::DeviceSize mResidentSize{0};
+    vk::DeviceSize mBudget{0};
+    vk::DeviceSize mStreamedSize{0};
+
+    std::vector<Texture> mTextures;
+};
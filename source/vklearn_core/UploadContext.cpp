@@ -0,0 +1,306 @@
+#include "UploadContext.hpp"
+
+#include <cstring>
+
+static vk::UniqueCommandBuffer allocateCommandBuffer(vk::Device const& device,
+                                                     vk::CommandPool pool)
+{
+    vk::CommandBufferAllocateInfo allocInfo;
+    allocInfo.commandPool        = pool;
+    allocInfo.level              = vk::CommandBufferLevel::ePrimary;
+    allocInfo.commandBufferCount = 1;
+    return std::move(device.allocateCommandBuffersUnique(allocInfo).front());
+}
+
+void UploadContext::init(vk::Device const& device,
+                         MemoryAllocator& allocator,
+                         std::uint32_t transferFamily,
+                         vk::Queue const& transferQueue,
+                         std::uint32_t graphicsFamily,
+                         FrameScheduler& scheduler,
+                         DeletionQueue& deletionQueue)
+{
+    mDevice           = device;
+    mAllocator        = &allocator;
+    mTransferFamily   = transferFamily;
+    mGraphicsFamily   = graphicsFamily;
+    mTransferQueue    = transferQueue;
+    mScheduler        = &scheduler;
+    mDeletionQueue    = &deletionQueue;
+    mHasTransferQueue = transferFamily != graphicsFamily;
+
+    vk::CommandPoolCreateInfo poolInfo;
+    poolInfo.queueFamilyIndex = transferFamily;
+    poolInfo.flags = vk::CommandPoolCreateFlagBits::eTransient |
+                     vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+    mTransferPool          = mDevice.createCommandPoolUnique(poolInfo);
+    mTransferCommandBuffer = allocateCommandBuffer(mDevice, *mTransferPool);
+
+    if (mHasTransferQueue)
+    {
+        poolInfo.queueFamilyIndex = graphicsFamily;
+        mGraphicsPool             = mDevice.createCommandPoolUnique(poolInfo);
+        mGraphicsCommandBuffer =
+            allocateCommandBuffer(mDevice, *mGraphicsPool);
+        mTransferComplete = mDevice.createSemaphoreUnique({});
+    }
+}
+
+vk::CommandBuffer UploadContext::getCommandBuffer()
+{
+    begin();
+    return *mTransferCommandBuffer;
+}
+
+vk::CommandBuffer UploadContext::getGraphicsCommandBuffer()
+{
+    begin();
+    return (mHasTransferQueue) ? *mGraphicsCommandBuffer
+                               : *mTransferCommandBuffer;
+}
+
+vk::Buffer UploadContext::stage(void const* data, vk::DeviceSize size)
+{
+    vk::BufferCreateInfo bufferInfo;
+    bufferInfo.size        = size;
+    bufferInfo.usage       = vk::BufferUsageFlagBits::eTransferSrc;
+    bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+
+    StagingBuffer staging;
+    staging.buffer = mDevice.createBufferUnique(bufferInfo);
+    staging.memory = mAllocator->allocate(
+        mDevice.getBufferMemoryRequirements(*staging.buffer),
+        vk::MemoryPropertyFlagBits::eHostVisible |
+            vk::MemoryPropertyFlagBits::eHostCoherent,
+        true);
+    mDevice.bindBufferMemory(
+        *staging.buffer, staging.memory.memory, staging.memory.offset);
+
+    std::memcpy(staging.memory.mapped, data, static_cast<std::size_t>(size));
+
+    vk::Buffer buffer = *staging.buffer;
+    mStagingBuffers.push_back(std::move(staging));
+    return buffer;
+}
+
+void UploadContext::transferBufferOwnership(
+    vk::Buffer const& buffer,
+    vk::AccessFlags const& dstAccess,
+    vk::PipelineStageFlags const& dstStage)
+{
+    begin();
+
+    vk::BufferMemoryBarrier barrier;
+    barrier.srcAccessMask       = vk::AccessFlagBits::eTransferWrite;
+    barrier.dstAccessMask       = dstAccess;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer              = buffer;
+    barrier.offset              = 0;
+    barrier.size                = VK_WHOLE_SIZE;
+
+    if (!mHasTransferQueue)
+    {
+        mTransferCommandBuffer->pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer,
+            dstStage,
+            {},
+            {},
+            {barrier},
+            {});
+        return;
+    }
+
+    // The release half only needs the source scope and the acquire half only
+    // needs the destination scope. Everything else is ignored.
+    barrier.srcQueueFamilyIndex = mTransferFamily;
+    barrier.dstQueueFamilyIndex = mGraphicsFamily;
+    barrier.dstAccessMask       = {};
+    mTransferCommandBuffer->pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eBottomOfPipe,
+        {},
+        {},
+        {barrier},
+        {});
+
+    barrier.srcAccessMask = {};
+    barrier.dstAccessMask = dstAccess;
+    mGraphicsCommandBuffer->pipelineBarrier(
+        vk::PipelineStageFlagBits::eTopOfPipe, dstStage, {}, {}, {barrier}, {});
+}
+
+void UploadContext::transferImageOwnership(
+    vk::Image const& image,
+    vk::ImageLayout const& layout,
+    std::uint32_t mipLevels,
+    vk::AccessFlags const& dstAccess,
+    vk::PipelineStageFlags const& dstStage)
+{
+    begin();
+
+    vk::ImageMemoryBarrier barrier;
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barrier.dstAccessMask = dstAccess;
+
+    barrier.oldLayout                       = layout;
+    barrier.newLayout                       = layout;
+    barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image                           = image;
+    barrier.subresourceRange.aspectMask     = vk::ImageAspectFlagBits::eColor;
+    barrier.subresourceRange.baseMipLevel   = 0;
+    barrier.subresourceRange.levelCount     = mipLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount     = 1;
+
+    if (!mHasTransferQueue)
+    {
+        mTransferCommandBuffer->pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer,
+            dstStage,
+            {},
+            {},
+            {},
+            {barrier});
+        return;
+    }
+
+    barrier.srcQueueFamilyIndex = mTransferFamily;
+    barrier.dstQueueFamilyIndex = mGraphicsFamily;
+    barrier.dstAccessMask       = {};
+    mTransferCommandBuffer->pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eBottomOfPipe,
+        {},
+        {},
+        {},
+        {barrier});
+
+    barrier.srcAccessMask = {};
+    barrier.dstAccessMask = dstAccess;
+    mGraphicsCommandBuffer->pipelineBarrier(
+        vk::PipelineStageFlagBits::eTopOfPipe, dstStage, {}, {}, {}, {barrier});
+}
+
+std::uint64_t UploadContext::submit()
+{
+    if (!mIsRecording)
+    {
+        return mPendingValue;
+    }
+
+    mTransferCommandBuffer->end();
+    if (mHasTransferQueue)
+    {
+        mGraphicsCommandBuffer->end();
+    }
+    mIsRecording = false;
+
+    // Without a transfer queue the copies share the graphics queue, which is
+    // the one the scheduler submits to.
+    mIsPending = true;
+    if (!mHasTransferQueue)
+    {
+        mPendingValue = mScheduler->submit(*mTransferCommandBuffer);
+        retireStaging();
+        return mPendingValue;
+    }
+
+    // The graphics half holds the acquire barriers (and anything that needs a
+    // graphics queue, like blits), so it has to wait for the copies. Only the
+    // graphics queue signals the scheduler's values, so the transfer queue
+    // hands over with a binary semaphore.
+    vk::SubmitInfo transferInfo;
+    transferInfo.commandBufferCount   = 1;
+    transferInfo.pCommandBuffers      = &(*mTransferCommandBuffer);
+    transferInfo.signalSemaphoreCount = 1;
+    transferInfo.pSignalSemaphores    = &(*mTransferComplete);
+    mTransferQueue.submit({transferInfo}, {});
+
+    mPendingValue = mScheduler->submit(
+        *mGraphicsCommandBuffer,
+        {{*mTransferComplete, 0, vk::PipelineStageFlagBits::eAllCommands}});
+    retireStaging();
+    return mPendingValue;
+}
+
+bool UploadContext::hasTransferQueue() const
+{
+    return mHasTransferQueue;
+}
+
+bool UploadContext::isPending() const
+{
+    return mIsPending;
+}
+
+bool UploadContext::poll()
+{
+    if (mIsPending && mScheduler->isComplete(mPendingValue))
+    {
+        finish();
+    }
+
+    return !mIsPending;
+}
+
+void UploadContext::wait()
+{
+    if (!mIsPending)
+    {
+        return;
+    }
+
+    mScheduler->wait(mPendingValue);
+    finish();
+}
+
+void UploadContext::begin()
+{
+    if (mIsPending)
+    {
+        wait();
+    }
+
+    if (mIsRecording)
+    {
+        return;
+    }
+
+    vk::CommandBufferBeginInfo beginInfo;
+    beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+    mTransferCommandBuffer->begin(beginInfo);
+    if (mHasTransferQueue)
+    {
+        mGraphicsCommandBuffer->begin(beginInfo);
+    }
+
+    mIsRecording = true;
+}
+
+void UploadContext::retireStaging()
+{
+    for (auto& staging : mStagingBuffers)
+    {
+        mDeletionQueue->retire(std::move(staging.buffer), mPendingValue);
+        mDeletionQueue->retire(staging.memory, mPendingValue);
+    }
+    mStagingBuffers.clear();
+
+    for (auto& retire : mRetired)
+    {
+        retire(mPendingValue);
+    }
+    mRetired.clear();
+}
+
+void UploadContext::finish()
+{
+    mTransferCommandBuffer->reset({});
+    if (mHasTransferQueue)
+    {
+        mGraphicsCommandBuffer->reset({});
+    }
+    mIsPending = false;
+}
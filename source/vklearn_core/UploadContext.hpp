@@ -0,0 +1,97 @@
+#pragma once
+
+#include "DeletionQueue.hpp"
+#include "FrameScheduler.hpp"
+#include "MemoryAllocator.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+class UploadContext
+{
+public:
+    void init(vk::Device const& device,
+              MemoryAllocator& allocator,
+              std::uint32_t transferFamily,
+              vk::Queue const& transferQueue,
+              std::uint32_t graphicsFamily,
+              FrameScheduler& scheduler,
+              DeletionQueue& deletionQueue);
+
+    vk::CommandBuffer getCommandBuffer();
+    vk::CommandBuffer getGraphicsCommandBuffer();
+    vk::Buffer stage(void const* data, vk::DeviceSize size);
+
+    // Anything else the batch uses, like views or descriptor pools recorded
+    // into it. It goes to the deletion queue along with the staging buffers.
+    template<typename Handle>
+    void retire(Handle handle)
+    {
+        auto held = std::make_shared<Handle>(std::move(handle));
+        mRetired.push_back([this, held](std::uint64_t value) {
+            mDeletionQueue->retire(std::move(*held), value);
+        });
+    }
+
+    void transferBufferOwnership(vk::Buffer const& buffer,
+                                 vk::AccessFlags const& dstAccess,
+                                 vk::PipelineStageFlags const& dstStage);
+    void transferImageOwnership(vk::Image const& image,
+                                vk::ImageLayout const& layout,
+                                std::uint32_t mipLevels,
+                                vk::AccessFlags const& dstAccess,
+                                vk::PipelineStageFlags const& dstStage);
+
+    // Whether copies run on a dedicated transfer queue. When they do,
+    // getCommandBuffer and getGraphicsCommandBuffer return different buffers.
+    bool hasTransferQueue() const;
+
+    // Returns the scheduler value the batch is done at, which work on the
+    // graphics queue can wait on instead of the CPU.
+    std::uint64_t submit();
+    bool isPending() const;
+    bool poll();
+    void wait();
+
+private:
+    struct StagingBuffer
+    {
+        vk::UniqueBuffer buffer;
+        Allocation memory;
+    };
+
+    void begin();
+    void retireStaging();
+    void finish();
+
+    vk::Device mDevice;
+    MemoryAllocator* mAllocator{nullptr};
+
+    std::uint32_t mTransferFamily{0};
+    std::uint32_t mGraphicsFamily{0};
+    vk::Queue mTransferQueue;
+    FrameScheduler* mScheduler{nullptr};
+    DeletionQueue* mDeletionQueue{nullptr};
+
+    // When the device has no separate transfer family, everything is recorded
+    // into the transfer command buffer and the graphics one is never used.
+    bool mHasTransferQueue{false};
+
+    vk::UniqueCommandPool mTransferPool;
+    vk::UniqueCommandPool mGraphicsPool;
+    vk::UniqueCommandBuffer mTransferCommandBuffer;
+    vk::UniqueCommandBuffer mGraphicsCommandBuffer;
+    vk::UniqueSemaphore mTransferComplete;
+
+    bool mIsRecording{false};
+    bool mIsPending{false};
+    std::uint64_t mPendingValue{0};
+
+    // Staging buffers are handed to the deletion queue once their batch is
+    // submitted, which keeps them until the scheduler is past it.
+    std::vector<StagingBuffer> mStagingBuffers;
+    std::vector<std::function<void(std::uint64_t)>> mRetired;
+};
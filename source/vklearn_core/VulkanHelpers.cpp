@@ -0,0 +1,409 @@
+#include "VulkanHelpers.hpp"
+
+#include <fmt/printf.h>
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace core
+{
+    std::vector<char> readFile(std::string const& filename)
+    {
+        std::ifstream file{filename, std::ios::ate | std::ios::binary};
+
+        if (!file.is_open())
+        {
+            std::string message =
+                fmt::format("error: unable to open file {}.", filename);
+            throw std::runtime_error{message};
+        }
+
+        std::size_t fileSize = static_cast<std::size_t>(file.tellg());
+        std::vector<char> buffer(fileSize);
+        file.seekg(0);
+        file.read(buffer.data(), fileSize);
+        file.close();
+        return buffer;
+    }
+
+    SwapChainSupportDetails
+    querySwapChainSupport(vk::PhysicalDevice const& physicalDevice,
+                          vk::SurfaceKHR const& surface)
+    {
+        SwapChainSupportDetails details;
+        details.capabilities =
+            physicalDevice.getSurfaceCapabilitiesKHR(surface);
+        details.formats = physicalDevice.getSurfaceFormatsKHR(surface);
+        details.presentModes =
+            physicalDevice.getSurfacePresentModesKHR(surface);
+
+        return details;
+    }
+
+    vk::SurfaceFormatKHR chooseSwapSurfaceFormat(
+        std::vector<vk::SurfaceFormatKHR> const& availableFormats)
+    {
+        for (auto const& availableFormat : availableFormats)
+        {
+            if (availableFormat.format == vk::Format::eB8G8R8A8Unorm &&
+                availableFormat.colorSpace ==
+                    vk::ColorSpaceKHR::eSrgbNonlinear)
+            {
+                return availableFormat;
+            }
+        }
+
+        return availableFormats[0];
+    }
+
+    vk::Extent2D
+    chooseSwapExtent(vk::SurfaceCapabilitiesKHR const& capabilities,
+                     GLFWwindow* window)
+    {
+        if (capabilities.currentExtent.width !=
+            std::numeric_limits<std::uint32_t>::max())
+        {
+            return capabilities.currentExtent;
+        }
+
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        vk::Extent2D actualExtent = {static_cast<std::uint32_t>(width),
+                                     static_cast<std::uint32_t>(height)};
+
+        actualExtent.width = std::max(
+            capabilities.minImageExtent.width,
+            std::min(capabilities.maxImageExtent.width, actualExtent.width));
+        actualExtent.height = std::max(
+            capabilities.minImageExtent.height,
+            std::min(capabilities.maxImageExtent.height, actualExtent.height));
+
+        return actualExtent;
+    }
+
+    std::uint32_t findMemoryType(vk::PhysicalDevice const& physicalDevice,
+                                 std::uint32_t typeFilter,
+                                 vk::MemoryPropertyFlags const& properties)
+    {
+        auto memProperties = physicalDevice.getMemoryProperties();
+        for (std::uint32_t i{0}; i < memProperties.memoryTypeCount; ++i)
+        {
+            if (typeFilter & (1 << i) &&
+                (memProperties.memoryTypes[i].propertyFlags & properties) ==
+                    properties)
+            {
+                return i;
+            }
+        }
+
+        throw std::runtime_error{"error: failed to find suitable memory type."};
+    }
+
+    vk::Format
+    findSupportedFormat(vk::PhysicalDevice const& physicalDevice,
+                        std::vector<vk::Format> const& candidates,
+                        vk::ImageTiling const& tiling,
+                        vk::FormatFeatureFlags const& features)
+    {
+        for (auto format : candidates)
+        {
+            auto props = physicalDevice.getFormatProperties(format);
+            if (tiling == vk::ImageTiling::eLinear &&
+                (props.linearTilingFeatures & features) == features)
+            {
+                return format;
+            }
+            else if (tiling == vk::ImageTiling::eOptimal &&
+                     (props.optimalTilingFeatures & features) == features)
+            {
+                return format;
+            }
+        }
+
+        throw std::runtime_error{"error: failed to find supported format."};
+    }
+
+    vk::Format findDepthFormat(vk::PhysicalDevice const& physicalDevice)
+    {
+        return findSupportedFormat(
+            physicalDevice,
+            {vk::Format::eD32Sfloat,
+             vk::Format::eD32SfloatS8Uint,
+             vk::Format::eD24UnormS8Uint},
+            vk::ImageTiling::eOptimal,
+            vk::FormatFeatureFlagBits::eDepthStencilAttachment);
+    }
+
+    bool hasStencilComponent(vk::Format const& format)
+    {
+        return format == vk::Format::eD32SfloatS8Uint ||
+               format == vk::Format::eD24UnormS8Uint;
+    }
+
+    void createBuffer(vk::PhysicalDevice const& physicalDevice,
+                      vk::Device const& device,
+                      vk::DeviceSize const& size,
+                      vk::BufferUsageFlags const& usage,
+                      vk::MemoryPropertyFlags const& properties,
+                      vk::Buffer& buffer,
+                      vk::DeviceMemory& bufferMemory)
+    {
+        vk::BufferCreateInfo bufferInfo;
+        bufferInfo.size        = size;
+        bufferInfo.usage       = usage;
+        bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+
+        buffer = device.createBuffer(bufferInfo);
+
+        auto memRequirements = device.getBufferMemoryRequirements(buffer);
+
+        vk::MemoryAllocateInfo allocInfo;
+        allocInfo.allocationSize  = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(
+            physicalDevice, memRequirements.memoryTypeBits, properties);
+
+        bufferMemory = device.allocateMemory(allocInfo);
+        device.bindBufferMemory(buffer, bufferMemory, 0);
+    }
+
+    vk::ImageCreateInfo
+    getImageCreateInfo(std::uint32_t width,
+                       std::uint32_t height,
+                       std::uint32_t mipLevels,
+                       vk::SampleCountFlagBits const& numSamples,
+                       vk::Format const& format,
+                       vk::ImageTiling const& tiling,
+                       vk::ImageUsageFlags const& usage)
+    {
+        vk::ImageCreateInfo imageInfo;
+        imageInfo.imageType     = vk::ImageType::e2D;
+        imageInfo.extent        = vk::Extent3D{width, height, 1};
+        imageInfo.mipLevels     = mipLevels;
+        imageInfo.arrayLayers   = 1;
+        imageInfo.format        = format;
+        imageInfo.tiling        = tiling;
+        imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+        imageInfo.usage         = usage;
+        imageInfo.sharingMode   = vk::SharingMode::eExclusive;
+        imageInfo.samples       = numSamples;
+
+        return imageInfo;
+    }
+
+    void createImage(vk::PhysicalDevice const& physicalDevice,
+                     vk::Device const& device,
+                     vk::ImageCreateInfo const& imageInfo,
+                     vk::MemoryPropertyFlags const& properties,
+                     vk::Image& image,
+                     vk::DeviceMemory& imageMemory)
+    {
+        image = device.createImage(imageInfo);
+
+        auto memRequirements = device.getImageMemoryRequirements(image);
+
+        vk::MemoryAllocateInfo allocInfo;
+        allocInfo.allocationSize  = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(
+            physicalDevice, memRequirements.memoryTypeBits, properties);
+        imageMemory = device.allocateMemory(allocInfo);
+        device.bindImageMemory(image, imageMemory, 0);
+    }
+
+    vk::ImageView createImageView(vk::Device const& device,
+                                  vk::Image const& image,
+                                  vk::Format const& format,
+                                  vk::ImageAspectFlags const& aspectFlags,
+                                  std::uint32_t mipLevels)
+    {
+        vk::ImageViewCreateInfo viewInfo;
+        viewInfo.image                           = image;
+        viewInfo.viewType                        = vk::ImageViewType::e2D;
+        viewInfo.format                          = format;
+        viewInfo.subresourceRange.aspectMask     = aspectFlags;
+        viewInfo.subresourceRange.baseMipLevel   = 0;
+        viewInfo.subresourceRange.levelCount     = mipLevels;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount     = 1;
+
+        return device.createImageView(viewInfo);
+    }
+
+    vk::CommandBuffer beginSingleTimeCommands(vk::Device const& device,
+                                              vk::CommandPool const& pool)
+    {
+        vk::CommandBufferAllocateInfo allocInfo;
+        allocInfo.level              = vk::CommandBufferLevel::ePrimary;
+        allocInfo.commandPool        = pool;
+        allocInfo.commandBufferCount = 1;
+
+        vk::CommandBuffer commandBuffer =
+            device.allocateCommandBuffers(allocInfo).front();
+
+        vk::CommandBufferBeginInfo beginInfo;
+        beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+        commandBuffer.begin(beginInfo);
+        return commandBuffer;
+    }
+
+    void endSingleTimeCommands(vk::Device const& device,
+                               vk::CommandPool const& pool,
+                               vk::Queue const& queue,
+                               vk::CommandBuffer const& commandBuffer)
+    {
+        commandBuffer.end();
+
+        vk::SubmitInfo submitInfo;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers    = &commandBuffer;
+
+        queue.submit({submitInfo}, {});
+        queue.waitIdle();
+
+        device.freeCommandBuffers(pool, commandBuffer);
+    }
+
+    LayoutAccess getLayoutAccess(vk::ImageLayout const& layout)
+    {
+        switch (layout)
+        {
+        case vk::ImageLayout::eUndefined:
+        case vk::ImageLayout::ePreinitialized:
+            return {vk::PipelineStageFlagBits::eTopOfPipe, {}};
+
+        case vk::ImageLayout::eTransferDstOptimal:
+            return {vk::PipelineStageFlagBits::eTransfer,
+                    vk::AccessFlagBits::eTransferWrite};
+
+        case vk::ImageLayout::eTransferSrcOptimal:
+            return {vk::PipelineStageFlagBits::eTransfer,
+                    vk::AccessFlagBits::eTransferRead};
+
+        case vk::ImageLayout::eShaderReadOnlyOptimal:
+            return {vk::PipelineStageFlagBits::eFragmentShader,
+                    vk::AccessFlagBits::eShaderRead};
+
+        case vk::ImageLayout::eColorAttachmentOptimal:
+            return {vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                    vk::AccessFlagBits::eColorAttachmentRead |
+                        vk::AccessFlagBits::eColorAttachmentWrite};
+
+        case vk::ImageLayout::eDepthStencilAttachmentOptimal:
+            return {vk::PipelineStageFlagBits::eEarlyFragmentTests |
+                        vk::PipelineStageFlagBits::eLateFragmentTests,
+                    vk::AccessFlagBits::eDepthStencilAttachmentRead |
+                        vk::AccessFlagBits::eDepthStencilAttachmentWrite};
+
+        case vk::ImageLayout::eGeneral:
+            return {vk::PipelineStageFlagBits::eAllCommands,
+                    vk::AccessFlagBits::eMemoryRead |
+                        vk::AccessFlagBits::eMemoryWrite};
+
+        case vk::ImageLayout::ePresentSrcKHR:
+            return {vk::PipelineStageFlagBits::eBottomOfPipe, {}};
+
+        default:
+            throw std::runtime_error{"error: unsupported image layout."};
+        }
+    }
+
+    LayoutTransition getLayoutTransition(vk::Image const& image,
+                                         vk::Format const& format,
+                                         vk::ImageLayout const& oldLayout,
+                                         vk::ImageLayout const& newLayout,
+                                         std::uint32_t mipLevels)
+    {
+        LayoutTransition transition;
+        auto& barrier = transition.barrier;
+
+        barrier.oldLayout                       = oldLayout;
+        barrier.newLayout                       = newLayout;
+        barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image                           = image;
+        barrier.subresourceRange.aspectMask =
+            vk::ImageAspectFlagBits::eColor;
+        barrier.subresourceRange.baseMipLevel   = 0;
+        barrier.subresourceRange.levelCount     = mipLevels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount     = 1;
+
+        if (oldLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal ||
+            newLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal)
+        {
+            barrier.subresourceRange.aspectMask =
+                vk::ImageAspectFlagBits::eDepth;
+            if (hasStencilComponent(format))
+            {
+                barrier.subresourceRange.aspectMask |=
+                    vk::ImageAspectFlagBits::eStencil;
+            }
+        }
+
+        // Any pair of layouts works. Whatever used the old layout has to be
+        // done before whatever uses the new one starts.
+        auto source      = getLayoutAccess(oldLayout);
+        auto destination = getLayoutAccess(newLayout);
+
+        barrier.srcAccessMask       = source.access;
+        barrier.dstAccessMask       = destination.access;
+        transition.sourceStage      = source.stages;
+        transition.destinationStage = destination.stages;
+
+        return transition;
+    }
+
+    void transitionImageLayout(vk::CommandBuffer const& commandBuffer,
+                               vk::Image const& image,
+                               vk::Format const& format,
+                               vk::ImageLayout const& oldLayout,
+                               vk::ImageLayout const& newLayout,
+                               std::uint32_t mipLevels)
+    {
+        auto transition =
+            getLayoutTransition(image, format, oldLayout, newLayout, mipLevels);
+        commandBuffer.pipelineBarrier(transition.sourceStage,
+                                      transition.destinationStage,
+                                      {},
+                                      {},
+                                      {},
+                                      {transition.barrier});
+    }
+
+    void copyBuffer(vk::CommandBuffer const& commandBuffer,
+                    vk::Buffer const& srcBuffer,
+                    vk::Buffer const& dstBuffer,
+                    vk::DeviceSize const& size)
+    {
+        vk::BufferCopy copyRegion;
+        copyRegion.srcOffset = 0;
+        copyRegion.dstOffset = 0;
+        copyRegion.size      = size;
+        commandBuffer.copyBuffer(srcBuffer, dstBuffer, 1, &copyRegion);
+    }
+
+    void copyBufferToImage(vk::CommandBuffer const& commandBuffer,
+                           vk::Buffer const& buffer,
+                           vk::Image const& image,
+                           std::uint32_t width,
+                           std::uint32_t height)
+    {
+        vk::BufferImageCopy region;
+        region.bufferOffset      = 0;
+        region.bufferRowLength   = 0;
+        region.bufferImageHeight = 0;
+
+        region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+        region.imageSubresource.mipLevel   = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount     = 1;
+
+        region.imageOffset = vk::Offset3D{0, 0, 0};
+        region.imageExtent = vk::Extent3D{width, height, 1};
+
+        commandBuffer.copyBufferToImage(
+            buffer, image, vk::ImageLayout::eTransferDstOptimal, {region});
+    }
+} // namespace core
@@ -0,0 +1,120 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Helpers shared by every sample. They only take the handles they need so
+// each Application can forward to them from its own members.
+namespace core
+{
+    struct SwapChainSupportDetails
+    {
+        vk::SurfaceCapabilitiesKHR capabilities;
+        std::vector<vk::SurfaceFormatKHR> formats;
+        std::vector<vk::PresentModeKHR> presentModes;
+    };
+
+    // A layout transition that has not been recorded yet, so the caller can
+    // decide which queue it belongs on from the stages.
+    struct LayoutTransition
+    {
+        vk::ImageMemoryBarrier barrier;
+        vk::PipelineStageFlags sourceStage;
+        vk::PipelineStageFlags destinationStage;
+    };
+
+    // The stages and access an image layout is normally used with, which is
+    // what a transition into or out of it has to synchronise with.
+    struct LayoutAccess
+    {
+        vk::PipelineStageFlags stages;
+        vk::AccessFlags access;
+    };
+
+    std::vector<char> readFile(std::string const& filename);
+
+    SwapChainSupportDetails
+    querySwapChainSupport(vk::PhysicalDevice const& physicalDevice,
+                          vk::SurfaceKHR const& surface);
+    vk::SurfaceFormatKHR chooseSwapSurfaceFormat(
+        std::vector<vk::SurfaceFormatKHR> const& availableFormats);
+    vk::Extent2D
+    chooseSwapExtent(vk::SurfaceCapabilitiesKHR const& capabilities,
+                     GLFWwindow* window);
+
+    std::uint32_t findMemoryType(vk::PhysicalDevice const& physicalDevice,
+                                 std::uint32_t typeFilter,
+                                 vk::MemoryPropertyFlags const& properties);
+    vk::Format
+    findSupportedFormat(vk::PhysicalDevice const& physicalDevice,
+                        std::vector<vk::Format> const& candidates,
+                        vk::ImageTiling const& tiling,
+                        vk::FormatFeatureFlags const& features);
+    vk::Format findDepthFormat(vk::PhysicalDevice const& physicalDevice);
+    bool hasStencilComponent(vk::Format const& format);
+
+    void createBuffer(vk::PhysicalDevice const& physicalDevice,
+                      vk::Device const& device,
+                      vk::DeviceSize const& size,
+                      vk::BufferUsageFlags const& usage,
+                      vk::MemoryPropertyFlags const& properties,
+                      vk::Buffer& buffer,
+                      vk::DeviceMemory& bufferMemory);
+
+    vk::ImageCreateInfo
+    getImageCreateInfo(std::uint32_t width,
+                       std::uint32_t height,
+                       std::uint32_t mipLevels,
+                       vk::SampleCountFlagBits const& numSamples,
+                       vk::Format const& format,
+                       vk::ImageTiling const& tiling,
+                       vk::ImageUsageFlags const& usage);
+    void createImage(vk::PhysicalDevice const& physicalDevice,
+                     vk::Device const& device,
+                     vk::ImageCreateInfo const& imageInfo,
+                     vk::MemoryPropertyFlags const& properties,
+                     vk::Image& image,
+                     vk::DeviceMemory& imageMemory);
+    vk::ImageView createImageView(vk::Device const& device,
+                                  vk::Image const& image,
+                                  vk::Format const& format,
+                                  vk::ImageAspectFlags const& aspectFlags,
+                                  std::uint32_t mipLevels);
+
+    vk::CommandBuffer beginSingleTimeCommands(vk::Device const& device,
+                                              vk::CommandPool const& pool);
+    void endSingleTimeCommands(vk::Device const& device,
+                               vk::CommandPool const& pool,
+                               vk::Queue const& queue,
+                               vk::CommandBuffer const& commandBuffer);
+
+    // The recording helpers below leave submission to the caller, so they
+    // work with both one-off command buffers and batched uploads.
+    LayoutAccess getLayoutAccess(vk::ImageLayout const& layout);
+    LayoutTransition getLayoutTransition(vk::Image const& image,
+                                         vk::Format const& format,
+                                         vk::ImageLayout const& oldLayout,
+                                         vk::ImageLayout const& newLayout,
+                                         std::uint32_t mipLevels);
+    void transitionImageLayout(vk::CommandBuffer const& commandBuffer,
+                               vk::Image const& image,
+                               vk::Format const& format,
+                               vk::ImageLayout const& oldLayout,
+                               vk::ImageLayout const& newLayout,
+                               std::uint32_t mipLevels);
+    void copyBuffer(vk::CommandBuffer const& commandBuffer,
+                    vk::Buffer const& srcBuffer,
+                    vk::Buffer const& dstBuffer,
+                    vk::DeviceSize const& size);
+    void copyBufferToImage(vk::CommandBuffer const& commandBuffer,
+                           vk::Buffer const& buffer,
+                           vk::Image const& image,
+                           std::uint32_t width,
+                           std::uint32_t height);
+} // namespace core